@@ -9,6 +9,40 @@
 #include <ctime>
 #include <memory>
 #include <limits>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <thread>
+#include <future>
+#include <functional>
+#include <queue>
+#include <condition_variable>
+#include <random>
+#include <chrono>
+#include <shared_mutex>
+#include <fstream>
+#include <deque>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/random.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#endif
 
 using namespace std;
 
@@ -79,1293 +113,7929 @@ public:
     static string generateUserID() { return "U" + to_string(++userCounter); }
     static string generateRestaurantID() { return "R" + to_string(++restaurantCounter); }
     static string generateOrderID() { return "O" + to_string(++orderCounter); }
+
+    // "U1001" -> 1001, used wherever a compact integer key is needed
+    static long long numericPart(const string& id) {
+        long long value = 0;
+        for (char ch : id) {
+            if (ch >= '0' && ch <= '9') value = value * 10 + (ch - '0');
+        }
+        return value;
+    }
 };
 
 long long IDGenerator::userCounter = 1000;
 long long IDGenerator::restaurantCounter = 500;
 long long IDGenerator::orderCounter = 100;
 
-class Notification {
-public:
-    void sendNotification(const string& userId, const string& message) const {
-        cout << "\n[Notification to " << userId << "]: " << message << endl;
+// Amounts in integer cents. Arithmetic is checked: on overflow it saturates at
+// the representable limit instead of wrapping. Conversions from dollars and
+// percentages round half away from zero to the nearest cent.
+class Money {
+private:
+    long long cents;
+    explicit Money(long long c) : cents(c) {}
+
+    static long long saturatingAdd(long long a, long long b) {
+        if (b > 0 && a > numeric_limits<long long>::max() - b) return numeric_limits<long long>::max();
+        if (b < 0 && a < numeric_limits<long long>::min() - b) return numeric_limits<long long>::min();
+        return a + b;
     }
-};
 
-// --- DISH AND MENU ---
-// -------------------------------------------------------------
-class Dish {
-private:
-    string dishId;
-    string name;
-    double price;
-    string type;    
-    string cuisine; 
-    string course;  
-    double rating;
-    int ratingCount;
+    static long long roundedDiv(long long num, long long den) {
+        long long q = num / den, r = num % den;
+        if (2 * (r < 0 ? -r : r) >= den) q += (num < 0 ? -1 : 1);
+        return q;
+    }
 
 public:
-    Dish(const string& n, double p, const string& t, const string& c, const string& cs)
-    {
-       this->dishId = "D" + to_string(rand() % 1000 + 100);
-       this->name = n;
-       this->price = p;
-       this->type = t;
-       this->cuisine = c;
-       this->course = cs;
-       this->rating = 0.0;
-       this->ratingCount = 0;
+    Money() : cents(0) {}
+    static Money fromCents(long long c) { return Money(c); }
+    static Money fromWhole(long long dollars) { return Money(dollars) * 100; }
+    static Money fromDollars(double dollars) { return Money(llround(dollars * 100.0)); }
+
+    long long getCents() const { return cents; }
+    double toDouble() const { return cents / 100.0; }
+
+    Money operator+(Money other) const { return Money(saturatingAdd(cents, other.cents)); }
+    Money operator-(Money other) const {
+        if (other.cents == numeric_limits<long long>::min()) return Money(numeric_limits<long long>::max());
+        return Money(saturatingAdd(cents, -other.cents));
+    }
+    Money operator*(long long qty) const {
+        if (qty != 0 && cents != 0) {
+            long long limit = numeric_limits<long long>::max() / (qty < 0 ? -qty : qty);
+            if ((cents < 0 ? -cents : cents) > limit) {
+                bool negative = (cents < 0) != (qty < 0);
+                return Money(negative ? numeric_limits<long long>::min() : numeric_limits<long long>::max());
+            }
+        }
+        return Money(cents * qty);
     }
+    Money& operator+=(Money other) { *this = *this + other; return *this; }
+    Money& operator-=(Money other) { *this = *this - other; return *this; }
 
-    //getter functions since the name, id etc... are declared as private in the class dish
-    const string& getName() const { return name; }
-    const string& getId() const { return dishId; }
-    double getPrice() const { return price; }
-    const string& getType() const { return type; }      
-    const string& getCuisine() const { return cuisine; }
-    const string& getCourse() const { return course; }  
-    double getRating() const { return rating; }
+    // basisPoints / 100 percent of this amount, e.g. 500 -> 5%
+    Money percentBps(long long basisPoints) const {
+        if (cents != 0 && (cents < 0 ? -cents : cents) > numeric_limits<long long>::max() / 100000) {
+            return Money(static_cast<long long>(llround(static_cast<long double>(cents) * basisPoints / 10000.0L)));
+        }
+        return Money(roundedDiv(cents * basisPoints, 10000));
+    }
 
-    void updateRating(int newRating) 
-    {
-         rating = (rating * ratingCount + newRating) / (ratingCount + 1);
-         ratingCount++;
+    bool operator==(Money o) const { return cents == o.cents; }
+    bool operator!=(Money o) const { return cents != o.cents; }
+    bool operator<(Money o) const { return cents < o.cents; }
+    bool operator<=(Money o) const { return cents <= o.cents; }
+    bool operator>(Money o) const { return cents > o.cents; }
+    bool operator>=(Money o) const { return cents >= o.cents; }
+
+    string toString() const {
+        unsigned long long mag = cents < 0 ? 0ULL - static_cast<unsigned long long>(cents) : cents;
+        string frac = to_string(mag % 100);
+        if (frac.size() < 2) frac = "0" + frac;
+        return (cents < 0 ? "-" : "") + to_string(mag / 100) + "." + frac;
     }
 
-    void display() const 
-    {
-        cout << fixed << setprecision(2)
-                 << "    - [" << dishId << "] " << name
-                 << " (" << type << ")" 
-                 << " | Price: $" << price
-                 << " | Rating: " << (ratingCount > 0 ? to_string(rating).substr(0, 3) : "N/A")
-                 << endl;
+    // Plain integer adds with no per-element checks so the loop vectorizes;
+    // only overflows past ~9.2e16 cents, far beyond any aggregate we keep.
+    static Money sum(const vector<Money>& values) {
+        long long total = 0;
+        for (const Money& m : values) total += m.cents;
+        return Money(total);
     }
 };
 
-bool operator<(const Dish &a, const Dish &b)
-{
-    return a.getName() < b.getName();
+ostream& operator<<(ostream& os, Money m) {
+    return os << m.toString();
 }
 
-class Menu 
-{
+// Where time and randomness come from. Normally that is the wall clock and a
+// random seed. A deterministic run (--seed, --record, --replay) uses a seeded
+// generator instead, plus a sim clock that only moves when the session engine
+// is driven, so two runs fed the same inputs produce the same state.
+class RunContext {
 private:
-    vector<Dish> dishes;
+    atomic<bool> deterministic;
+    atomic<long long> simMicros;
+    long long startMicros;
+    uint64_t seed;
+    chrono::steady_clock::time_point startedAt;
+    mutex rngLock;
+    mt19937_64 rng;
+
+    RunContext() : deterministic(false), simMicros(0), startMicros(0), seed(random_device()()),
+                   startedAt(chrono::steady_clock::now()), rng(seed) {}
+
 public:
-    void addDish(const Dish& dish)
-    {
-         dishes.push_back(dish);
+    static RunContext& instance() {
+        static RunContext ctx;
+        return ctx;
     }
 
-    void removeDish(const string &dishName)
-    {
-        for (int i = 0; i < dishes.size(); i++)
-        {
-            if (dishes[i].getName() == dishName)
-            {
-                dishes.erase(dishes.begin() + i);
-                i--; // step back since erase shifts elements
-            }
-        }
+    // Must run before the SystemManager is built: it decides whether timer threads start
+    void makeDeterministic(uint64_t s, long long start) {
+        lock_guard<mutex> guard(rngLock);
+        seed = s;
+        rng.seed(s);
+        startMicros = start;
+        startedAt = chrono::steady_clock::now();
+        simMicros.store(start, memory_order_relaxed);
+        deterministic.store(true, memory_order_relaxed);
     }
 
-    // Updated to take and check strings
-    vector<Dish> filterDishes(const string& c, const string& cs, const string& t) const 
-    {
-        vector<Dish> result;
-        for (const auto& dish : dishes)
-        {
-            bool cuisineMatch = (c == CUISINE_ANY) || (dish.getCuisine() == c);
-            bool courseMatch = (cs == COURSE_ANY) || (dish.getCourse() == cs);
-            bool typeMatch = (t == DISH_BOTH) || (dish.getType() == t);
+    bool isDeterministic() const { return deterministic.load(memory_order_relaxed); }
+    uint64_t getSeed() const { return seed; }
+    long long getStartMicros() const { return startMicros; }
+    long long simNow() const { return simMicros.load(memory_order_relaxed); }
+    void setSimNow(long long micros) { simMicros.store(micros, memory_order_relaxed); }
 
-            if (cuisineMatch && courseMatch && typeMatch) {
-                result.push_back(dish);
-            }
-        }
-        return result;
-    }
-    
-    Dish* getDishByName(const string& name) 
-    {
-        for (int i = 0; i < dishes.size(); i++) 
-        {
-            if (dishes[i].getName() == name) {
-                return &dishes[i];  // return pointer to that dish
-            }
-        }
-    return nullptr; // if dish not found
+    long long realElapsedMicros() const {
+        return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - startedAt).count();
     }
 
-    
-    const vector<Dish>& getAllDishes() const { return dishes; }
+    uint64_t random() {
+        lock_guard<mutex> guard(rngLock);
+        return rng();
+    }
 };
 
-// --- RESTAURANT ---
-// -------------------------------------------------------------
-class Restaurant {
-private:
-    string restaurantId;
-    string name;
-    string cuisine;
-    double rating;
-    int ratingCount;
-    vector<string> branches;
-    string contactEmail;
-    Menu menu;
-public:
-    Restaurant(const string& n, const string& c, const string& email) {
-    restaurantId = IDGenerator::generateRestaurantID();
-    name = n;
-    cuisine = c;
-    rating = 4.5;
-    ratingCount = 1;
-    contactEmail = email;
-    branches.push_back("Main Street Branch");
-}
+// Background jobs that run on a timer. Some normally tick on a thread of their
+// own; the rest touch orders, so the session engine fires them. In a
+// deterministic run the engine fires all of them off the sim clock.
+enum TimerId : uint8_t { TIMER_SURGE_TICK, TIMER_RATING_FLUSH, TIMER_PREORDER_RELEASE, TIMER_COUNT };
+const int TIMER_INTERVAL_MS[TIMER_COUNT] = {500, 100, 1000};
+const bool TIMER_OWN_THREAD[TIMER_COUNT] = {true, true, false};
 
-    //getters to get properties defined in private
-    const string& getId() const { return restaurantId; }
-    const string& getName() const { return name; }
-    const string& getCuisine() const { return cuisine; } // Return string
-    double getRating() const { return rating; }
-    Menu& getMenu() { return menu; }
+// Time in microseconds: the wall clock, or the sim clock in a deterministic
+// run. It is the one time source for timestamps and decay.
+class Clock {
+public:
+    static long long nowMicros() {
+        RunContext& ctx = RunContext::instance();
+        if (ctx.isDeterministic()) return ctx.simNow();
+        return chrono::duration_cast<chrono::microseconds>(chrono::system_clock::now().time_since_epoch()).count();
+    }
+};
 
-    void displayInfo() const {
-        cout << fixed << setprecision(1)
-                 << "[" << restaurantId << "] " << name << " (" << cuisine << ")" 
-                 << " | Rating: " << rating << "⭐"
-                 << " | Branches: " << branches.size()
-                 << endl;
+// Position in km on a flat CITY_KM x CITY_KM map. Addresses carry no
+// coordinates yet, so they are placed by a stable hash of the text. The map
+// is cut into a GRID x GRID set of square delivery zones.
+struct GeoPoint {
+    static const int GRID = 4;
+    static constexpr double CITY_KM = 10.0;
+
+    double x = 0, y = 0;
+
+    static GeoPoint locate(const string& address) {
+        uint64_t h = 14695981039346656037ull; // FNV-1a
+        for (char ch : address) h = (h ^ static_cast<uint8_t>(ch)) * 1099511628211ull;
+        GeoPoint p;
+        p.x = (h & 0xffffffffu) / 4294967296.0 * CITY_KM;
+        p.y = (h >> 32) / 4294967296.0 * CITY_KM;
+        return p;
     }
 
-    void updateRating(int newRating) {
-         rating = (rating * ratingCount + newRating) / (ratingCount + 1);
-         ratingCount++;
+    static GeoPoint zoneCentre(int zone) {
+        double cell = CITY_KM / GRID;
+        GeoPoint p;
+        p.x = (zone % GRID + 0.5) * cell;
+        p.y = (zone / GRID + 0.5) * cell;
+        return p;
     }
-};
 
-// --- USER HIERARCHY (ABSTRACTION, INHERITANCE, POLYMORPHISM) ---
-// -------------------------------------------------------------
-class User {
-protected:
-    string userId;
-    string name;
-    string password;
-    bool loggedIn;
-public:
-  User(const string& n, const string& p) {
-    this->userId = IDGenerator::generateUserID();
-    this->name = n;
-    this->password = p;
-    this->loggedIn = false;
-}
-    virtual ~User() = default; // calling the default destructor,if no derived class overrides the destructor
+    int zone() const {
+        int cx = min(GRID - 1, static_cast<int>(x / (CITY_KM / GRID)));
+        int cy = min(GRID - 1, static_cast<int>(y / (CITY_KM / GRID)));
+        return cy * GRID + cx;
+    }
 
-    virtual bool login(const string& id, const string& pass) = 0;
-    virtual void viewProfile() const = 0;
-    virtual bool registerUser() = 0;
+    double distanceTo(const GeoPoint& o) const { return hypot(x - o.x, y - o.y); }
+};
 
-    void logout()
-    {
-        if (loggedIn){
-            cout << "\n" << name << " (" << userId << ") logged out successfully." << endl;
-            loggedIn = false;
-        }
-    }
+// Hot-path instrumentation. Every thread records into its own shard: each
+// cell has a single writer, so a sample is a relaxed load/add/store with no
+// lock or read-modify-write. Snapshots merge all shards. Histograms are
+// HDR-style log-linear: 32 linear sub-buckets per power of two keep every
+// percentile within ~3% of the true value.
+enum HistogramId { HIST_PLACE_ORDER, HIST_UPDATE_STATUS, HIST_FILTER_DISHES, HIST_PAYMENT, HIST_RATING, HIST_RATING_FLUSH,
+                   HIST_ROUTE_ORDER, HISTOGRAM_COUNT };
+enum CounterId { CTR_ORDERS_PLACED, CTR_PAYMENTS_OK, CTR_PAYMENT_FAILURES, CTR_PARTNER_NOT_FOUND, CTR_RATINGS, COUNTER_COUNT };
+
+struct HistogramSummary {
+    uint64_t count = 0;
+    double meanNanos = 0, p50Nanos = 0, p99Nanos = 0, p999Nanos = 0, maxNanos = 0;
+};
 
-    //getter functions 
-    const string& getId() const { return userId; }
-    const string& getName() const { return name; }
-    bool isLoggedIn() const { return loggedIn; }
+struct MetricsSnapshot {
+    double uptimeSeconds = 0;
+    uint64_t counters[COUNTER_COUNT] = {};
+    HistogramSummary histograms[HISTOGRAM_COUNT];
 };
 
-class Customer : public User {
-private:
-    string deliveryAddress;
-    vector<Order*> orderHistory;
-    double loyaltyPoints;
+class Metrics {
 public:
-  Customer(const string& n, const string& p, const string& addr) : User(n, p){
-    this->deliveryAddress = addr;
-    this->loyaltyPoints = 0.0;
-}
+    static const int SUB_BITS = 5;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;
+    static const int BUCKET_COUNT = (64 - SUB_BITS + 1) * SUB_BUCKETS;
 
-    bool registerUser() override {
-        cout << "\n Customer " << name << " registered successfully with ID: " << userId << endl;
-        return true;
+private:
+    struct Shard {
+        atomic<uint64_t> counters[COUNTER_COUNT];
+        atomic<uint64_t> buckets[HISTOGRAM_COUNT][BUCKET_COUNT];
+        atomic<uint64_t> sums[HISTOGRAM_COUNT];
+        Shard() {
+            for (auto& c : counters) c.store(0, memory_order_relaxed);
+            for (auto& h : buckets) for (auto& b : h) b.store(0, memory_order_relaxed);
+            for (auto& sum : sums) sum.store(0, memory_order_relaxed);
+        }
+    };
+
+    mutex registryLock;
+    vector<unique_ptr<Shard>> shards; // kept after their thread exits so counts survive
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
+
+    static void bumpCell(atomic<uint64_t>& cell, uint64_t by) {
+        cell.store(cell.load(memory_order_relaxed) + by, memory_order_relaxed);
     }
 
-    bool login(const string& id, const string& pass) override {
-        if (userId == id && password == pass) {
-            loggedIn = true;
-            cout << "\n Welcome back, Customer " << name << "!" << endl;
-            return true;
+    Shard& local() {
+        thread_local Shard* mine = nullptr;
+        if (!mine) {
+            lock_guard<mutex> guard(registryLock);
+            shards.emplace_back(new Shard());
+            mine = shards.back().get();
         }
-        return false;
+        return *mine;
     }
 
-    void viewProfile() const override {
-        cout << "\n--- Customer Profile ---" << endl;
-        cout << "ID: " << userId << endl;
-        cout << "Name: " << name << endl;
-        cout << "Address: " << deliveryAddress << endl;
-        cout << "Loyalty Points: " << loyaltyPoints << endl;
-        cout << "Past Orders: " << orderHistory.size() << endl;
+    static uint64_t lowerBound(int index) {
+        if (index < SUB_BUCKETS) return index;
+        int shift = index / SUB_BUCKETS - 1;
+        return static_cast<uint64_t>(SUB_BUCKETS + index % SUB_BUCKETS) << shift;
     }
 
-    void addOrderToHistory(Order* order) {
-         orderHistory.push_back(order);
+public:
+    static Metrics& instance() {
+        static Metrics metrics;
+        return metrics;
     }
-    
-    const string& getAddress() const { return deliveryAddress; }
-    double getLoyaltyPoints() const { return loyaltyPoints; }
-    void addLoyaltyPoints(double points) { loyaltyPoints += points; }
-};
 
-class RestaurantOwner : public User {
-private:
-    vector<Restaurant*> ownedRestaurants;
-public:
-    RestaurantOwner(const string& n, const string& p)
-        : User(n, p) {}
+    static int bucketFor(uint64_t v) {
+        if (v < static_cast<uint64_t>(SUB_BUCKETS)) return static_cast<int>(v);
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - SUB_BITS;
+        return (shift + 1) * SUB_BUCKETS + static_cast<int>((v >> shift) - SUB_BUCKETS);
+    }
 
-    bool registerUser() override {
-        cout << "\n Restaurant Owner " << name << " registered successfully with ID: " << userId << endl;
-        return true;
+    void record(HistogramId id, uint64_t nanos) {
+        Shard& s = local();
+        bumpCell(s.buckets[id][bucketFor(nanos)], 1);
+        bumpCell(s.sums[id], nanos);
     }
 
-    bool login(const string& id, const string& pass) override {
-        if (userId == id && password == pass) {
-            loggedIn = true;
-            cout << "\n Welcome to your dashboard, Owner " << name << "!" << endl;
-            return true;
+    void count(CounterId id, uint64_t by = 1) { bumpCell(local().counters[id], by); }
+
+    MetricsSnapshot snapshot() {
+        MetricsSnapshot snap;
+        snap.uptimeSeconds = chrono::duration<double>(chrono::steady_clock::now() - started).count();
+        vector<uint64_t> merged(BUCKET_COUNT);
+
+        lock_guard<mutex> guard(registryLock);
+        for (int c = 0; c < COUNTER_COUNT; c++) {
+            for (auto& s : shards) snap.counters[c] += s->counters[c].load(memory_order_relaxed);
         }
-        return false;
-    }
+        for (int h = 0; h < HISTOGRAM_COUNT; h++) {
+            fill(merged.begin(), merged.end(), 0);
+            uint64_t sum = 0;
+            for (auto& s : shards) {
+                for (int b = 0; b < BUCKET_COUNT; b++) merged[b] += s->buckets[h][b].load(memory_order_relaxed);
+                sum += s->sums[h].load(memory_order_relaxed);
+            }
 
-    void viewProfile() const override {
-        cout << "\n--- Restaurant Owner Profile ---" << endl;
-        cout << "ID: " << userId << endl;
-        cout << "Name: " << name << endl;
-        cout << "Owned Restaurants: " << ownedRestaurants.size() << endl;
-        for (const auto& r : ownedRestaurants) {
-            cout << "  - " << r->getName() << " (" << r->getId() << ")" << endl;
+            HistogramSummary& out = snap.histograms[h];
+            for (uint64_t n : merged) out.count += n;
+            if (!out.count) continue;
+            out.meanNanos = static_cast<double>(sum) / out.count;
+
+            double* targets[3] = {&out.p50Nanos, &out.p99Nanos, &out.p999Nanos};
+            double quantiles[3] = {0.50, 0.99, 0.999};
+            uint64_t seen = 0;
+            int q = 0;
+            for (int b = 0; b < BUCKET_COUNT; b++) {
+                if (!merged[b]) continue;
+                seen += merged[b];
+                while (q < 3 && seen >= quantiles[q] * out.count) *targets[q++] = static_cast<double>(lowerBound(b));
+                out.maxNanos = static_cast<double>(lowerBound(b));
+            }
         }
+        return snap;
     }
+};
 
-    void addRestaurant(Restaurant* r) 
-    {
-         ownedRestaurants.push_back(r);
-         cout << "Restaurant '" << r->getName() << "' added to your portfolio." << endl;
+const char* const HISTOGRAM_NAMES[HISTOGRAM_COUNT] = {"place_order", "update_order_status", "filter_dishes", "payment", "rating_apply", "rating_flush", "route_order"};
+const char* const COUNTER_NAMES[COUNTER_COUNT] = {"orders_placed", "payments_ok", "payment_failures", "partner_not_found", "ratings"};
+
+// Times the enclosing scope into a histogram
+class ScopedTimer {
+private:
+    HistogramId id;
+    chrono::steady_clock::time_point start;
+public:
+    explicit ScopedTimer(HistogramId h) : id(h), start(chrono::steady_clock::now()) {}
+    ~ScopedTimer() {
+        Metrics::instance().record(id, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count());
     }
+};
 
-    const vector<Restaurant*>& getOwnedRestaurants() const { return ownedRestaurants; }
+// Memory per subsystem: live bytes, live blocks, allocations so far and the
+// peak. Containers opt in through TaggedAllocator; classes made one at a time
+// with `new` derive from Tracked, whose operator new books the whole object.
+// Only blocks a tag allocates itself count, so a string member's buffer (for
+// text past the ~15 chars kept inline) goes unaccounted. Booking is a few
+// relaxed atomic adds on the tag's own cache line.
+enum MemoryTag : uint8_t { MEM_CATALOG, MEM_USERS, MEM_ACTIVE_ORDERS, MEM_COMPLETED_ORDERS, MEM_CHAT, MEM_OFFERS, MEM_TAG_COUNT };
+const char* const MEMORY_TAG_NAMES[MEM_TAG_COUNT] = {"catalog", "users", "active_orders", "completed_orders", "chat", "offers"};
+
+struct MemoryUsage {
+    int64_t liveBytes = 0;
+    int64_t liveBlocks = 0;
+    int64_t peakBytes = 0;
+    uint64_t allocations = 0;
 };
 
-class DeliveryPartner : public User {
+class MemoryLedger {
 private:
-    string vehicleType;
-    double totalEarnings;
-    double averageRating;
-    int ratingCount;
-    bool isAvailable;
+    struct alignas(64) Account {
+        atomic<int64_t> liveBytes{0};
+        atomic<int64_t> liveBlocks{0};
+        atomic<int64_t> peakBytes{0};
+        atomic<uint64_t> allocations{0};
+    };
+    Account accounts[MEM_TAG_COUNT];
+
+    MemoryLedger() {}
+
 public:
-    DeliveryPartner(const string& n, const string& p, const string& vehicle): User(n, p) {
-    this->vehicleType = vehicle;
-    this->totalEarnings = 0.0;
-    this->averageRating = 5.0;
-    this->ratingCount = 1;
-    this->isAvailable = true;
-}
+    static MemoryLedger& instance() {
+        static MemoryLedger ledger;
+        return ledger;
+    }
 
-    bool registerUser() override {
-        cout << "\n Delivery Partner " << name << " registered successfully with ID: " << userId << endl;
-        return true;
+    void allocated(MemoryTag tag, size_t bytes) {
+        Account& a = accounts[tag];
+        int64_t live = a.liveBytes.fetch_add(static_cast<int64_t>(bytes), memory_order_relaxed) + static_cast<int64_t>(bytes);
+        a.liveBlocks.fetch_add(1, memory_order_relaxed);
+        a.allocations.fetch_add(1, memory_order_relaxed);
+        int64_t peak = a.peakBytes.load(memory_order_relaxed);
+        while (live > peak && !a.peakBytes.compare_exchange_weak(peak, live, memory_order_relaxed)) {}
     }
 
-    bool login(const string& id, const string& pass) override {
-        if (userId == id && password == pass) {
-            loggedIn = true;
-            cout << "\n Ready to deliver, Partner " << name << "!" << endl;
-            return true;
-        }
-        return false;
+    void freed(MemoryTag tag, size_t bytes) {
+        accounts[tag].liveBytes.fetch_sub(static_cast<int64_t>(bytes), memory_order_relaxed);
+        accounts[tag].liveBlocks.fetch_sub(1, memory_order_relaxed);
     }
 
-    void viewProfile() const override {
-        cout << "\n--- Delivery Partner Profile ---" << endl;
-        cout << "ID: " << userId << endl;
-        cout << "Name: " << name << endl;
-        cout << "Vehicle: " << vehicleType << endl;
-        cout << "Earnings: $" << fixed << setprecision(2) << totalEarnings << endl;
-        cout << "Rating: " << fixed << setprecision(1) << averageRating << "⭐" << endl;
-        cout << "Status: " << (isAvailable ? "Available" : "On Delivery") << endl;
+    MemoryUsage usage(MemoryTag tag) const {
+        const Account& a = accounts[tag];
+        MemoryUsage u;
+        u.liveBytes = a.liveBytes.load(memory_order_relaxed);
+        u.liveBlocks = a.liveBlocks.load(memory_order_relaxed);
+        u.peakBytes = a.peakBytes.load(memory_order_relaxed);
+        u.allocations = a.allocations.load(memory_order_relaxed);
+        return u;
     }
+};
 
-    void completeDelivery(double earnings, int rating) 
-    {
-         totalEarnings += earnings;
-         averageRating = (averageRating * ratingCount + rating) / (ratingCount + 1);
-         ratingCount++;
-         isAvailable = true;
+template <class T, MemoryTag Tag>
+struct TaggedAllocator {
+    using value_type = T;
+    template <class U> struct rebind { using other = TaggedAllocator<U, Tag>; };
+
+    TaggedAllocator() = default;
+    template <class U> TaggedAllocator(const TaggedAllocator<U, Tag>&) {}
+
+    T* allocate(size_t n) {
+        MemoryLedger::instance().allocated(Tag, n * sizeof(T));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+    void deallocate(T* p, size_t n) {
+        MemoryLedger::instance().freed(Tag, n * sizeof(T));
+        ::operator delete(p, n * sizeof(T));
     }
-    
-    void startDelivery() { isAvailable = false; }
-    bool isCurrentlyAvailable() const { return isAvailable; }
 };
 
-// --- OFFERS, CART, ORDER ---
-// -------------------------------------------------------------
-class Offer {
+template <class T, class U, MemoryTag Tag>
+bool operator==(const TaggedAllocator<T, Tag>&, const TaggedAllocator<U, Tag>&) { return true; }
+template <class T, class U, MemoryTag Tag>
+bool operator!=(const TaggedAllocator<T, Tag>&, const TaggedAllocator<U, Tag>&) { return false; }
+
+// Sized delete gets the dynamic type's size, so derived classes book correctly.
+// Both stay out of line: inlined, GCC's -Wmismatched-new-delete misreads the pair.
+template <MemoryTag Tag>
+struct Tracked {
+    __attribute__((noinline)) static void* operator new(size_t bytes) {
+        MemoryLedger::instance().allocated(Tag, bytes);
+        return ::operator new(bytes);
+    }
+    __attribute__((noinline)) static void operator delete(void* p, size_t bytes) {
+        MemoryLedger::instance().freed(Tag, bytes);
+        ::operator delete(p);
+    }
+};
+
+// Notes what each tag holds when made; anything still live beyond that when
+// it goes is reported as leaked. Declared first in its owner, so it goes last.
+class MemoryAudit {
 private:
-    string promoCode;
-    double discountValue;
-    bool isPercentage;
-    int minOrderValue;
-public:
-   Offer(const string& code, double value, bool isP, int minVal) {
-    this->promoCode = code;
-    this->discountValue = value;
-    this->isPercentage = isP;
-    this->minOrderValue = minVal;
-}
+    const char* owner;
+    MemoryUsage baseline[MEM_TAG_COUNT];
 
+public:
+    explicit MemoryAudit(const char* name) : owner(name) {
+        for (int t = 0; t < MEM_TAG_COUNT; t++) baseline[t] = MemoryLedger::instance().usage(static_cast<MemoryTag>(t));
+    }
 
-    const string& getCode() const { return promoCode; }
+    ~MemoryAudit();
+};
 
-    double applyDiscount(double subtotal, const Customer* cust) const {
-        if (subtotal < minOrderValue)
-        {
-            cout << "    [Offer Failed] Minimum order value of $" << minOrderValue << " not met." << endl;
-            return 0.0;
-        }
-        if (promoCode == "LOYALTY50" && cust && cust->getLoyaltyPoints() < 10.0)
-        {
-            cout << "    [Offer Failed] Not enough loyalty points." << endl;
-            return 0.0;
+// Epoch-based reclamation for data published through an atomic pointer.
+// Readers pin the current epoch for the length of a read; that is two plain
+// stores on their own slot, so reads never wait on anyone. A writer swaps in
+// a new version and retires the old one, which is freed once every reader
+// that could still see it has left. Pins nest.
+class EpochDomain {
+private:
+    struct Slot {
+        atomic<uint64_t> active{0}; // epoch pinned by this thread, 0 when idle
+        int depth = 0;
+    };
+    struct Retired {
+        uint64_t epoch;
+        function<void()> release;
+    };
+
+    atomic<uint64_t> globalEpoch{1};
+    mutex lock; // registration and the retired list; readers only take it once per thread
+    vector<unique_ptr<Slot>> slots;
+    vector<Retired> retired;
+
+    Slot& local() {
+        thread_local Slot* mine = nullptr;
+        if (!mine) {
+            lock_guard<mutex> guard(lock);
+            slots.emplace_back(new Slot());
+            mine = slots.back().get();
         }
+        return *mine;
+    }
 
-        if (isPercentage)
-        {
-            double discount = subtotal * (discountValue / 100.0);
-            cout << "    [Offer Applied] " << discountValue << "% off: -$" << fixed << setprecision(2) << discount << endl;
-            return discount;
-        }
-        else
-        {
-            cout << "    [Offer Applied] $" << discountValue << " off: -$" << fixed << setprecision(2) << discountValue << endl;
-            return discountValue;
-        }
+public:
+    static EpochDomain& instance() {
+        static EpochDomain domain;
+        return domain;
     }
-};
 
-class Cart {
-private:
-    map<Dish, int> items;
-public:
-    void addItem(const Dish& dish, int quantity = 1) {
-         items[dish] += quantity;
-         cout << quantity << "x " << dish.getName() << " added to cart." << endl;
+    ~EpochDomain() {
+        for (Retired& r : retired) r.release();
     }
 
-    void removeItem(const string& dishName) 
-    {
-         for (auto it = items.begin(); it != items.end(); ++it) 
-         {
-             if (it->first.getName() == dishName) {
-                 items.erase(it);
-                 cout << dishName << " removed from cart." << endl;
-                 return;
-             }
-         }
+    void enter() {
+        Slot& s = local();
+        if (s.depth++ == 0) s.active.store(globalEpoch.load(memory_order_seq_cst), memory_order_seq_cst);
     }
 
-    double calculateSubtotal() const {
-        double total = 0.0;
-        for (const auto& pair : items) {
-            total += pair.first.getPrice() * pair.second;
+    void exit() {
+        Slot& s = local();
+        if (--s.depth == 0) s.active.store(0, memory_order_release);
+    }
+
+    // Call after the old version is unreachable from the published pointer
+    void retire(function<void()> release) {
+        {
+            lock_guard<mutex> guard(lock);
+            retired.push_back({globalEpoch.fetch_add(1, memory_order_seq_cst), move(release)});
         }
-        return total;
+        reclaim();
     }
 
-    void displayCart() const {
-        cout << "\n--- Your Cart ---" << endl;
-        if (items.empty()) {
-            cout << "Cart is empty." << endl;
-            return;
+    // Frees every retired version no reader can still see
+    void reclaim() {
+        vector<function<void()>> ready;
+        {
+            lock_guard<mutex> guard(lock);
+            uint64_t oldestPinned = numeric_limits<uint64_t>::max();
+            for (auto& slot : slots) {
+                uint64_t e = slot->active.load(memory_order_seq_cst);
+                if (e) oldestPinned = min(oldestPinned, e);
+            }
+            auto keep = retired.begin();
+            for (auto it = retired.begin(); it != retired.end(); ++it) {
+                if (it->epoch < oldestPinned) ready.push_back(move(it->release));
+                else *keep++ = move(*it);
+            }
+            retired.erase(keep, retired.end());
         }
-        for (const auto& pair : items) {
-            cout << fixed << setprecision(2)
-                     << pair.second << "x " << pair.first.getName()
-                     << " @ $" << pair.first.getPrice()
-                     << " = $" << (pair.first.getPrice() * pair.second)
-                     << endl;
+        for (auto& r : ready) r();
+    }
+};
+
+MemoryAudit::~MemoryAudit() {
+    EpochDomain::instance().reclaim(); // menu versions retired but not yet freed
+    for (int t = 0; t < MEM_TAG_COUNT; t++) {
+        MemoryUsage now = MemoryLedger::instance().usage(static_cast<MemoryTag>(t));
+        int64_t blocks = now.liveBlocks - baseline[t].liveBlocks;
+        if (blocks > 0) {
+            cout << "[Leak] " << owner << ": " << blocks << " " << MEMORY_TAG_NAMES[t] << " blocks ("
+                 << now.liveBytes - baseline[t].liveBytes << " bytes) still live at shutdown" << endl;
         }
-        cout << "Subtotal: $" << calculateSubtotal() << endl;
-        cout << "-----------------" << endl;
     }
+}
 
-    const map<Dish, int>& getItems() const { return items; }
-    bool isEmpty() const { return items.empty(); }
+class EpochGuard {
+public:
+    EpochGuard() { EpochDomain::instance().enter(); }
+    ~EpochGuard() { EpochDomain::instance().exit(); }
+    EpochGuard(const EpochGuard&) = delete;
+    EpochGuard& operator=(const EpochGuard&) = delete;
 };
 
-class Order {
-private:
-    string orderID;
-    string customerId;
-    string restaurantId;
-    string partnerId;
-    Cart orderCart;
-    string deliveryAddress;
-    string status; 
-    double subtotal;
-    double discountApplied;
-    double deliveryTip;
-    double finalAmount;
+class Notification {
 public:
-    Order(const Customer* c, const Restaurant* r, const Cart& cart) {
-    this->orderID = IDGenerator::generateOrderID();
-    this->customerId = c->getId();
-    this->restaurantId = r->getId();
-    this->orderCart = cart;
-    this->deliveryAddress = c->getAddress();
-    this->status = STATUS_PENDING;  // Use string constant
-    this->subtotal = cart.calculateSubtotal();
-    this->discountApplied = 0.0;
-    this->deliveryTip = 0.0;
-    this->finalAmount = this->subtotal;
-}
+    void sendNotification(const string& userId, const string& message) const {
+        cout << "\n[Notification to " << userId << "]: " << message << endl;
+    }
+};
 
-    const string& getId() const { return orderID; }
-    const string& getCustomerId() const { return customerId; }
-    const string& getRestaurantId() const { return restaurantId; }
-    const string& getStatus() const { return status; } // Return string
-    double getFinalAmount() const { return finalAmount; }
-    const string& getPartnerId() const { return partnerId; }
+// --- PUBLISHED RATINGS ---
+// -------------------------------------------------------------
+// Every rated thing (restaurant, dish, delivery partner) owns a handle into
+// this board. Each slot packs the published score and review count into one
+// atomic word, so readers never lock and never see a torn pair. Chunks are
+// never moved once allocated, which keeps handles stable while the board grows.
+class RatingBoard {
+private:
+    static const size_t CHUNK_SIZE = 4096;
+    static const size_t MAX_CHUNKS = 4096; // 16M handles
 
-    void applyOffer(const Offer& offer, const Customer* cust) {
-         discountApplied = offer.applyDiscount(subtotal, cust);
-         finalAmount = subtotal - discountApplied;
+    struct Chunk { atomic<uint64_t> slots[CHUNK_SIZE]; };
+
+    atomic<Chunk*> chunks[MAX_CHUNKS];
+    atomic<uint32_t> nextHandle;
+    mutex growLock;
+
+    static uint64_t pack(uint32_t milliStars, uint32_t count) { return (static_cast<uint64_t>(milliStars) << 32) | count; }
+
+    atomic<uint64_t>& slot(uint32_t handle) const {
+        return chunks[handle / CHUNK_SIZE].load(memory_order_acquire)->slots[handle % CHUNK_SIZE];
     }
 
-    void addTip(double tip) {
-         deliveryTip = tip;
-         finalAmount += tip;
+    RatingBoard() : nextHandle(0) {
+        for (auto& c : chunks) c.store(nullptr, memory_order_relaxed);
     }
 
-    void setStatus(const string& newStatus) {
-         status = newStatus;
+public:
+    ~RatingBoard() {
+        for (auto& c : chunks) delete c.load(memory_order_relaxed);
     }
 
-    void assignPartner(const string& pId) {
-         partnerId = pId;
+    static RatingBoard& instance() {
+        static RatingBoard board;
+        return board;
     }
 
-    void displayDetails() const {
-        cout << "\n===================================" << endl;
-        cout << "          ORDER SUMMARY" << endl;
-        cout << "===================================" << endl;
-        cout << "Order ID: " << orderID << endl;
-        cout << "Status: " << status << endl; 
-        cout << "Delivery To: " << deliveryAddress << endl;
-        cout << "Subtotal: $" << fixed << setprecision(2) << subtotal << endl;
-        cout << "Discount: -$" << fixed << setprecision(2) << discountApplied << endl;
-        cout << "Tip: $" << fixed << setprecision(2) << deliveryTip << endl;
-        cout << "-----------------------------------" << endl;
-        cout << "TOTAL: $" << fixed << setprecision(2) << finalAmount << endl;
-        cout << "===================================" << endl;
+    // Slots are not recycled; a removed dish leaves 8 unused bytes behind
+    uint32_t allocate(double initialStars = 0.0, uint32_t initialCount = 0) {
+        uint32_t handle = nextHandle.fetch_add(1, memory_order_relaxed);
+        size_t chunk = handle / CHUNK_SIZE;
+        if (!chunks[chunk].load(memory_order_acquire)) {
+            lock_guard<mutex> guard(growLock);
+            if (!chunks[chunk].load(memory_order_relaxed)) {
+                Chunk* fresh = new Chunk();
+                for (auto& s : fresh->slots) s.store(0, memory_order_relaxed);
+                chunks[chunk].store(fresh, memory_order_release);
+            }
+        }
+        publish(handle, static_cast<uint32_t>(llround(initialStars * 1000)), initialCount);
+        return handle;
     }
 
-    const map<Dish, int>& getDishes() const { return orderCart.getItems(); }
-    double getTip() const { return deliveryTip; }
+    void publish(uint32_t handle, uint32_t milliStars, uint32_t count) {
+        slot(handle).store(pack(milliStars, count), memory_order_release);
+    }
+
+    double getStars(uint32_t handle) const { return (slot(handle).load(memory_order_acquire) >> 32) / 1000.0; }
+    uint32_t getCount(uint32_t handle) const { return static_cast<uint32_t>(slot(handle).load(memory_order_acquire)); }
 };
 
-// ---PAYMENT & CHAT (ABSTRACTION/SIMULATION) ---
+// --- STOCK ---
 // -------------------------------------------------------------
-class Payment {
+// Units left of each dish at each branch. A dish owns a handle here the way
+// it owns one on the RatingBoard. Branches with no cell for a dish never run
+// out. A cell splits its units over a few stripes on separate cache lines;
+// each thread draws from its own stripe first, so a rush on one popular dish
+// spreads over several lines instead of piling onto one. Units only move by
+// CAS that never goes below zero, so a dish can't be oversold.
+class StockBoard {
 public:
-    virtual bool processPayment(double amount) const = 0;
-    virtual string getMode() const = 0;
-    virtual ~Payment() = default;
-};
+    static const int MAX_BRANCHES = 16;
+    static const int UNLIMITED = -1;
 
-class UPIPayment : public Payment {
-public:
-    bool processPayment(double amount) const override {
-        cout << "Processing UPI Payment of $" << fixed << setprecision(2) << amount << "..." << endl;
-        return (rand() % 100 < 90);
+private:
+    static const int STRIPES = 4;
+    static const size_t CHUNK_SIZE = 1024;
+    static const size_t MAX_CHUNKS = 16384; // 16M dishes
+
+    struct alignas(64) Stripe { atomic<int32_t> units{0}; };
+    struct Cell {
+        Stripe stripes[STRIPES];
+        atomic<bool> limited{true};
+    };
+    struct Slot {
+        atomic<Cell*> branches[MAX_BRANCHES];
+        atomic<bool> soldOut{false};
+    };
+    struct Chunk { Slot slots[CHUNK_SIZE]; };
+
+    atomic<Chunk*> chunks[MAX_CHUNKS];
+    atomic<uint32_t> nextHandle{0};
+    mutex growLock;
+
+    StockBoard() {
+        for (auto& c : chunks) c.store(nullptr, memory_order_relaxed);
     }
-    string getMode() const override { return PAY_UPI; }
-};
 
-class COD : public Payment {
-public:
-    bool processPayment(double amount) const override {
-        cout << "Cash on Delivery confirmed. Please keep $" << fixed << setprecision(2) << amount << " ready." << endl;
-        return true;
+    Slot& slot(uint32_t handle) const {
+        return chunks[handle / CHUNK_SIZE].load(memory_order_acquire)->slots[handle % CHUNK_SIZE];
+    }
+
+    Cell* cell(uint32_t handle, int branch) const {
+        if (branch < 0 || branch >= MAX_BRANCHES) return nullptr;
+        Cell* c = slot(handle).branches[branch].load(memory_order_acquire);
+        return (c && c->limited.load(memory_order_relaxed)) ? c : nullptr;
+    }
+
+    static int homeStripe() {
+        thread_local int home = static_cast<int>(hash<thread::id>()(this_thread::get_id()) % STRIPES);
+        return home;
+    }
+
+    // Takes up to `want` from one stripe; returns how many it got
+    static int32_t take(atomic<int32_t>& units, int32_t want) {
+        int32_t have = units.load(memory_order_relaxed);
+        while (have > 0) {
+            int32_t got = min(have, want);
+            if (units.compare_exchange_weak(have, have - got, memory_order_acq_rel)) return got;
+        }
+        return 0;
     }
-    string getMode() const override { return PAY_COD; }
-};
 
-class Chat {
-private:
-    string orderId;
-    vector<pair<string, string>> messages;
 public:
-    Chat(const string& oId) : orderId(oId) {}
+    ~StockBoard() {
+        for (auto& c : chunks) {
+            Chunk* chunk = c.load(memory_order_relaxed);
+            if (!chunk) continue;
+            for (Slot& s : chunk->slots) {
+                for (auto& b : s.branches) delete b.load(memory_order_relaxed);
+            }
+            delete chunk;
+        }
+    }
 
-    void sendMessage(const string& sender, const string& text) {
-         messages.push_back({sender, text});
-         cout << "[" << sender << "]: " << text << endl;
+    static StockBoard& instance() {
+        static StockBoard board;
+        return board;
     }
 
-    // Updated to check string constants
-    void autoGenerateMessage(const string& status) 
-    {
-        string autoMessage;
-        if (status == STATUS_PREPARING) {
-            autoMessage = "Your order is being prepared by the restaurant!";
-        } else if (status == STATUS_OUT_FOR_DELIVERY) {
-            autoMessage = "Your food is out for delivery and should reach you shortly!";
-        } else if (status == STATUS_DELIVERED) {
-            autoMessage = "Enjoy your meal! Please don't forget to rate.";
-        } else {
-            return;
+    uint32_t allocate() {
+        uint32_t handle = nextHandle.fetch_add(1, memory_order_relaxed);
+        size_t chunk = handle / CHUNK_SIZE;
+        if (!chunks[chunk].load(memory_order_acquire)) {
+            lock_guard<mutex> guard(growLock);
+            if (!chunks[chunk].load(memory_order_relaxed)) {
+                Chunk* fresh = new Chunk();
+                for (Slot& s : fresh->slots) {
+                    for (auto& b : s.branches) b.store(nullptr, memory_order_relaxed);
+                }
+                chunks[chunk].store(fresh, memory_order_release);
+            }
         }
-        sendMessage("System Bot", autoMessage);
+        return handle;
     }
 
-    void displayHistory() const {
-        cout << "\n--- Chat History for " << orderId << " ---" << endl;
-        for (const auto& msg : messages) {
-            cout << "[" << msg.first << "]: " << msg.second << endl;
+    // Sets the count outright (UNLIMITED stops tracking). Meant for owners
+    // restocking; reservations racing with it may land on either side.
+    void setStock(uint32_t handle, int branch, int32_t units) {
+        if (branch < 0 || branch >= MAX_BRANCHES) return;
+        atomic<Cell*>& ref = slot(handle).branches[branch];
+        Cell* c = ref.load(memory_order_acquire);
+        if (!c) {
+            if (units == UNLIMITED) return;
+            lock_guard<mutex> guard(growLock);
+            c = ref.load(memory_order_relaxed);
+            if (!c) {
+                c = new Cell();
+                ref.store(c, memory_order_release);
+            }
+        }
+        for (int s = 0; s < STRIPES; s++) {
+            int32_t share = units == UNLIMITED ? 0 : units / STRIPES + (s < units % STRIPES ? 1 : 0);
+            c->stripes[s].units.store(share, memory_order_relaxed);
+        }
+        c->limited.store(units != UNLIMITED, memory_order_release);
+    }
+
+    // UNLIMITED when the branch doesn't track this dish
+    int32_t available(uint32_t handle, int branch) const {
+        Cell* c = cell(handle, branch);
+        if (!c) return UNLIMITED;
+        int32_t total = 0;
+        for (const Stripe& s : c->stripes) total += s.units.load(memory_order_relaxed);
+        return total;
+    }
+
+    // All or nothing: either `qty` units are taken or none are
+    bool reserve(uint32_t handle, int branch, int32_t qty) {
+        Cell* c = cell(handle, branch);
+        if (!c) return true;
+        int home = homeStripe();
+        int32_t got = take(c->stripes[home].units, qty);
+        for (int i = 1; i < STRIPES && got < qty; i++) got += take(c->stripes[(home + i) % STRIPES].units, qty - got);
+        if (got < qty) {
+            if (got) c->stripes[home].units.fetch_add(got, memory_order_acq_rel);
+            return false;
         }
+        return true;
+    }
+
+    void release(uint32_t handle, int branch, int32_t qty) {
+        if (Cell* c = cell(handle, branch)) c->stripes[homeStripe()].units.fetch_add(qty, memory_order_acq_rel);
+    }
+
+    // A dish is sold out when none of its restaurant's branches has a unit left
+    void refreshSoldOut(uint32_t handle, int branchCount) {
+        bool out = branchCount > 0;
+        for (int b = 0; b < branchCount && out; b++) out = available(handle, b) == 0;
+        slot(handle).soldOut.store(out, memory_order_relaxed);
     }
+
+    bool isSoldOut(uint32_t handle) const { return slot(handle).soldOut.load(memory_order_relaxed); }
 };
 
-// --- RATING ---
+// --- DISH AND MENU ---
 // -------------------------------------------------------------
-class SystemManager;
+class Dish {
+private:
+    string dishId;
+    string name;
+    Money price;
+    string type;    
+    string cuisine; 
+    string course;  
+    uint32_t ratingHandle; // shared by every copy of this dish
+    uint32_t stockHandle;  // likewise, on the StockBoard
+    int prepMinutes;
 
-class Rating {
 public:
-    void apply(Order* order, SystemManager& manager, int foodStars, int deliveryStars, const string& feedback);
+    Dish(const string& n, double p, const string& t, const string& c, const string& cs, int prep = 15)
+    {
+       this->dishId = "D" + to_string(RunContext::instance().random() % 1000 + 100);
+       this->name = n;
+       this->price = Money::fromDollars(p);
+       this->type = t;
+       this->cuisine = c;
+       this->course = cs;
+       this->ratingHandle = RatingBoard::instance().allocate();
+       this->stockHandle = StockBoard::instance().allocate();
+       this->prepMinutes = prep;
+    }
+
+    //getter functions since the name, id etc... are declared as private in the class dish
+    const string& getName() const { return name; }
+    const string& getId() const { return dishId; }
+    Money getPrice() const { return price; }
+    void setPrice(Money p) { price = p; } // only on a copy headed for a new menu snapshot
+    const string& getType() const { return type; }      
+    const string& getCuisine() const { return cuisine; }
+    const string& getCourse() const { return course; }  
+    double getRating() const { return RatingBoard::instance().getStars(ratingHandle); }
+    uint32_t getRatingCount() const { return RatingBoard::instance().getCount(ratingHandle); }
+    uint32_t getRatingHandle() const { return ratingHandle; }
+    int getPrepMinutes() const { return prepMinutes; }
+    uint32_t getStockHandle() const { return stockHandle; }
+    bool isSoldOut() const { return StockBoard::instance().isSoldOut(stockHandle); }
+
+    void display() const 
+    {
+        cout << fixed << setprecision(2)
+                 << "    - [" << dishId << "] " << name
+                 << " (" << type << ")" 
+                 << " | Price: $" << price
+                 << " | Rating: " << (getRatingCount() > 0 ? to_string(getRating()).substr(0, 3) : "N/A")
+                 << (isSoldOut() ? " | SOLD OUT" : "")
+                 << endl;
+    }
 };
 
+bool operator<(const Dish &a, const Dish &b)
+{
+    return a.getName() < b.getName();
+}
 
-// --- SYSTEM MANAGER (GLOBAL DATA AND LOGIC) ---
-// -------------------------------------------------------------
-class SystemManager {
-private:
-    vector<User*> allUsers;
-    vector<Restaurant*> allRestaurants;
-    vector<Order*> activeOrders;
-    vector<Order*> completedOrders; 
-    vector<Offer> availableOffers;
-    Notification notifier;
+// Dish -> quantity in a cart, and in the order made from it
+using CartItems = map<Dish, int, less<Dish>, TaggedAllocator<pair<const Dish, int>, MEM_ACTIVE_ORDERS>>;
 
-    void seedData() 
-    {
-        allUsers.push_back(new Customer("Alice", "pass", "101 Maple St"));
-        allUsers.push_back(new RestaurantOwner("ChefBob", "pass"));
-        allUsers.push_back(new DeliveryPartner("Dan", "pass", "Bike"));
-        
-        // Updated to use string constants in constructors
-        Restaurant* r1 = new Restaurant("Spice Garden", CUISINE_INDIAN, "spice@mail.com");
-        r1->getMenu().addDish({"Paneer Butter Masala", 12.50, DISH_VEG, CUISINE_INDIAN, COURSE_DINNER});
-        r1->getMenu().addDish({"Veg Biryani", 10.00, DISH_VEG, CUISINE_INDIAN, COURSE_LUNCH});
-        r1->getMenu().addDish({"Chicken Tikka", 15.00, DISH_NON_VEG, CUISINE_INDIAN, COURSE_DINNER});
-        
-        Restaurant* r2 = new Restaurant("Pizza Hub", CUISINE_ITALIAN, "pizza@mail.com");
-        r2->getMenu().addDish({"Margherita Pizza", 18.00, DISH_VEG, CUISINE_ITALIAN, COURSE_DINNER});
-        r2->getMenu().addDish({"Pepperoni Pizza", 20.00, DISH_NON_VEG, CUISINE_ITALIAN, COURSE_DINNER});
+// Told about menu changes so catalog-wide indexes can update incrementally
+class CatalogListener {
+public:
+    virtual void onDishAdded(const Restaurant& r, const Dish& d) = 0;
+    virtual void onDishRemoved(const Restaurant& r, const Dish& d) = 0;
+    virtual ~CatalogListener() = default;
+};
 
-        allRestaurants.push_back(r1);
-        allRestaurants.push_back(r2);
+// One published version of a menu. Never changed once published.
+using DishList = vector<Dish, TaggedAllocator<Dish, MEM_CATALOG>>;
 
-        dynamic_cast<RestaurantOwner*>(allUsers[1])->addRestaurant(r1);
-        dynamic_cast<RestaurantOwner*>(allUsers[1])->addRestaurant(r2);
+struct MenuSnapshot : Tracked<MEM_CATALOG> {
+    DishList dishes;
+    unordered_map<uint32_t, size_t, hash<uint32_t>, equal_to<uint32_t>,
+                  TaggedAllocator<pair<const uint32_t, size_t>, MEM_CATALOG>> byHandle; // dish rating handle -> index
 
-        availableOffers.push_back({"FIRST30", 30.0, false, 50});
-        availableOffers.push_back({"LOYALTY50", 50.0, true, 20});
+    void reindex() {
+        byHandle.clear();
+        for (size_t i = 0; i < dishes.size(); i++) byHandle[dishes[i].getRatingHandle()] = i;
     }
+};
 
+// Menu changes for clients that keep a local copy. A delta names the dishes
+// that changed since the client's version and carries their current state,
+// so applying one twice, or one that overlaps the last, is harmless.
+//
+// Layout: "MD" 1 | from | to | full | count | records, numbers as varints.
+// Record: kind | dish handle | payload by kind:
+//   ADDED     id name type cuisine course | cents prep milliStars ratings
+//   REMOVED   -
+//   REPRICED  cents
+//   RERATED   milliStars ratings
+// `full` means the client is too far behind: drop everything, then apply.
+enum MenuChangeKind { CHANGE_ADDED = 1, CHANGE_REMOVED = 2, CHANGE_REPRICED = 4, CHANGE_RERATED = 8 };
+
+class MenuDelta {
 public:
-    SystemManager() {
-        srand(time(0));
-        seedData();
-        cout << "FoodMate System Initialized." << endl;
+    static void putVarint(vector<uint8_t>& out, uint64_t v) {
+        while (v >= 0x80) { out.push_back(static_cast<uint8_t>(v | 0x80)); v >>= 7; }
+        out.push_back(static_cast<uint8_t>(v));
     }
 
-    ~SystemManager() {
-        for (User* u : allUsers) delete u;
-        for (Restaurant* r : allRestaurants) delete r;
-        for (Order* o : activeOrders) delete o;      // Deletes any incomplete orders
-        for (Order* o : completedOrders) delete o; // Deletes all finished orders
+    static void putString(vector<uint8_t>& out, const string& str) {
+        putVarint(out, str.size());
+        out.insert(out.end(), str.begin(), str.end());
     }
 
-    User* findUser(const string& id) {
-    for (User* u : allUsers) {
-        if (u->getId() == id) {
-            return u;
+    static bool getVarint(const vector<uint8_t>& in, size_t& pos, uint64_t& v) {
+        v = 0;
+        for (int shift = 0; pos < in.size() && shift < 64; shift += 7) {
+            uint8_t byte = in[pos++];
+            v |= static_cast<uint64_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) return true;
         }
+        return false;
     }
-    return nullptr;
-}
 
-   Restaurant* findRestaurant(const string& id) {
-    for (Restaurant* r : allRestaurants) {
-        if (r->getId() == id) {
-            return r;
-        }
-    }
-    return nullptr;
-}
-    
-    // getter functions ,Public Accessors
-    const vector<Restaurant*>& getRestaurants() const { return allRestaurants; }
-    const vector<Offer>& getOffers() const { return availableOffers; }
-    const vector<User*>& getUsers() const { return allUsers; }
-    
-    // User Management
-    void addUser(User* u) { allUsers.push_back(u); }
-    
-    void addRestaurant(Restaurant* r) {
-         allRestaurants.push_back(r);
+    static bool getString(const vector<uint8_t>& in, size_t& pos, string& str) {
+        uint64_t n;
+        if (!getVarint(in, pos, n) || n > in.size() - pos) return false;
+        str.assign(in.begin() + pos, in.begin() + pos + n);
+        pos += n;
+        return true;
     }
 
-    // Order Management
-    void placeOrder(Order* order) {
-    // Add the order to the active orders list
-    activeOrders.push_back(order);
+    static uint32_t milliStars(uint32_t handle) {
+        return static_cast<uint32_t>(llround(RatingBoard::instance().getStars(handle) * 1000));
+    }
 
-    // Notify customer that order is received
-    notifier.sendNotification(order->getCustomerId(),"Order " + order->getId() + " received! Status: " + order->getStatus()
-    );
+    static void putDish(vector<uint8_t>& out, const Dish& d) {
+        out.push_back(CHANGE_ADDED);
+        putVarint(out, d.getRatingHandle());
+        putString(out, d.getId());
+        putString(out, d.getName());
+        putString(out, d.getType());
+        putString(out, d.getCuisine());
+        putString(out, d.getCourse());
+        putVarint(out, d.getPrice().getCents());
+        putVarint(out, d.getPrepMinutes());
+        putVarint(out, milliStars(d.getRatingHandle()));
+        putVarint(out, RatingBoard::instance().getCount(d.getRatingHandle()));
+    }
+};
 
-    DeliveryPartner* partner = nullptr;
+// Client-side copy of one menu, kept current by applying deltas
+struct MenuReplica {
+    struct Entry {
+        string id, name, type, cuisine, course;
+        long long priceCents = 0;
+        int prepMinutes = 0;
+        uint32_t milliStars = 0, ratings = 0;
+    };
+
+    uint64_t version = 0;
+    map<uint32_t, Entry> dishes;
+
+    bool apply(const vector<uint8_t>& delta) {
+        size_t pos = 3;
+        uint64_t from, to, full, count;
+        if (delta.size() < 3 || delta[0] != 'M' || delta[1] != 'D' || delta[2] != 1) return false;
+        if (!MenuDelta::getVarint(delta, pos, from) || !MenuDelta::getVarint(delta, pos, to) ||
+            !MenuDelta::getVarint(delta, pos, full) || !MenuDelta::getVarint(delta, pos, count)) return false;
+        if (!full && from > version) return false; // a gap; ask again from our version
+
+        map<uint32_t, Entry> next = full ? map<uint32_t, Entry>() : dishes;
+        for (uint64_t i = 0; i < count; i++) {
+            if (pos >= delta.size()) return false;
+            uint8_t kind = delta[pos++];
+            uint64_t handle, a, b;
+            if (!MenuDelta::getVarint(delta, pos, handle)) return false;
+            if (kind == CHANGE_REMOVED) {
+                next.erase(static_cast<uint32_t>(handle));
+            } else if (kind == CHANGE_REPRICED) {
+                if (!MenuDelta::getVarint(delta, pos, a)) return false;
+                next[static_cast<uint32_t>(handle)].priceCents = static_cast<long long>(a);
+            } else if (kind == CHANGE_RERATED) {
+                if (!MenuDelta::getVarint(delta, pos, a) || !MenuDelta::getVarint(delta, pos, b)) return false;
+                Entry& e = next[static_cast<uint32_t>(handle)];
+                e.milliStars = static_cast<uint32_t>(a);
+                e.ratings = static_cast<uint32_t>(b);
+            } else if (kind == CHANGE_ADDED) {
+                Entry e;
+                uint64_t cents, prep, milli, ratings;
+                if (!MenuDelta::getString(delta, pos, e.id) || !MenuDelta::getString(delta, pos, e.name) ||
+                    !MenuDelta::getString(delta, pos, e.type) || !MenuDelta::getString(delta, pos, e.cuisine) ||
+                    !MenuDelta::getString(delta, pos, e.course) || !MenuDelta::getVarint(delta, pos, cents) ||
+                    !MenuDelta::getVarint(delta, pos, prep) || !MenuDelta::getVarint(delta, pos, milli) ||
+                    !MenuDelta::getVarint(delta, pos, ratings)) return false;
+                e.priceCents = static_cast<long long>(cents);
+                e.prepMinutes = static_cast<int>(prep);
+                e.milliStars = static_cast<uint32_t>(milli);
+                e.ratings = static_cast<uint32_t>(ratings);
+                next[static_cast<uint32_t>(handle)] = e;
+            } else {
+                return false;
+            }
+        }
+        dishes.swap(next);
+        version = max(version, to);
+        return true;
+    }
+};
 
-    // Find an available delivery partner
-    for (User* u : allUsers) 
-    {
-        DeliveryPartner* dp = dynamic_cast<DeliveryPartner*>(u);
-        if (dp && dp->isCurrentlyAvailable()) {
-            partner = dp;
-            break;
+// A menu version held open for reading. It stays valid, and the same, for
+// as long as the pin lives, whatever owners do to the menu meanwhile.
+class MenuPin {
+private:
+    EpochGuard guard;
+    const MenuSnapshot* snap;
+public:
+    explicit MenuPin(const atomic<const MenuSnapshot*>& current) : snap(current.load(memory_order_seq_cst)) {}
+
+    const MenuSnapshot& operator*() const { return *snap; }
+    const MenuSnapshot* operator->() const { return snap; }
+    DishList::const_iterator begin() const { return snap->dishes.begin(); }
+    DishList::const_iterator end() const { return snap->dishes.end(); }
+};
+
+// Copy-on-write: each edit builds a new snapshot and swaps the pointer, so
+// readers never see a half-applied change and never block on an owner.
+// Every change, including a re-rating, also bumps the version and goes in
+// the change log that menu deltas are cut from.
+class Menu 
+{
+private:
+    static const size_t MAX_LOG = 512;
+
+    struct LoggedChange {
+        uint64_t version;
+        uint32_t handle;
+        uint8_t kinds; // MenuChangeKind bits
+    };
+
+    atomic<const MenuSnapshot*> current;
+    mutex writeLock; // serializes editors only
+    CatalogListener* listener = nullptr;
+    const Restaurant* owner = nullptr;
+
+    mutable mutex logLock;
+    atomic<uint64_t> version{0};
+    using ChangeLog = vector<LoggedChange, TaggedAllocator<LoggedChange, MEM_CATALOG>>;
+    ChangeLog changeLog;             // ascending versions
+    uint64_t compactedThrough = 0;   // deltas from before this need a full resync
+
+    // Swaps in `next`; the old version is freed once no reader has it pinned
+    void publish(MenuSnapshot* next) {
+        next->reindex();
+        const MenuSnapshot* old = current.load(memory_order_relaxed);
+        current.store(next, memory_order_seq_cst);
+        EpochDomain::instance().retire([old]() { delete old; });
+    }
+
+    // Logged after the snapshot is published, so a delta cut in between
+    // simply reports the older version and picks this up next time
+    void record(uint32_t handle, uint8_t kind) {
+        lock_guard<mutex> guard(logLock);
+        uint64_t v = version.load(memory_order_relaxed) + 1;
+        changeLog.push_back({v, handle, kind});
+        version.store(v, memory_order_release);
+        if (changeLog.size() > MAX_LOG) compactLog();
+    }
+
+    // Folds the log to one entry per dish; if that is still too long, the
+    // oldest entries go and clients behind them get a full resync instead.
+    // A removal wipes what came before it, so a folded entry is only ever a
+    // bare ADDED when it marks the dish's real arrival.
+    void compactLog() {
+        unordered_map<uint32_t, size_t> latest;
+        ChangeLog folded;
+        for (const LoggedChange& c : changeLog) {
+            auto it = latest.find(c.handle);
+            if (it == latest.end()) {
+                latest[c.handle] = folded.size();
+                folded.push_back(c);
+            } else {
+                LoggedChange& f = folded[it->second];
+                f.version = c.version;
+                f.kinds = (c.kinds & CHANGE_REMOVED) ? c.kinds : f.kinds | c.kinds;
+            }
+        }
+        sort(folded.begin(), folded.end(), [](const LoggedChange& a, const LoggedChange& b) { return a.version < b.version; });
+        if (folded.size() > MAX_LOG / 2) {
+            size_t drop = folded.size() - MAX_LOG / 2;
+            compactedThrough = folded[drop - 1].version;
+            folded.erase(folded.begin(), folded.begin() + drop);
         }
+        changeLog.swap(folded);
     }
 
-    // Assign partner if found
-    if (partner) 
-    {
-        order->assignPartner(partner->getId());
-        partner->startDelivery();
+public:
+    Menu() : current(new MenuSnapshot()) {}
+    ~Menu() { delete current.load(memory_order_relaxed); }
+    Menu(const Menu&) = delete;
+    Menu& operator=(const Menu&) = delete;
+
+    void attach(CatalogListener* l, const Restaurant* r) {
+        listener = l;
+        owner = r;
+    }
 
-        notifier.sendNotification(
-            order->getCustomerId(),
-            "Partner " + partner->getName() + " assigned!"
-        );
+    void addDish(const Dish& dish)
+    {
+         lock_guard<mutex> guard(writeLock);
+         MenuSnapshot* next = new MenuSnapshot(*current.load(memory_order_relaxed));
+         next->dishes.push_back(dish);
+         publish(next);
+         record(dish.getRatingHandle(), CHANGE_ADDED);
+         if (listener) listener->onDishAdded(*owner, dish);
     }
-}
 
-    void updateOrderStatus(const string& orderId, const string& newStatus) 
+    void removeDish(const string &dishName)
     {
-        Order* targetOrder = nullptr;
+        lock_guard<mutex> guard(writeLock);
+        const MenuSnapshot* old = current.load(memory_order_relaxed);
+        MenuSnapshot* next = new MenuSnapshot();
+        vector<Dish> removed;
+        for (const Dish& d : old->dishes) {
+            if (d.getName() == dishName) removed.push_back(d);
+            else next->dishes.push_back(d);
+        }
+        if (removed.empty()) {
+            delete next;
+            return;
+        }
+        publish(next);
+        for (const Dish& d : removed) record(d.getRatingHandle(), CHANGE_REMOVED);
+        if (listener) {
+            for (const Dish& d : removed) listener->onDishRemoved(*owner, d);
+        }
+    }
 
-        for (Order* o : activeOrders) {
-            if (o->getId() == orderId) {
-                targetOrder = o;
-                break;
-            }
+    bool repriceDish(const string& dishId, Money newPrice)
+    {
+        lock_guard<mutex> guard(writeLock);
+        MenuSnapshot* next = new MenuSnapshot(*current.load(memory_order_relaxed));
+        for (Dish& d : next->dishes) {
+            if (d.getId() != dishId) continue;
+            d.setPrice(newPrice);
+            uint32_t handle = d.getRatingHandle();
+            publish(next);
+            record(handle, CHANGE_REPRICED);
+            return true;
         }
+        delete next;
+        return false;
+    }
 
-        if (targetOrder) 
+    // Ratings live on the RatingBoard, so only the log changes
+    void noteRerated(uint32_t dishHandle) { record(dishHandle, CHANGE_RERATED); }
+
+    MenuPin getAllDishes() const { return MenuPin(current); }
+    uint64_t getVersion() const { return version.load(memory_order_acquire); }
+
+    // Binary delta taking a client from `since` to the current version. Cost
+    // follows the number of dishes changed since then, not the menu size.
+    vector<uint8_t> deltaSince(uint64_t since) const
+    {
+        vector<uint8_t> out = {'M', 'D', 1};
+        map<uint32_t, uint8_t> changed;
+        unordered_set<uint32_t> arrived; // first change since `since` was the dish being added
+        uint64_t to;
+        bool full;
         {
-            targetOrder->setStatus(newStatus);
-            notifier.sendNotification(targetOrder->getCustomerId(), 
-                "Order " + orderId + " status updated to: " + newStatus);
+            lock_guard<mutex> guard(logLock);
+            to = version.load(memory_order_relaxed);
+            full = since < compactedThrough || since > to;
+            if (!full) {
+                auto first = upper_bound(changeLog.begin(), changeLog.end(), since,
+                                         [](uint64_t v, const LoggedChange& c) { return v < c.version; });
+                for (auto it = first; it != changeLog.end(); ++it) {
+                    if (!changed.count(it->handle) && it->kinds == CHANGE_ADDED) arrived.insert(it->handle);
+                    changed[it->handle] |= it->kinds;
+                }
+            }
+        }
 
-            if (newStatus == STATUS_DELIVERED) 
-            {
-                Customer* cust = dynamic_cast<Customer*>(findUser(targetOrder->getCustomerId()));
-                if (cust) {
-                    cust->addOrderToHistory(targetOrder);
-                    cust->addLoyaltyPoints(targetOrder->getFinalAmount() * 0.05);
+        MenuPin pin = getAllDishes();
+        vector<uint8_t> records;
+        size_t count = 0;
+        if (full) {
+            for (const Dish& d : pin) MenuDelta::putDish(records, d);
+            count = pin->dishes.size();
+        } else {
+            for (const auto& entry : changed) {
+                uint32_t handle = entry.first;
+                uint8_t kinds = entry.second;
+                auto it = pin->byHandle.find(handle);
+                if (it == pin->byHandle.end()) {
+                    if (arrived.count(handle)) continue; // came and went; the client never saw it
+                    records.push_back(CHANGE_REMOVED);
+                    MenuDelta::putVarint(records, handle);
+                } else {
+                    const Dish& d = pin->dishes[it->second];
+                    if (kinds == CHANGE_REPRICED) {
+                        records.push_back(CHANGE_REPRICED);
+                        MenuDelta::putVarint(records, handle);
+                        MenuDelta::putVarint(records, d.getPrice().getCents());
+                    } else if (kinds == CHANGE_RERATED) {
+                        records.push_back(CHANGE_RERATED);
+                        MenuDelta::putVarint(records, handle);
+                        MenuDelta::putVarint(records, MenuDelta::milliStars(handle));
+                        MenuDelta::putVarint(records, RatingBoard::instance().getCount(handle));
+                    } else {
+                        MenuDelta::putDish(records, d); // several kinds of change: send the whole dish
+                    }
                 }
+                count++;
             }
         }
+
+        MenuDelta::putVarint(out, full ? 0 : since);
+        MenuDelta::putVarint(out, to);
+        MenuDelta::putVarint(out, full ? 1 : 0);
+        MenuDelta::putVarint(out, count);
+        out.insert(out.end(), records.begin(), records.end());
+        return out;
     }
 
+    // Updated to take and check strings
+    vector<Dish> filterDishes(const string& c, const string& cs, const string& t) const 
+    {
+        ScopedTimer timer(HIST_FILTER_DISHES);
+        vector<Dish> result;
+        for (const auto& dish : getAllDishes())
+        {
+            bool cuisineMatch = (c == CUISINE_ANY) || (dish.getCuisine() == c);
+            bool courseMatch = (cs == COURSE_ANY) || (dish.getCourse() == cs);
+            bool typeMatch = (t == DISH_BOTH) || (dish.getType() == t);
+
+            if (cuisineMatch && courseMatch && typeMatch && !dish.isSoldOut()) {
+                result.push_back(dish);
+            }
+        }
+        return result;
+    }
     
-    void finalizeOrder(const string& orderId) 
+    // Copies the dish out, so the caller's copy outlives any later edit
+    bool getDishByName(const string& name, Dish& out) const 
     {
-        for (auto it = activeOrders.begin(); it != activeOrders.end(); ++it) {
-            if ((*it)->getId() == orderId) {
-                Order* orderToMove = *it;           // Get the pointer
-                activeOrders.erase(it);             // Remove from active list
-                completedOrders.push_back(orderToMove); // Add to completed list
-                break;                              // Exit loop once done
+        for (const auto& dish : getAllDishes()) 
+        {
+            if (dish.getName() == name) {
+                out = dish;
+                return true;
             }
         }
+    return false; // if dish not found
+    }
+};
+
+// --- RESTAURANT ---
+// -------------------------------------------------------------
+// Outcome of asking a kitchen to take an order
+enum Admission { ADMIT_OK, ADMIT_THROTTLED, ADMIT_DEFERRED };
+
+// Prep backlog for one kitchen, in cook-minutes of admitted work that has not
+// yet gone out for delivery. `slots` orders cook in parallel, so the wait for
+// a new order is backlog / slots. Past the throttle wait the customer must
+// accept the longer quote; past the defer wait new orders are turned away
+// until the backlog drains. Checks are a couple of atomic loads and a CAS.
+class Kitchen {
+private:
+    atomic<int> slots;
+    atomic<int> throttleWaitMinutes;
+    atomic<int> deferWaitMinutes;
+    atomic<int> backlogMinutes{0};
+    atomic<int> openOrders{0};
+
+public:
+    Kitchen(int parallel = 3, int throttleWait = 30, int deferWait = 60)
+        : slots(parallel), throttleWaitMinutes(throttleWait), deferWaitMinutes(deferWait) {}
+
+    void configure(int parallel, int throttleWait, int deferWait) {
+        slots.store(max(1, parallel), memory_order_relaxed);
+        throttleWaitMinutes.store(throttleWait, memory_order_relaxed);
+        deferWaitMinutes.store(max(throttleWait, deferWait), memory_order_relaxed);
+    }
+
+    // Cook-minutes an order adds to the backlog
+    static int workFor(const CartItems& items) {
+        int work = 0;
+        for (const auto& pair : items) work += pair.first.getPrepMinutes() * pair.second;
+        return work;
+    }
+
+    // Dishes of one order cook side by side, so it takes as long as its slowest dish
+    static int longestDish(const CartItems& items) {
+        int longest = 0;
+        for (const auto& pair : items) longest = max(longest, pair.first.getPrepMinutes());
+        return longest;
+    }
+
+    int waitMinutes() const {
+        int n = slots.load(memory_order_relaxed);
+        return (backlogMinutes.load(memory_order_relaxed) + n - 1) / n;
+    }
+
+    int quoteMinutes(const CartItems& items) const { return waitMinutes() + longestDish(items); }
+
+    // Reserves `work` unless the current wait is past a threshold. Throttled
+    // orders are only taken when the customer already agreed to the wait.
+    Admission admit(int work, bool acceptLongWait) {
+        int n = slots.load(memory_order_relaxed);
+        int current = backlogMinutes.load(memory_order_relaxed);
+        while (true) {
+            int wait = (current + n - 1) / n;
+            if (wait >= deferWaitMinutes.load(memory_order_relaxed)) return ADMIT_DEFERRED;
+            if (wait >= throttleWaitMinutes.load(memory_order_relaxed) && !acceptLongWait) return ADMIT_THROTTLED;
+            if (backlogMinutes.compare_exchange_weak(current, current + work, memory_order_relaxed)) break;
+        }
+        openOrders.fetch_add(1, memory_order_relaxed);
+        return ADMIT_OK;
+    }
+
+    void release(int work) {
+        backlogMinutes.fetch_sub(work, memory_order_relaxed);
+        openOrders.fetch_sub(1, memory_order_relaxed);
     }
 
+    int getSlots() const { return slots.load(memory_order_relaxed); }
+    int getThrottleWait() const { return throttleWaitMinutes.load(memory_order_relaxed); }
+    int getDeferWait() const { return deferWaitMinutes.load(memory_order_relaxed); }
+    int getOpenOrders() const { return openOrders.load(memory_order_relaxed); }
 };
 
-void Rating::apply(Order* order, SystemManager& manager, int foodStars, int deliveryStars, const string& feedback) {
-    Restaurant* restaurant = manager.findRestaurant(order->getRestaurantId());
-    if (restaurant) 
-    {
-        restaurant->updateRating(foodStars);
-        
-        for (const auto& pair : order->getDishes()) 
-        {
-            Dish* dish = restaurant->getMenu().getDishByName(pair.first.getName());
-            if (dish) {
-                dish->updateRating(foodStars);
+// One outlet of a restaurant. Branches share the restaurant's menu but each
+// has its own kitchen and can mark dishes unavailable or close for the day.
+class Branch : public Tracked<MEM_CATALOG> {
+private:
+    string name;
+    GeoPoint location;
+    int index; // position in the restaurant, also its StockBoard column
+    bool open;
+    Kitchen kitchen;
+    unordered_set<uint32_t> unavailable; // dish rating handles
+public:
+    Branch(const string& n, const GeoPoint& loc, int i) : name(n), location(loc), index(i), open(true) {}
+
+    const string& getName() const { return name; }
+    const GeoPoint& getLocation() const { return location; }
+    int getIndex() const { return index; }
+    bool isOpen() const { return open; }
+    void setOpen(bool o) { open = o; }
+    Kitchen& getKitchen() { return kitchen; }
+
+    bool isDishAvailable(uint32_t dishHandle) const { return !unavailable.count(dishHandle); }
+    void setDishAvailable(uint32_t dishHandle, bool available) {
+        if (available) unavailable.erase(dishHandle);
+        else unavailable.insert(dishHandle);
+    }
+
+    // A pre-order takes its stock on release, so only availability counts now
+    bool canServe(const CartItems& items, bool checkStock = true) const {
+        for (const auto& pair : items) {
+            if (unavailable.count(pair.first.getRatingHandle())) return false;
+            if (!checkStock) continue;
+            int32_t left = StockBoard::instance().available(pair.first.getStockHandle(), index);
+            if (left != StockBoard::UNLIMITED && left < pair.second) return false;
+        }
+        return true;
+    }
+};
+
+class Restaurant : public Tracked<MEM_CATALOG> {
+private:
+    string restaurantId;
+    string name;
+    string cuisine;
+    uint32_t ratingHandle;
+    vector<unique_ptr<Branch>> branches; // never empty; index 0 is the original outlet
+    string contactEmail;
+    Menu menu;
+public:
+    Restaurant(const string& n, const string& c, const string& email) {
+    restaurantId = IDGenerator::generateRestaurantID();
+    name = n;
+    cuisine = c;
+    ratingHandle = RatingBoard::instance().allocate(4.5, 1);
+    contactEmail = email;
+    addBranch("Main Street Branch", GeoPoint::locate("Main Street"));
+}
+
+    //getters to get properties defined in private
+    const string& getId() const { return restaurantId; }
+    const string& getName() const { return name; }
+    const string& getCuisine() const { return cuisine; } // Return string
+    double getRating() const { return RatingBoard::instance().getStars(ratingHandle); }
+    uint32_t getRatingHandle() const { return ratingHandle; }
+    Menu& getMenu() { return menu; }
+
+    Branch& addBranch(const string& branchName, const GeoPoint& location) {
+        branches.emplace_back(new Branch(branchName, location, static_cast<int>(branches.size())));
+        // The new branch has no stock limits, so nothing is sold out any more
+        for (const Dish& d : menu.getAllDishes()) refreshStock(d);
+        return *branches.back();
+    }
+
+    void refreshStock(const Dish& d) {
+        StockBoard::instance().refreshSoldOut(d.getStockHandle(), static_cast<int>(branches.size()));
+    }
+    size_t branchCount() const { return branches.size(); }
+    Branch& getBranch(size_t i) { return *branches[i]; }
+
+    void displayInfo() const {
+        cout << fixed << setprecision(1)
+                 << "[" << restaurantId << "] " << name << " (" << cuisine << ")" 
+                 << " | Rating: " << getRating() << "⭐"
+                 << " | Branches: " << branches.size()
+                 << endl;
+    }
+};
+
+// --- CREDENTIALS ---
+// -------------------------------------------------------------
+// Plain SHA-256 (FIPS 180-4), enough to store salted password digests
+// without pulling in a crypto library.
+class Sha256 {
+private:
+    uint32_t state[8];
+    uint8_t block[64];
+    size_t used = 0;
+    uint64_t totalBytes = 0;
+
+    static uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+    void compress() {
+        static const uint32_t K[64] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+        uint32_t w[64];
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t(block[i * 4]) << 24) | (uint32_t(block[i * 4 + 1]) << 16) |
+                   (uint32_t(block[i * 4 + 2]) << 8) | uint32_t(block[i * 4 + 3]);
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; i++) {
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+public:
+    static const size_t DIGEST_BYTES = 32;
+
+    Sha256() {
+        static const uint32_t INIT[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+        copy(INIT, INIT + 8, state);
+    }
+
+    Sha256& update(const void* data, size_t len) {
+        const uint8_t* p = static_cast<const uint8_t*>(data);
+        totalBytes += len;
+        while (len > 0) {
+            size_t take = min(len, sizeof(block) - used);
+            memcpy(block + used, p, take);
+            used += take;
+            p += take;
+            len -= take;
+            if (used == sizeof(block)) {
+                compress();
+                used = 0;
             }
         }
+        return *this;
     }
 
-    if (!order->getPartnerId().empty()) 
-    {
-        DeliveryPartner* partner = dynamic_cast<DeliveryPartner*>(manager.findUser(order->getPartnerId()));
-        if (partner) {
-            partner->completeDelivery(order->getTip(), deliveryStars);
+    void finish(uint8_t out[DIGEST_BYTES]) {
+        uint64_t bits = totalBytes * 8;
+        uint8_t pad = 0x80;
+        update(&pad, 1);
+        pad = 0;
+        while (used != 56) update(&pad, 1);
+        uint8_t length[8];
+        for (int i = 0; i < 8; i++) length[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+        update(length, 8);
+        for (int i = 0; i < 8; i++) {
+            out[i * 4] = static_cast<uint8_t>(state[i] >> 24);
+            out[i * 4 + 1] = static_cast<uint8_t>(state[i] >> 16);
+            out[i * 4 + 2] = static_cast<uint8_t>(state[i] >> 8);
+            out[i * 4 + 3] = static_cast<uint8_t>(state[i]);
         }
     }
+};
 
-    cout << "\n Thank you for your feedback! Food Rated: " << foodStars 
-             << ", Delivery Rated: " << deliveryStars << "." << endl;
-    if (!feedback.empty()) {
-        cout << "Your textual feedback: \"" << feedback << "\" has been recorded." << endl;
+// Fills buf from the kernel's CSPRNG
+inline void fillFromKernel(void* buf, size_t n) {
+    uint8_t* p = static_cast<uint8_t*>(buf);
+    size_t got = 0;
+#ifdef __linux__
+    while (got < n) {
+        ssize_t r = getrandom(p + got, n - got, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r < 0) break;
+        got += static_cast<size_t>(r);
     }
-    
-    manager.finalizeOrder(order->getId());
+#endif
+    if (got < n) {
+        ifstream urandom("/dev/urandom", ios::binary);
+        if (urandom.read(reinterpret_cast<char*>(p + got), n - got)) got = n;
+    }
+    random_device device; // last resort
+    for (; got < n; got++) p[got] = static_cast<uint8_t>(device());
 }
 
+// ChaCha20 (RFC 8439) keystream used as a DRBG. Keyed from the kernel, and
+// every block's first half becomes the next key, so a leaked state can't
+// reproduce earlier output. Rekeyed from the kernel every RESEED_BLOCKS.
+class ChaChaRng {
+private:
+    static constexpr uint32_t RESEED_BLOCKS = 1024;
+
+    uint32_t key[8];
+    uint64_t counter = 0;
+    uint64_t out[4];
+    size_t left = 0;
+    uint32_t sinceReseed = RESEED_BLOCKS;
 
-// --- MAIN APPLICATION FLOW ---
-// -------------------------------------------------------------
-void runCustomerFlow(Customer* customer, SystemManager& manager);
-void runOwnerFlow(RestaurantOwner* owner, SystemManager& manager);
-void runPartnerFlow(DeliveryPartner* partner, SystemManager& manager);
-User* handleLoginOrRegister(SystemManager& manager, char userType);
+    static uint32_t rotl(uint32_t x, int n) { return (x << n) | (x >> (32 - n)); }
 
-void runCustomerFlow(Customer* customer, SystemManager& manager) 
-{
-    if (!customer) return;
+    static void quarter(uint32_t* x, int a, int b, int c, int d) {
+        x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 16);
+        x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 12);
+        x[a] += x[b]; x[d] = rotl(x[d] ^ x[a], 8);
+        x[c] += x[d]; x[b] = rotl(x[b] ^ x[c], 7);
+    }
+
+    void refill() {
+        if (sinceReseed++ >= RESEED_BLOCKS) {
+            fillFromKernel(key, sizeof(key));
+            sinceReseed = 1;
+        }
+        uint32_t in[16] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+        memcpy(in + 4, key, sizeof(key));
+        in[12] = static_cast<uint32_t>(counter);
+        in[13] = static_cast<uint32_t>(counter >> 32);
+        counter++;
+        uint32_t x[16];
+        memcpy(x, in, sizeof(x));
+        for (int i = 0; i < 10; i++) {
+            quarter(x, 0, 4, 8, 12); quarter(x, 1, 5, 9, 13);
+            quarter(x, 2, 6, 10, 14); quarter(x, 3, 7, 11, 15);
+            quarter(x, 0, 5, 10, 15); quarter(x, 1, 6, 11, 12);
+            quarter(x, 2, 7, 8, 13); quarter(x, 3, 4, 9, 14);
+        }
+        for (int i = 0; i < 16; i++) x[i] += in[i];
+        memcpy(key, x, sizeof(key));
+        memcpy(out, x + 8, sizeof(out));
+        memset(x, 0, sizeof(x));
+        left = 4;
+    }
+
+public:
+    uint64_t next() {
+        if (left == 0) refill();
+        uint64_t bits = out[--left];
+        out[left] = 0; // not kept once handed out
+        return bits;
+    }
+};
+
+// Random bits for salts and session tokens. Tokens are shown to users, so
+// these must be unpredictable from any number of earlier ones. Only a --seed
+// run draws them from the run's own generator, so that it replays.
+inline uint64_t secureRandom64() {
+    if (RunContext::instance().isDeterministic()) return RunContext::instance().random();
+    thread_local ChaChaRng rng;
+    return rng.next();
+}
+
+// HMAC-SHA256 (RFC 2104). The padded key is absorbed once, so every MAC
+// after that costs two compressions for a short message.
+class HmacSha256 {
+private:
+    Sha256 inner, outer;
+
+public:
+    HmacSha256(const void* key, size_t len) {
+        uint8_t padded[64] = {0};
+        if (len > sizeof(padded)) Sha256().update(key, len).finish(padded);
+        else memcpy(padded, key, len);
+        uint8_t pad[64];
+        for (size_t i = 0; i < sizeof(pad); i++) pad[i] = padded[i] ^ 0x36;
+        inner.update(pad, sizeof(pad));
+        for (size_t i = 0; i < sizeof(pad); i++) pad[i] = padded[i] ^ 0x5c;
+        outer.update(pad, sizeof(pad));
+    }
+
+    void mac(const void* data, size_t len, uint8_t out[Sha256::DIGEST_BYTES]) const {
+        uint8_t innerDigest[Sha256::DIGEST_BYTES];
+        Sha256(inner).update(data, len).finish(innerDigest);
+        Sha256(outer).update(innerDigest, sizeof(innerDigest)).finish(out);
+    }
+};
+
+// A password is kept as PBKDF2-HMAC-SHA256 (RFC 8018) over a per-user salt,
+// so a leaked table costs an attacker `iterations` MACs per guess. Each
+// credential keeps the count it was made with; raising the work factor only
+// applies to passwords set from then on. Logins after the first go through
+// the token table, so only sign-in pays for this.
+class Credential {
+private:
+    uint8_t salt[16];
+    uint32_t iterations;
+    uint8_t digest[Sha256::DIGEST_BYTES];
+
+    static atomic<uint32_t> workFactor;
+
+    void hash(const string& password, uint8_t out[Sha256::DIGEST_BYTES]) const {
+        HmacSha256 prf(password.data(), password.size());
+        uint8_t block[sizeof(salt) + 4];
+        memcpy(block, salt, sizeof(salt));
+        block[sizeof(salt)] = 0; block[sizeof(salt) + 1] = 0; block[sizeof(salt) + 2] = 0; block[sizeof(salt) + 3] = 1;
+        uint8_t u[Sha256::DIGEST_BYTES];
+        prf.mac(block, sizeof(block), u);
+        memcpy(out, u, sizeof(u));
+        for (uint32_t i = 1; i < iterations; i++) {
+            prf.mac(u, sizeof(u), u);
+            for (size_t b = 0; b < sizeof(u); b++) out[b] ^= u[b];
+        }
+    }
+
+public:
+    static const uint32_t DEFAULT_ITERATIONS = 20000; // ~30 ms here; a sign-in holds up the engine that long
+
+    static void setWorkFactor(uint32_t n) { workFactor.store(max(1u, n), memory_order_relaxed); }
+    static uint32_t getWorkFactor() { return workFactor.load(memory_order_relaxed); }
+
+    explicit Credential(const string& password) : iterations(getWorkFactor()) {
+        for (size_t i = 0; i < sizeof(salt); i += 8) {
+            uint64_t bits = secureRandom64();
+            memcpy(salt + i, &bits, 8);
+        }
+        hash(password, digest);
+    }
+
+    // Compares every byte so timing does not reveal how much of the digest matched
+    bool matches(const string& password) const {
+        uint8_t candidate[Sha256::DIGEST_BYTES];
+        hash(password, candidate);
+        uint8_t diff = 0;
+        for (size_t i = 0; i < sizeof(digest); i++) diff |= candidate[i] ^ digest[i];
+        return diff == 0;
+    }
+};
+
+atomic<uint32_t> Credential::workFactor(Credential::DEFAULT_ITERATIONS);
+
+class User;
+
+// A token names its slot in the table directly, so checking one is an index
+// and a 128-bit compare. The text form is 8 hex digits of slot + 32 of secret.
+struct AuthToken {
+    uint32_t slot = 0;
+    uint64_t secret[2] = {0, 0};
+
+    string toString() const {
+        char text[41];
+        snprintf(text, sizeof(text), "%08x%016llx%016llx", slot,
+                 static_cast<unsigned long long>(secret[0]), static_cast<unsigned long long>(secret[1]));
+        return text;
+    }
+
+    static bool parse(const string& text, AuthToken& out) {
+        if (text.size() != 40 || text.find_first_not_of("0123456789abcdef") != string::npos) return false;
+        out.slot = static_cast<uint32_t>(stoul(text.substr(0, 8), nullptr, 16));
+        out.secret[0] = stoull(text.substr(8, 16), nullptr, 16);
+        out.secret[1] = stoull(text.substr(24, 16), nullptr, 16);
+        return true;
+    }
+};
+
+// Live login sessions. Expiry slides: every successful check pushes it out by
+// the full TTL. Each issue also inspects one old slot, so abandoned tokens
+// are reclaimed without a separate sweep.
+class TokenTable {
+private:
+    struct Entry {
+        User* user = nullptr;
+        uint64_t secret[2] = {0, 0};
+        long long expiresAt = 0;
+    };
+
+    mutable mutex lock;
+    vector<Entry> entries{1}; // slot 0 is never issued, so an empty token is always invalid
+    vector<uint32_t> freeSlots;
+    size_t sweepCursor = 1;
+    size_t live = 0;
+    long long ttlMicros;
+
+    void freeSlot(uint32_t slot) {
+        entries[slot] = Entry();
+        freeSlots.push_back(slot);
+        live--;
+    }
+
+public:
+    explicit TokenTable(long long ttlMinutes = 30) : ttlMicros(ttlMinutes * 60 * 1000000) {}
+
+    AuthToken issue(User* user) {
+        AuthToken token;
+        token.secret[0] = secureRandom64();
+        token.secret[1] = secureRandom64();
+        long long now = Clock::nowMicros();
+
+        lock_guard<mutex> guard(lock);
+        if (entries.size() > 1) {
+            size_t s = sweepCursor++ % (entries.size() - 1) + 1;
+            if (entries[s].user && entries[s].expiresAt <= now) freeSlot(static_cast<uint32_t>(s));
+        }
+        if (freeSlots.empty()) {
+            token.slot = static_cast<uint32_t>(entries.size());
+            entries.emplace_back();
+        } else {
+            token.slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        Entry& e = entries[token.slot];
+        e.user = user;
+        e.secret[0] = token.secret[0];
+        e.secret[1] = token.secret[1];
+        e.expiresAt = now + ttlMicros;
+        live++;
+        return token;
+    }
+
+    // The signed-in user, or nullptr if the token is unknown, revoked or expired
+    User* validate(const AuthToken& token) {
+        long long now = Clock::nowMicros();
+        lock_guard<mutex> guard(lock);
+        if (token.slot == 0 || token.slot >= entries.size()) return nullptr;
+        Entry& e = entries[token.slot];
+        if (!e.user || ((e.secret[0] ^ token.secret[0]) | (e.secret[1] ^ token.secret[1])) != 0) return nullptr;
+        if (e.expiresAt <= now) {
+            freeSlot(token.slot);
+            return nullptr;
+        }
+        e.expiresAt = now + ttlMicros;
+        return e.user;
+    }
+
+    void revoke(const AuthToken& token) {
+        lock_guard<mutex> guard(lock);
+        if (token.slot == 0 || token.slot >= entries.size()) return;
+        Entry& e = entries[token.slot];
+        if (e.user && e.secret[0] == token.secret[0] && e.secret[1] == token.secret[1]) freeSlot(token.slot);
+    }
+
+    size_t liveCount() const {
+        lock_guard<mutex> guard(lock);
+        return live;
+    }
+    long long getTtlMinutes() const { return ttlMicros / 60000000; }
+};
+
+enum AuthResult { AUTH_OK, AUTH_BAD_CREDENTIALS, AUTH_WRONG_ROLE };
+
+// --- USER HIERARCHY (ABSTRACTION, INHERITANCE, POLYMORPHISM) ---
+// -------------------------------------------------------------
+// Role is stored on the user so the login path can check it without RTTI
+enum UserRole : uint8_t { ROLE_CUSTOMER, ROLE_OWNER, ROLE_PARTNER };
+
+class User : public Tracked<MEM_USERS> {
+protected:
+    string userId;
+    string name;
+    Credential credential;
+    UserRole role;
+    bool loggedIn;
+public:
+  User(const string& n, const string& p, UserRole r) : credential(p) {
+    this->userId = IDGenerator::generateUserID();
+    this->name = n;
+    this->role = r;
+    this->loggedIn = false;
+}
+    virtual ~User() = default; // calling the default destructor,if no derived class overrides the destructor
+
+    virtual void greet() const = 0;
+    virtual void viewProfile() const = 0;
+    virtual bool registerUser() = 0;
+
+    bool checkPassword(const string& pass) const { return credential.matches(pass); }
+
+    void login() {
+        loggedIn = true;
+        greet();
+    }
+
+    void logout()
+    {
+        if (loggedIn){
+            cout << "\n" << name << " (" << userId << ") logged out successfully." << endl;
+            loggedIn = false;
+        }
+    }
+
+    //getter functions 
+    const string& getId() const { return userId; }
+    const string& getName() const { return name; }
+    UserRole getRole() const { return role; }
+    bool isLoggedIn() const { return loggedIn; }
+};
+
+class Customer : public User {
+private:
+    string deliveryAddress;
+    vector<string, TaggedAllocator<string, MEM_USERS>> orderHistory; // order IDs; finished orders live in the OrderArchive
+    Money loyaltyPoints;
+public:
+  Customer(const string& n, const string& p, const string& addr) : User(n, p, ROLE_CUSTOMER){
+    this->deliveryAddress = addr;
+    this->loyaltyPoints = Money();
+}
+
+    bool registerUser() override {
+        cout << "\n Customer " << name << " registered successfully with ID: " << userId << endl;
+        return true;
+    }
+
+    void greet() const override {
+        cout << "\n Welcome back, Customer " << name << "!" << endl;
+    }
+
+    void viewProfile() const override {
+        cout << "\n--- Customer Profile ---" << endl;
+        cout << "ID: " << userId << endl;
+        cout << "Name: " << name << endl;
+        cout << "Address: " << deliveryAddress << endl;
+        cout << "Loyalty Points: " << loyaltyPoints << endl;
+        cout << "Past Orders: " << orderHistory.size() << endl;
+    }
+
+    void addOrderToHistory(const string& orderId) {
+         orderHistory.push_back(orderId);
+    }
+    
+    const string& getAddress() const { return deliveryAddress; }
+    Money getLoyaltyPoints() const { return loyaltyPoints; }
+    void addLoyaltyPoints(Money points) { loyaltyPoints += points; }
+};
+
+class RestaurantOwner : public User {
+private:
+    vector<Restaurant*> ownedRestaurants;
+public:
+    RestaurantOwner(const string& n, const string& p)
+        : User(n, p, ROLE_OWNER) {}
+
+    bool registerUser() override {
+        cout << "\n Restaurant Owner " << name << " registered successfully with ID: " << userId << endl;
+        return true;
+    }
+
+    void greet() const override {
+        cout << "\n Welcome to your dashboard, Owner " << name << "!" << endl;
+    }
+
+    void viewProfile() const override {
+        cout << "\n--- Restaurant Owner Profile ---" << endl;
+        cout << "ID: " << userId << endl;
+        cout << "Name: " << name << endl;
+        cout << "Owned Restaurants: " << ownedRestaurants.size() << endl;
+        for (const auto& r : ownedRestaurants) {
+            cout << "  - " << r->getName() << " (" << r->getId() << ")" << endl;
+        }
+    }
+
+    void addRestaurant(Restaurant* r) 
+    {
+         ownedRestaurants.push_back(r);
+         cout << "Restaurant '" << r->getName() << "' added to your portfolio." << endl;
+    }
+
+    const vector<Restaurant*>& getOwnedRestaurants() const { return ownedRestaurants; }
+};
+
+class DeliveryPartner : public User {
+private:
+    string vehicleType;
+    Money totalEarnings;
+    uint32_t ratingHandle;
+    bool isAvailable;
+    int zone; // delivery zone the partner is waiting in
+public:
+    DeliveryPartner(const string& n, const string& p, const string& vehicle): User(n, p, ROLE_PARTNER) {
+    this->vehicleType = vehicle;
+    this->totalEarnings = Money();
+    this->ratingHandle = RatingBoard::instance().allocate(5.0, 1);
+    this->isAvailable = true;
+    this->zone = 0;
+}
+
+    bool registerUser() override {
+        cout << "\n Delivery Partner " << name << " registered successfully with ID: " << userId << endl;
+        return true;
+    }
+
+    void greet() const override {
+        cout << "\n Ready to deliver, Partner " << name << "!" << endl;
+    }
+
+    void viewProfile() const override {
+        cout << "\n--- Delivery Partner Profile ---" << endl;
+        cout << "ID: " << userId << endl;
+        cout << "Name: " << name << endl;
+        cout << "Vehicle: " << vehicleType << endl;
+        cout << "Earnings: $" << totalEarnings << endl;
+        cout << "Rating: " << fixed << setprecision(1) << getRating() << "⭐" << endl;
+        cout << "Status: " << (isAvailable ? "Available" : "On Delivery") << endl;
+    }
+
+    void completeDelivery(Money earnings) 
+    {
+         totalEarnings += earnings;
+         isAvailable = true;
+    }
+
+    double getRating() const { return RatingBoard::instance().getStars(ratingHandle); }
+    uint32_t getRatingHandle() const { return ratingHandle; }
+    
+    void startDelivery() { isAvailable = false; }
+    bool isCurrentlyAvailable() const { return isAvailable; }
+    int getZone() const { return zone; }
+    void moveTo(int z) { zone = z; }
+};
+
+// --- OFFERS, CART, ORDER ---
+// -------------------------------------------------------------
+class Offer {
+private:
+    string promoCode;
+    double discountValue;
+    bool isPercentage;
+    int minOrderValue;
+    int perCustomerLimit; // 0 = unlimited
+    int globalLimit;      // 0 = unlimited
+    int trackerSlot;
+public:
+   Offer(const string& code, double value, bool isP, int minVal, int perCustomer = 0, int global = 0) {
+    this->promoCode = code;
+    this->discountValue = value;
+    this->isPercentage = isP;
+    this->minOrderValue = minVal;
+    this->perCustomerLimit = perCustomer;
+    this->globalLimit = global;
+    this->trackerSlot = -1;
+}
+
+
+    const string& getCode() const { return promoCode; }
+    int getPerCustomerLimit() const { return perCustomerLimit; }
+    int getGlobalLimit() const { return globalLimit; }
+    int getTrackerSlot() const { return trackerSlot; }
+    void setTrackerSlot(int slot) { trackerSlot = slot; }
+
+    bool requiresLoyalty() const { return promoCode == "LOYALTY50"; }
+
+    // Silent pricing rule shared by Order and QuoteEngine; zero when the offer doesn't apply
+    Money computeDiscount(Money subtotal, Money loyaltyPoints) const {
+        if (subtotal < Money::fromWhole(minOrderValue)) return Money();
+        if (requiresLoyalty() && loyaltyPoints < Money::fromWhole(10)) return Money();
+        if (isPercentage) return subtotal.percentBps(llround(discountValue * 100.0));
+        return min(Money::fromDollars(discountValue), subtotal); // never below zero
+    }
+
+    Money applyDiscount(Money subtotal, const Customer* cust) const {
+        if (subtotal < Money::fromWhole(minOrderValue))
+        {
+            cout << "    [Offer Failed] Minimum order value of $" << minOrderValue << " not met." << endl;
+            return Money();
+        }
+        if (requiresLoyalty() && cust && cust->getLoyaltyPoints() < Money::fromWhole(10))
+        {
+            cout << "    [Offer Failed] Not enough loyalty points." << endl;
+            return Money();
+        }
+
+        // A null customer skips the loyalty gate, as before
+        Money discount = computeDiscount(subtotal, cust ? cust->getLoyaltyPoints() : Money::fromWhole(10));
+        if (isPercentage)
+        {
+            cout << "    [Offer Applied] " << discountValue << "% off: -$" << discount << endl;
+        }
+        else
+        {
+            cout << "    [Offer Applied] $" << fixed << setprecision(2) << discountValue << " off: -$" << discount << endl;
+        }
+        return discount;
+    }
+};
+
+// Records which customer redeemed which offer. A Bloom filter sits in front of
+// the exact counts so the common "never redeemed" check is a few atomic loads
+// with no locking or allocation. Caps are enforced under the shard lock
+// (per customer) and with a CAS loop on the offer's counter (global).
+enum RedeemResult { REDEEM_OK, REDEEM_CUSTOMER_LIMIT, REDEEM_GLOBAL_LIMIT };
+
+class RedemptionTracker {
+private:
+    static const int BLOOM_HASHES = 4;
+    static const size_t SHARD_COUNT = 64;
+
+    struct Shard {
+        mutex lock;
+        unordered_map<uint64_t, uint32_t, hash<uint64_t>, equal_to<uint64_t>,
+                      TaggedAllocator<pair<const uint64_t, uint32_t>, MEM_OFFERS>> counts; // (customer, offer slot) -> uses
+    };
+    struct OfferSlot {
+        atomic<int> uses;
+        int globalLimit;
+        int perCustomerLimit;
+        OfferSlot(int global, int perCustomer) : uses(0), globalLimit(global), perCustomerLimit(perCustomer) {}
+    };
+
+    size_t bloomBits;
+    vector<atomic<uint64_t>, TaggedAllocator<atomic<uint64_t>, MEM_OFFERS>> bloom;
+    unique_ptr<Shard[]> shards;
+    vector<unique_ptr<OfferSlot>, TaggedAllocator<unique_ptr<OfferSlot>, MEM_OFFERS>> slots;
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30; x *= 0xbf58476d1ce4e5b9ULL;
+        x ^= x >> 27; x *= 0x94d049bb133111ebULL;
+        return x ^ (x >> 31);
+    }
+
+    static uint64_t makeKey(const string& customerId, int slot) {
+        return (static_cast<uint64_t>(IDGenerator::numericPart(customerId)) << 16) | static_cast<uint64_t>(slot);
+    }
+
+    bool bloomMayContain(uint64_t key) const {
+        uint64_t h = mix(key);
+        uint64_t h1 = h, h2 = (h >> 32) | 1;
+        for (int i = 0; i < BLOOM_HASHES; i++) {
+            size_t bit = (h1 + i * h2) % bloomBits;
+            if (!(bloom[bit / 64].load(memory_order_relaxed) & (1ULL << (bit % 64)))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void bloomInsert(uint64_t key) {
+        uint64_t h = mix(key);
+        uint64_t h1 = h, h2 = (h >> 32) | 1;
+        for (int i = 0; i < BLOOM_HASHES; i++) {
+            size_t bit = (h1 + i * h2) % bloomBits;
+            bloom[bit / 64].fetch_or(1ULL << (bit % 64), memory_order_relaxed);
+        }
+    }
+
+    Shard& shardFor(uint64_t key) { return shards[mix(key) % SHARD_COUNT]; }
+
+public:
+    // 2^24 bits (2 MiB) keeps false positives around 1% up to ~1.5M redemptions
+    RedemptionTracker(size_t bits = (1u << 24))
+        : bloomBits(bits), bloom(bits / 64), shards(new Shard[SHARD_COUNT]) {
+        for (size_t i = 0; i < bloomBits / 64; i++) bloom[i].store(0, memory_order_relaxed);
+    }
+
+    // Not thread-safe; offers are registered while seeding, before checkouts start
+    int registerOffer(const Offer& offer) {
+        slots.emplace_back(new OfferSlot(offer.getGlobalLimit(), offer.getPerCustomerLimit()));
+        return static_cast<int>(slots.size()) - 1;
+    }
+
+    int redemptionCount(const string& customerId, int slot) {
+        uint64_t key = makeKey(customerId, slot);
+        if (!bloomMayContain(key)) return 0;
+
+        Shard& shard = shardFor(key);
+        lock_guard<mutex> guard(shard.lock);
+        auto it = shard.counts.find(key);
+        return it == shard.counts.end() ? 0 : static_cast<int>(it->second);
+    }
+
+    int globalUses(int slot) const { return slots[slot]->uses.load(memory_order_relaxed); }
+
+    RedeemResult tryRedeem(const string& customerId, int slot) {
+        OfferSlot& offer = *slots[slot];
+        uint64_t key = makeKey(customerId, slot);
+        Shard& shard = shardFor(key);
+        lock_guard<mutex> guard(shard.lock);
+
+        uint32_t current = 0;
+        if (bloomMayContain(key)) {
+            auto it = shard.counts.find(key);
+            if (it != shard.counts.end()) current = it->second;
+        }
+        if (offer.perCustomerLimit > 0 && current >= static_cast<uint32_t>(offer.perCustomerLimit)) {
+            return REDEEM_CUSTOMER_LIMIT;
+        }
+
+        int used = offer.uses.load(memory_order_relaxed);
+        do {
+            if (offer.globalLimit > 0 && used >= offer.globalLimit) {
+                return REDEEM_GLOBAL_LIMIT;
+            }
+        } while (!offer.uses.compare_exchange_weak(used, used + 1, memory_order_acq_rel));
+
+        shard.counts[key] = current + 1;
+        bloomInsert(key);
+        return REDEEM_OK;
+    }
+
+    // Undo a redemption whose checkout did not go through (e.g. payment failed)
+    void release(const string& customerId, int slot) {
+        uint64_t key = makeKey(customerId, slot);
+        Shard& shard = shardFor(key);
+        lock_guard<mutex> guard(shard.lock);
+
+        auto it = shard.counts.find(key);
+        if (it == shard.counts.end() || it->second == 0) return;
+        if (--it->second == 0) shard.counts.erase(it); // bloom bits stay set; the exact store decides
+        slots[slot]->uses.fetch_sub(1, memory_order_acq_rel);
+    }
+};
+
+class Cart {
+private:
+    CartItems items;
+public:
+    void addItem(const Dish& dish, int quantity = 1) {
+         items[dish] += quantity;
+         cout << quantity << "x " << dish.getName() << " added to cart." << endl;
+    }
+
+    void removeItem(const string& dishName) 
+    {
+         for (auto it = items.begin(); it != items.end(); ++it) 
+         {
+             if (it->first.getName() == dishName) {
+                 items.erase(it);
+                 cout << dishName << " removed from cart." << endl;
+                 return;
+             }
+         }
+    }
+
+    Money calculateSubtotal() const {
+        Money total;
+        for (const auto& pair : items) {
+            total += pair.first.getPrice() * pair.second;
+        }
+        return total;
+    }
+
+    void displayCart() const {
+        cout << "\n--- Your Cart ---" << endl;
+        if (items.empty()) {
+            cout << "Cart is empty." << endl;
+            return;
+        }
+        for (const auto& pair : items) {
+            cout << fixed << setprecision(2)
+                     << pair.second << "x " << pair.first.getName()
+                     << " @ $" << pair.first.getPrice()
+                     << " = $" << (pair.first.getPrice() * pair.second)
+                     << endl;
+        }
+        cout << "Subtotal: $" << calculateSubtotal() << endl;
+        cout << "-----------------" << endl;
+    }
+
+    const CartItems& getItems() const { return items; }
+    bool isEmpty() const { return items.empty(); }
+};
+
+// --- PRICE QUOTES ---
+// -------------------------------------------------------------
+struct Quote {
+    Money subtotal;
+    Money discount;
+    Money fees;
+    Money tip;
+    Money total;
+};
+
+struct FeeSchedule {
+    Money deliveryFee;
+    Money platformFee;
+
+    // Delivery fee scaled by a surge multiplier in thousandths (1000 = 1x)
+    Money deliveryFeeAt(uint32_t surgeMilli) const { return deliveryFee.percentBps(surgeMilli * 10); }
+};
+
+using OfferList = vector<Offer, TaggedAllocator<Offer, MEM_OFFERS>>;
+
+// Many carts packed back to back so a batch is a handful of flat arrays
+// rather than one map per cart. Cart i owns lines[lineOffsets[i], lineOffsets[i + 1]).
+struct QuoteBatch {
+    struct Line { Money price; int quantity; };
+
+    vector<Line> lines;
+    vector<size_t> lineOffsets{0};
+    vector<int> offerIndex;          // index into the engine's offers, -1 for none
+    vector<Money> loyalty;
+    vector<Money> tip;
+    vector<uint32_t> surgeMilli;     // at the cart's delivery address, 1000 = 1x
+
+    void addCart(const CartItems& items, int offer = -1, Money points = Money(), Money tipAmount = Money(), uint32_t surge = 1000) {
+        for (const auto& pair : items) lines.push_back({pair.first.getPrice(), pair.second});
+        lineOffsets.push_back(lines.size());
+        offerIndex.push_back(offer);
+        loyalty.push_back(points);
+        tip.push_back(tipAmount);
+        surgeMilli.push_back(surge);
+    }
+
+    void addCart(const Cart& cart, int offer = -1, Money points = Money(), Money tipAmount = Money(), uint32_t surge = 1000) {
+        addCart(cart.getItems(), offer, points, tipAmount, surge);
+    }
+
+    size_t size() const { return offerIndex.size(); }
+};
+
+class QuoteEngine {
+private:
+    const OfferList& offers;
+    FeeSchedule fees;
+
+    void quoteRange(const QuoteBatch& batch, vector<Quote>& out, size_t begin, size_t end) const {
+        const QuoteBatch::Line* lines = batch.lines.data();
+        for (size_t i = begin; i < end; i++) {
+            Money subtotal;
+            for (size_t l = batch.lineOffsets[i]; l < batch.lineOffsets[i + 1]; l++) {
+                subtotal += lines[l].price * lines[l].quantity; // saturates like Cart::calculateSubtotal
+            }
+            int offer = batch.offerIndex[i];
+            Money discount = (offer >= 0 && offer < static_cast<int>(offers.size()))
+                ? offers[offer].computeDiscount(subtotal, batch.loyalty[i])
+                : Money();
+            out[i] = compose(subtotal, discount, fees.deliveryFeeAt(batch.surgeMilli[i]) + fees.platformFee, batch.tip[i]);
+        }
+    }
+
+public:
+    QuoteEngine(const OfferList& o, FeeSchedule f = FeeSchedule()) : offers(o), fees(f) {}
+
+    // The one place a total is assembled from its parts
+    static Quote compose(Money subtotal, Money discount, Money fees, Money tip) {
+        Quote q;
+        q.subtotal = subtotal;
+        q.discount = min(discount, subtotal);
+        q.fees = fees;
+        q.tip = tip;
+        q.total = subtotal - q.discount + fees + tip;
+        return q;
+    }
+
+    const FeeSchedule& getFees() const { return fees; }
+    void setFees(const FeeSchedule& f) { fees = f; }
+
+    Quote quote(const Cart& cart, const Offer* offer, Money loyalty, Money tip = Money(), uint32_t surgeMilli = 1000) const {
+        Money subtotal = cart.calculateSubtotal();
+        Money discount = offer ? offer->computeDiscount(subtotal, loyalty) : Money();
+        return compose(subtotal, discount, fees.deliveryFeeAt(surgeMilli) + fees.platformFee, tip);
+    }
+
+    // Splits the batch into contiguous chunks, one per thread; small batches stay on the caller's thread
+    vector<Quote> quoteBatch(const QuoteBatch& batch, unsigned threadCount = 0) const {
+        const size_t MIN_CARTS_PER_THREAD = 8192;
+        vector<Quote> out(batch.size());
+
+        if (threadCount == 0) threadCount = max(1u, thread::hardware_concurrency());
+        size_t maxUseful = (batch.size() + MIN_CARTS_PER_THREAD - 1) / MIN_CARTS_PER_THREAD;
+        threadCount = static_cast<unsigned>(max<size_t>(1, min<size_t>(threadCount, maxUseful)));
+
+        if (threadCount == 1) {
+            quoteRange(batch, out, 0, batch.size());
+            return out;
+        }
+
+        vector<thread> workers;
+        size_t chunk = (batch.size() + threadCount - 1) / threadCount;
+        for (unsigned t = 0; t < threadCount; t++) {
+            size_t begin = t * chunk, end = min(batch.size(), begin + chunk);
+            if (begin >= end) break;
+            workers.emplace_back(&QuoteEngine::quoteRange, this, cref(batch), ref(out), begin, end);
+        }
+        for (thread& w : workers) w.join();
+        return out;
+    }
+};
+
+// Stage timestamps for one order, in Clock micros; 0 means the stage never happened
+enum OrderStage { STAGE_CREATED, STAGE_ASSIGNED, STAGE_PREPARING, STAGE_PICKED_UP, STAGE_DELIVERED, STAGE_RATED, STAGE_COUNT };
+const char* const STAGE_NAMES[STAGE_COUNT] = {"created", "assigned", "preparing", "picked_up", "delivered", "rated"};
+// Span i runs from stage i to stage i + 1
+const char* const SPAN_NAMES[STAGE_COUNT - 1] = {"dispatch", "confirm", "kitchen", "delivery", "rating"};
+
+struct OrderTrace {
+    long long at[STAGE_COUNT] = {};
+
+    void mark(OrderStage stage) { if (!at[stage]) at[stage] = Clock::nowMicros(); }
+    bool has(OrderStage stage) const { return at[stage] != 0; }
+    // -1 when either end is missing
+    long long spanMicros(int span) const {
+        return (at[span] && at[span + 1]) ? at[span + 1] - at[span] : -1;
+    }
+};
+
+class Order : public Tracked<MEM_ACTIVE_ORDERS> {
+private:
+    string orderID;
+    string customerId;
+    string restaurantId;
+    string partnerId;
+    Cart orderCart;
+    string deliveryAddress;
+    string status; 
+    Money subtotal;
+    Money discountApplied;
+    Money deliveryTip;
+    Money deliveryFee;
+    uint32_t surgeMilli;
+    Money finalAmount;
+    int offerSlot;
+    int branchIndex;    // outlet of the restaurant that cooks it
+    int kitchenMinutes; // reserved in the branch kitchen until pickup
+    bool stockHeld;     // dish units reserved at the branch
+    OrderTrace trace;
+public:
+    Order(const Customer* c, const Restaurant* r, const Cart& cart) {
+    this->orderID = IDGenerator::generateOrderID();
+    this->customerId = c->getId();
+    this->restaurantId = r->getId();
+    this->orderCart = cart;
+    this->deliveryAddress = c->getAddress();
+    this->status = STATUS_PENDING;  // Use string constant
+    this->subtotal = cart.calculateSubtotal();
+    this->discountApplied = Money();
+    this->deliveryTip = Money();
+    this->deliveryFee = Money();
+    this->surgeMilli = 1000;
+    this->finalAmount = this->subtotal;
+    this->offerSlot = -1;
+    this->branchIndex = 0;
+    this->kitchenMinutes = 0;
+    this->stockHeld = false;
+    this->trace.mark(STAGE_CREATED);
+}
+
+    const string& getId() const { return orderID; }
+    const string& getCustomerId() const { return customerId; }
+    const string& getRestaurantId() const { return restaurantId; }
+    const string& getStatus() const { return status; } // Return string
+    Money getFinalAmount() const { return finalAmount; }
+    const string& getPartnerId() const { return partnerId; }
+
+    void applyOffer(const Offer& offer, const Customer* cust) {
+         discountApplied = offer.applyDiscount(subtotal, cust);
+         offerSlot = discountApplied > Money() ? offer.getTrackerSlot() : -1;
+         reprice();
+    }
+
+    void addTip(Money tip) {
+         deliveryTip = tip;
+         reprice();
+    }
+
+    void setDeliveryFee(Money fee, uint32_t surge) {
+         deliveryFee = fee;
+         surgeMilli = surge;
+         reprice();
+    }
+
+    void reprice() {
+         finalAmount = QuoteEngine::compose(subtotal, discountApplied, deliveryFee, deliveryTip).total;
+    }
+
+    void setStatus(const string& newStatus) {
+         status = newStatus;
+         if (newStatus == STATUS_PREPARING) trace.mark(STAGE_PREPARING);
+         else if (newStatus == STATUS_OUT_FOR_DELIVERY) trace.mark(STAGE_PICKED_UP);
+         else if (newStatus == STATUS_DELIVERED) trace.mark(STAGE_DELIVERED);
+    }
+
+    void assignPartner(const string& pId) {
+         partnerId = pId;
+         trace.mark(STAGE_ASSIGNED);
+    }
+
+    void markRated() { trace.mark(STAGE_RATED); }
+
+    void setBranch(int index) { branchIndex = index; }
+    int getBranch() const { return branchIndex; }
+    void setKitchenMinutes(int minutes) { kitchenMinutes = minutes; }
+    int getKitchenMinutes() const { return kitchenMinutes; }
+    void setStockHeld(bool held) { stockHeld = held; }
+    bool isStockHeld() const { return stockHeld; }
+
+    void displayDetails() const {
+        cout << "\n===================================" << endl;
+        cout << "          ORDER SUMMARY" << endl;
+        cout << "===================================" << endl;
+        cout << "Order ID: " << orderID << endl;
+        cout << "Status: " << status << endl; 
+        cout << "Delivery To: " << deliveryAddress << endl;
+        cout << "Subtotal: $" << subtotal << endl;
+        cout << "Discount: -$" << discountApplied << endl;
+        cout << "Delivery Fee: $" << deliveryFee;
+        if (surgeMilli > 1000) cout << " (" << fixed << setprecision(1) << surgeMilli / 1000.0 << "x busy-area pricing)";
+        cout << endl;
+        cout << "Tip: $" << deliveryTip << endl;
+        cout << "-----------------------------------" << endl;
+        cout << "TOTAL: $" << finalAmount << endl;
+        cout << "===================================" << endl;
+    }
+
+    const CartItems& getDishes() const { return orderCart.getItems(); }
+    Money getTip() const { return deliveryTip; }
+    Money getDeliveryFee() const { return deliveryFee; }
+    const string& getAddress() const { return deliveryAddress; }
+    Money getDiscount() const { return discountApplied; }
+    Money getSubtotal() const { return subtotal; }
+    int getOfferSlot() const { return offerSlot; }
+    const OrderTrace& getTrace() const { return trace; }
+};
+
+// ---PAYMENT & CHAT (ABSTRACTION/SIMULATION) ---
+// -------------------------------------------------------------
+struct PaymentResult {
+    bool success;
+    int attempts;
+    string reference; // gateway charge id, empty on failure
+    string message;
+};
+
+typedef function<void(const PaymentResult&)> PaymentCallback;
+
+// Latency is log-normal around the median; the percentages are rolled per attempt.
+struct GatewayProfile {
+    double medianLatencyMs;
+    double latencySpread;    // sigma of the underlying normal
+    int declinePercent;      // final answer, never retried
+    int transientPercent;    // retried with backoff
+    int lostResponsePercent; // the charge goes through but the reply never arrives
+};
+
+// Local stand-in for a remote payment gateway. Jobs run on a fixed pool of
+// workers (the in-flight limit) and never on the submitting thread. A key is
+// charged at most once: resubmitting it returns the same future, and a retry
+// after a lost reply finds the earlier charge in the ledger instead of
+// charging again.
+struct GatewayConfig {
+    int maxInFlight = 4;      // worker count, i.e. concurrent gateway calls
+    size_t maxQueued = 10000; // beyond this, submissions fail fast with "Gateway busy"
+    int maxAttempts = 3;
+    int timeoutMs = 800;
+    int backoffBaseMs = 50;
+    int keyTtlSeconds = 600;  // finished keys are forgotten after this; a later retry is a new charge
+};
+
+class PaymentGateway {
+private:
+    typedef chrono::steady_clock Clock;
+    enum AttemptOutcome { ATTEMPT_OK, ATTEMPT_DECLINED, ATTEMPT_TRANSIENT, ATTEMPT_TIMEOUT };
+
+    struct KeyState {
+        chrono::steady_clock::time_point submittedAt = chrono::steady_clock::now();
+        promise<PaymentResult> done;
+        shared_future<PaymentResult> future;
+        vector<PaymentCallback> callbacks;
+        bool finished = false;
+        PaymentResult result;
+    };
+
+    struct Job {
+        string key;
+        shared_ptr<KeyState> state; // the submission this job answers, even once its key is evicted
+        string mode;
+        Money amount;
+        int attempt;
+        Clock::time_point readyAt;
+        bool operator<(const Job& other) const { return readyAt > other.readyAt; } // min-heap on readyAt
+    };
+
+    GatewayConfig config;
+    map<string, GatewayProfile> profiles;
+    mutex lock;
+    condition_variable wake;
+    priority_queue<Job> queue;
+    unordered_map<string, shared_ptr<KeyState>> keys;
+    unordered_map<string, string> ledger; // idempotency key -> charge reference
+    deque<pair<Clock::time_point, string>> expiry; // finished keys, oldest first
+    long long chargeCounter;
+    bool stopping;
+    bool manual; // replaying: answers come from settle(), never from the workers
+    vector<thread> workers;
+
+    // The first answer for a key wins; false if it already had one, or if
+    // the key has since been evicted or submitted afresh
+    bool finish(const string& key, const shared_ptr<KeyState>& state, const PaymentResult& result, bool voidCharge = false) {
+        vector<PaymentCallback> callbacks;
+        {
+            lock_guard<mutex> guard(lock);
+            auto it = keys.find(key);
+            if (it == keys.end() || it->second != state || state->finished) return false;
+            if (voidCharge) ledger.erase(key);
+            state->finished = true;
+            state->result = result;
+            callbacks.swap(state->callbacks);
+            expiry.push_back({Clock::now() + chrono::seconds(config.keyTtlSeconds), key});
+        }
+        Metrics::instance().record(HIST_PAYMENT, chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - state->submittedAt).count());
+        Metrics::instance().count(result.success ? CTR_PAYMENTS_OK : CTR_PAYMENT_FAILURES);
+        state->done.set_value(result);
+        for (auto& cb : callbacks) cb(result);
+        return true;
+    }
+
+    // Caller holds the lock. An abandoned key is never charged again.
+    bool answered(const Job& job) const {
+        auto it = keys.find(job.key);
+        return it == keys.end() || it->second != job.state || it->second->finished;
+    }
+
+    // Caller holds the lock
+    void evictExpired() {
+        Clock::time_point now = Clock::now();
+        while (!expiry.empty() && expiry.front().first <= now) {
+            keys.erase(expiry.front().second);
+            ledger.erase(expiry.front().second);
+            expiry.pop_front();
+        }
+    }
+
+    // A reply lost on the last attempt may still have left a charge behind
+    bool chargedAlready(const string& key, string& reference) {
+        lock_guard<mutex> guard(lock);
+        auto charged = ledger.find(key);
+        if (charged == ledger.end()) return false;
+        reference = charged->second;
+        return true;
+    }
+
+    AttemptOutcome attempt(const Job& job, mt19937& rng, string& reference) {
+        GatewayProfile profile;
+        {
+            lock_guard<mutex> guard(lock);
+            auto it = profiles.find(job.mode);
+            if (it == profiles.end()) return ATTEMPT_DECLINED;
+            profile = it->second;
+        }
+        lognormal_distribution<double> latency(log(profile.medianLatencyMs), profile.latencySpread);
+        uniform_int_distribution<int> roll(0, 99);
+
+        double waitMs = latency(rng);
+        bool lostResponse = roll(rng) < profile.lostResponsePercent;
+        int outcomeRoll = roll(rng);
+
+        if (lostResponse || waitMs > config.timeoutMs) {
+            if (lostResponse) {
+                lock_guard<mutex> guard(lock);
+                if (!answered(job) && !ledger.count(job.key)) ledger[job.key] = "CH" + to_string(++chargeCounter);
+            }
+            this_thread::sleep_for(chrono::milliseconds(config.timeoutMs));
+            return ATTEMPT_TIMEOUT;
+        }
+        this_thread::sleep_for(chrono::microseconds(static_cast<long long>(waitMs * 1000)));
+
+        lock_guard<mutex> guard(lock);
+        if (answered(job)) return ATTEMPT_DECLINED; // abandoned meanwhile; the answer is already out
+        auto charged = ledger.find(job.key);
+        if (charged != ledger.end()) {
+            reference = charged->second; // already charged on an earlier attempt
+            return ATTEMPT_OK;
+        }
+        if (outcomeRoll < profile.declinePercent) return ATTEMPT_DECLINED;
+        if (outcomeRoll < profile.declinePercent + profile.transientPercent) return ATTEMPT_TRANSIENT;
+        reference = ledger[job.key] = "CH" + to_string(++chargeCounter);
+        return ATTEMPT_OK;
+    }
+
+    void workerLoop(unsigned seed) {
+        mt19937 rng(seed);
+        while (true) {
+            Job job;
+            {
+                unique_lock<mutex> guard(lock);
+                while (!stopping && (queue.empty() || queue.top().readyAt > Clock::now())) {
+                    if (queue.empty()) wake.wait(guard);
+                    else wake.wait_until(guard, queue.top().readyAt);
+                }
+                if (stopping) return;
+                job = queue.top();
+                queue.pop();
+            }
+
+            string reference;
+            AttemptOutcome outcome = attempt(job, rng, reference);
+            if (outcome == ATTEMPT_OK) {
+                finish(job.key, job.state, {true, job.attempt, reference, "Charged"});
+            } else if (outcome == ATTEMPT_DECLINED) {
+                finish(job.key, job.state, {false, job.attempt, "", "Declined by issuer"});
+            } else if (job.attempt >= config.maxAttempts) {
+                if (chargedAlready(job.key, reference)) finish(job.key, job.state, {true, job.attempt, reference, "Charged"});
+                else finish(job.key, job.state, {false, job.attempt, "", outcome == ATTEMPT_TIMEOUT ? "Gateway timed out" : "Gateway unavailable"});
+            } else {
+                // Exponential backoff with jitter so retries don't arrive in lockstep
+                int backoffMs = config.backoffBaseMs << (job.attempt - 1);
+                backoffMs += uniform_int_distribution<int>(0, backoffMs)(rng);
+                job.attempt++;
+                job.readyAt = Clock::now() + chrono::milliseconds(backoffMs);
+                lock_guard<mutex> guard(lock);
+                queue.push(job);
+                wake.notify_one();
+            }
+        }
+    }
+
+public:
+    PaymentGateway(GatewayConfig c = GatewayConfig(), unsigned seed = static_cast<unsigned>(RunContext::instance().random()))
+        : config(c), chargeCounter(0), stopping(false), manual(false) {
+        profiles[PAY_UPI] = {120.0, 0.6, 5, 8, 2};
+        profiles[PAY_CREDIT_CARD] = {250.0, 0.5, 3, 5, 1};
+        for (int i = 0; i < config.maxInFlight; i++) {
+            workers.emplace_back(&PaymentGateway::workerLoop, this, seed + i);
+        }
+    }
+
+    ~PaymentGateway() {
+        {
+            lock_guard<mutex> guard(lock);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (thread& w : workers) w.join();
+    }
+
+    void setManual(bool on) {
+        lock_guard<mutex> guard(lock);
+        manual = on;
+    }
+
+    // Answers a submitted key from outside, as a replayed trace does
+    bool settle(const string& key, const PaymentResult& result) {
+        shared_ptr<KeyState> state;
+        {
+            lock_guard<mutex> guard(lock);
+            auto it = keys.find(key);
+            if (it == keys.end()) return false;
+            state = it->second;
+        }
+        return finish(key, state, result);
+    }
+
+    // For a customer who left mid-payment. A key that has its answer keeps
+    // it; otherwise it fails now and any charge a lost reply left is voided.
+    PaymentResult abandon(const string& key) {
+        PaymentResult cancelled = {false, 0, "", "Cancelled"};
+        shared_ptr<KeyState> state;
+        {
+            lock_guard<mutex> guard(lock);
+            auto it = keys.find(key);
+            if (it == keys.end()) return cancelled;
+            if (it->second->finished) return it->second->result;
+            state = it->second;
+        }
+        if (finish(key, state, cancelled, true)) return cancelled;
+        lock_guard<mutex> guard(lock);
+        return state->result; // a worker answered first
+    }
+
+    void setProfile(const string& mode, const GatewayProfile& profile) {
+        lock_guard<mutex> guard(lock);
+        profiles[mode] = profile;
+    }
+
+    // Never blocks on the gateway: the job is queued and the future resolves
+    // later. onDone runs on a gateway worker (or right here if the key already
+    // has its answer).
+    shared_future<PaymentResult> submit(const string& key, const string& mode, Money amount, PaymentCallback onDone = nullptr) {
+        unique_lock<mutex> guard(lock);
+        evictExpired();
+        auto existing = keys.find(key);
+        if (existing != keys.end()) {
+            shared_ptr<KeyState> state = existing->second;
+            if (onDone) {
+                if (state->finished) {
+                    PaymentResult result = state->result;
+                    guard.unlock();
+                    onDone(result);
+                } else {
+                    state->callbacks.push_back(onDone);
+                }
+            }
+            return state->future;
+        }
+
+        shared_ptr<KeyState> state = make_shared<KeyState>();
+        state->future = state->done.get_future().share();
+        if (onDone) state->callbacks.push_back(onDone);
+        keys[key] = state;
+
+        if (manual) return state->future;
+        if (queue.size() >= config.maxQueued) {
+            guard.unlock();
+            finish(key, state, {false, 0, "", "Gateway busy"});
+            return state->future;
+        }
+        queue.push({key, state, mode, amount, 1, Clock::now()});
+        wake.notify_one();
+        return state->future;
+    }
+
+    // For payment modes that settle without a gateway round trip
+    static shared_future<PaymentResult> settled(const PaymentResult& result, PaymentCallback onDone = nullptr) {
+        Metrics::instance().count(result.success ? CTR_PAYMENTS_OK : CTR_PAYMENT_FAILURES);
+        promise<PaymentResult> done;
+        done.set_value(result);
+        if (onDone) onDone(result);
+        return done.get_future().share();
+    }
+};
+
+class Payment {
+public:
+    virtual shared_future<PaymentResult> processPayment(PaymentGateway& gateway, const string& idempotencyKey,
+                                                        Money amount, PaymentCallback onDone = nullptr) const = 0;
+    virtual string getMode() const = 0;
+    virtual ~Payment() = default;
+};
+
+class UPIPayment : public Payment {
+public:
+    shared_future<PaymentResult> processPayment(PaymentGateway& gateway, const string& idempotencyKey,
+                                                Money amount, PaymentCallback onDone = nullptr) const override {
+        cout << "Processing UPI Payment of $" << amount << "..." << endl;
+        return gateway.submit(idempotencyKey, getMode(), amount, onDone);
+    }
+    string getMode() const override { return PAY_UPI; }
+};
+
+class CreditCardPayment : public Payment {
+public:
+    shared_future<PaymentResult> processPayment(PaymentGateway& gateway, const string& idempotencyKey,
+                                                Money amount, PaymentCallback onDone = nullptr) const override {
+        cout << "Authorizing card payment of $" << amount << "..." << endl;
+        return gateway.submit(idempotencyKey, getMode(), amount, onDone);
+    }
+    string getMode() const override { return PAY_CREDIT_CARD; }
+};
+
+class COD : public Payment {
+public:
+    shared_future<PaymentResult> processPayment(PaymentGateway&, const string&,
+                                                Money amount, PaymentCallback onDone = nullptr) const override {
+        cout << "Cash on Delivery confirmed. Please keep $" << amount << " ready." << endl;
+        return PaymentGateway::settled({true, 0, "", "Collect on delivery"}, onDone);
+    }
+    string getMode() const override { return PAY_COD; }
+};
+
+class Chat {
+private:
+    using Text = basic_string<char, char_traits<char>, TaggedAllocator<char, MEM_CHAT>>;
+
+    string orderId;
+    vector<pair<Text, Text>, TaggedAllocator<pair<Text, Text>, MEM_CHAT>> messages;
+public:
+    Chat(const string& oId) : orderId(oId) {}
+
+    void sendMessage(const string& sender, const string& text) {
+         messages.push_back({Text(sender.begin(), sender.end()), Text(text.begin(), text.end())});
+         cout << "[" << sender << "]: " << text << endl;
+    }
+
+    // Updated to check string constants
+    void autoGenerateMessage(const string& status) 
+    {
+        string autoMessage;
+        if (status == STATUS_PREPARING) {
+            autoMessage = "Your order is being prepared by the restaurant!";
+        } else if (status == STATUS_OUT_FOR_DELIVERY) {
+            autoMessage = "Your food is out for delivery and should reach you shortly!";
+        } else if (status == STATUS_DELIVERED) {
+            autoMessage = "Enjoy your meal! Please don't forget to rate.";
+        } else {
+            return;
+        }
+        sendMessage("System Bot", autoMessage);
+    }
+
+    void displayHistory() const {
+        cout << "\n--- Chat History for " << orderId << " ---" << endl;
+        for (const auto& msg : messages) {
+            cout << "[" << msg.first << "]: " << msg.second << endl;
+        }
+    }
+};
+
+// --- RATING ---
+// -------------------------------------------------------------
+class SystemManager;
+
+struct RatingEvent {
+    uint32_t handle;
+    int stars;
+    long long atMicros;
+};
+
+// Collects rating events from any thread with a lock-free push and folds
+// them in batches on a single flusher thread. Each target keeps an integer
+// sum/count pair in 16.16 fixed point that decays exponentially with age, so
+// old reviews fade instead of weighing forever. Only the flusher touches the
+// tallies; readers see results through the RatingBoard.
+class RatingAggregator {
+private:
+    static const int FIXED_SHIFT = 16;
+    static const long long MICROS_PER_DAY = 86400LL * 1000000LL;
+
+    struct Node {
+        RatingEvent event;
+        Node* next;
+    };
+    struct Tally {
+        long long sum;   // stars << FIXED_SHIFT, decayed
+        long long count; // 1 << FIXED_SHIFT per review, decayed
+        long long day;   // day the tally was last decayed to
+        uint32_t reviews;
+    };
+
+    atomic<Node*> pending;
+    unordered_map<uint32_t, Tally> tallies;
+    function<void(uint32_t, uint32_t, uint32_t)> publishListener; // (handle, milliStars, reviews)
+    double halfLifeDays;
+    mutex flushLock; // serializes flushers only; submit never takes it
+
+    atomic<bool> stopping;
+    thread flusher;
+
+    void decayTo(Tally& t, long long day) const {
+        if (day <= t.day) return;
+        long long factor = llround(pow(0.5, (day - t.day) / halfLifeDays) * (1LL << FIXED_SHIFT));
+        t.sum = (t.sum * factor) >> FIXED_SHIFT;
+        t.count = (t.count * factor) >> FIXED_SHIFT;
+        t.day = day;
+    }
+
+    void fold(const RatingEvent& e) {
+        RatingBoard& board = RatingBoard::instance();
+        long long day = e.atMicros / MICROS_PER_DAY;
+        auto it = tallies.find(e.handle);
+        if (it == tallies.end()) {
+            // Seed from whatever was published before (e.g. a new restaurant's starting 4.5)
+            Tally seed;
+            uint32_t prior = board.getCount(e.handle);
+            seed.reviews = prior;
+            seed.count = static_cast<long long>(prior) << FIXED_SHIFT;
+            seed.sum = llround(board.getStars(e.handle) * prior * (1LL << FIXED_SHIFT));
+            seed.day = day;
+            it = tallies.emplace(e.handle, seed).first;
+        }
+        Tally& t = it->second;
+        decayTo(t, day);
+        t.sum += static_cast<long long>(e.stars) << FIXED_SHIFT;
+        t.count += 1LL << FIXED_SHIFT;
+        t.reviews++;
+    }
+
+public:
+    RatingAggregator(double halfLife = 90.0, int flushIntervalMs = TIMER_INTERVAL_MS[TIMER_RATING_FLUSH])
+        : pending(nullptr), halfLifeDays(halfLife), stopping(false) {
+        if (RunContext::instance().isDeterministic()) return;
+        flusher = thread([this, flushIntervalMs]() {
+            while (!stopping.load(memory_order_relaxed)) {
+                this_thread::sleep_for(chrono::milliseconds(flushIntervalMs));
+                flush();
+            }
+        });
+    }
+
+    ~RatingAggregator() {
+        stopping.store(true, memory_order_relaxed);
+        if (flusher.joinable()) flusher.join();
+        flush();
+    }
+
+    // Runs on the flusher thread after each score is published
+    void setPublishListener(function<void(uint32_t, uint32_t, uint32_t)> listener) {
+        lock_guard<mutex> guard(flushLock);
+        publishListener = listener;
+    }
+
+    void submit(const RatingEvent& e) {
+        Node* node = new Node{e, pending.load(memory_order_relaxed)};
+        while (!pending.compare_exchange_weak(node->next, node, memory_order_release, memory_order_relaxed)) {}
+    }
+
+    // Drains everything submitted so far and publishes the touched scores
+    void flush() {
+        lock_guard<mutex> guard(flushLock);
+        Node* head = pending.exchange(nullptr, memory_order_acquire);
+        if (!head) return;
+        ScopedTimer timer(HIST_RATING_FLUSH);
+
+        Node* ordered = nullptr; // the stack is newest-first; fold oldest-first
+        while (head) {
+            Node* next = head->next;
+            head->next = ordered;
+            ordered = head;
+            head = next;
+        }
+
+        vector<uint32_t> touched;
+        while (ordered) {
+            fold(ordered->event);
+            touched.push_back(ordered->event.handle);
+            Node* done = ordered;
+            ordered = ordered->next;
+            delete done;
+        }
+
+        sort(touched.begin(), touched.end());
+        touched.erase(unique(touched.begin(), touched.end()), touched.end());
+        long long today = Clock::nowMicros() / MICROS_PER_DAY;
+        for (uint32_t handle : touched) {
+            Tally& t = tallies[handle];
+            decayTo(t, today);
+            uint32_t milli = t.count > 0 ? static_cast<uint32_t>((t.sum * 1000 + t.count / 2) / t.count) : 0;
+            RatingBoard::instance().publish(handle, milli, t.reviews);
+            if (publishListener) publishListener(handle, milli, t.reviews);
+        }
+    }
+};
+
+class Rating {
+public:
+    void apply(Order* order, SystemManager& manager, int foodStars, int deliveryStars, const string& feedback);
+};
+
+
+// --- RANKINGS ---
+// -------------------------------------------------------------
+// Order-statistic treap: ids ordered by score (highest first, ties by id),
+// with subtree sizes so reading any page costs O(log n + page size).
+class RankTree {
+private:
+    struct Node {
+        long long score;
+        uint32_t id;
+        uint32_t priority;
+        uint32_t size;
+        int left, right;
+    };
+
+    vector<Node> nodes;
+    vector<int> freeNodes;
+    unordered_map<uint32_t, long long> scores;
+    int root = -1;
+    uint32_t seed = 2463534242u;
+
+    uint32_t nextPriority() {
+        seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+        return seed;
+    }
+
+    uint32_t sizeOf(int n) const { return n < 0 ? 0 : nodes[n].size; }
+    void pull(int n) { nodes[n].size = 1 + sizeOf(nodes[n].left) + sizeOf(nodes[n].right); }
+
+    // Does node n sort before (score, id)? With inclusive, also when equal.
+    bool before(int n, long long score, uint32_t id, bool inclusive) const {
+        if (nodes[n].score != score) return nodes[n].score > score;
+        return inclusive ? nodes[n].id <= id : nodes[n].id < id;
+    }
+
+    void split(int t, long long score, uint32_t id, bool inclusive, int& l, int& r) {
+        if (t < 0) { l = r = -1; return; }
+        if (before(t, score, id, inclusive)) {
+            split(nodes[t].right, score, id, inclusive, nodes[t].right, r);
+            l = t;
+        } else {
+            split(nodes[t].left, score, id, inclusive, l, nodes[t].left);
+            r = t;
+        }
+        pull(t);
+    }
+
+    int merge(int a, int b) {
+        if (a < 0) return b;
+        if (b < 0) return a;
+        if (nodes[a].priority > nodes[b].priority) {
+            nodes[a].right = merge(nodes[a].right, b);
+            pull(a);
+            return a;
+        }
+        nodes[b].left = merge(a, nodes[b].left);
+        pull(b);
+        return b;
+    }
+
+    void collect(int n, size_t& skip, size_t& limit, vector<pair<uint32_t, long long>>& out) const {
+        if (n < 0 || limit == 0) return;
+        if (skip >= sizeOf(n)) { skip -= sizeOf(n); return; }
+        collect(nodes[n].left, skip, limit, out);
+        if (limit == 0) return;
+        if (skip > 0) skip--;
+        else { out.push_back({nodes[n].id, nodes[n].score}); limit--; }
+        collect(nodes[n].right, skip, limit, out);
+    }
+
+public:
+    void erase(uint32_t id) {
+        auto it = scores.find(id);
+        if (it == scores.end()) return;
+        int l, mid, r;
+        split(root, it->second, id, false, l, r);
+        split(r, it->second, id, true, mid, r);
+        if (mid >= 0) freeNodes.push_back(mid);
+        root = merge(l, r);
+        scores.erase(it);
+    }
+
+    void upsert(uint32_t id, long long score) {
+        erase(id);
+        int n;
+        if (!freeNodes.empty()) { n = freeNodes.back(); freeNodes.pop_back(); }
+        else { n = static_cast<int>(nodes.size()); nodes.push_back(Node()); }
+        nodes[n] = {score, id, nextPriority(), 1, -1, -1};
+
+        int l, r;
+        split(root, score, id, false, l, r);
+        root = merge(merge(l, n), r);
+        scores[id] = score;
+    }
+
+    long long scoreOf(uint32_t id) const {
+        auto it = scores.find(id);
+        return it == scores.end() ? 0 : it->second;
+    }
+
+    size_t size() const { return sizeOf(root); }
+
+    vector<pair<uint32_t, long long>> page(size_t offset, size_t limit) const {
+        vector<pair<uint32_t, long long>> out;
+        out.reserve(limit);
+        collect(root, offset, limit, out);
+        return out;
+    }
+};
+
+enum RankBy { RANK_BEST_RATED, RANK_MOST_ORDERED };
+
+struct RankedDish {
+    string name;
+    string restaurantId;
+    string restaurantName;
+    long long score;
+};
+
+// Restaurant and dish leaderboards kept up to date as ratings are published
+// and orders are placed. Everything is keyed by rating handle. Updates happen
+// on the rating flusher and ordering paths; readers share the lock.
+class RankingIndex {
+private:
+    struct RestaurantEntry { Restaurant* restaurant; string cuisine; };
+    struct DishEntry { string name; string restaurantId; string restaurantName; };
+
+    mutable shared_mutex lock;
+    RankTree bestRestaurants, busiestRestaurants;
+    RankTree bestDishes, popularDishes;
+    unordered_map<string, RankTree> bestByCuisine;
+    unordered_map<uint32_t, RestaurantEntry> restaurants;
+    unordered_map<uint32_t, DishEntry> dishes;
+
+public:
+    void addRestaurant(Restaurant* r) {
+        unique_lock<shared_mutex> guard(lock);
+        long long milli = llround(r->getRating() * 1000);
+        restaurants[r->getRatingHandle()] = {r, r->getCuisine()};
+        bestRestaurants.upsert(r->getRatingHandle(), milli);
+        busiestRestaurants.upsert(r->getRatingHandle(), 0);
+        bestByCuisine[r->getCuisine()].upsert(r->getRatingHandle(), milli);
+    }
+
+    void addDish(const Restaurant& r, const Dish& d) {
+        unique_lock<shared_mutex> guard(lock);
+        dishes[d.getRatingHandle()] = {d.getName(), r.getId(), r.getName()};
+        popularDishes.upsert(d.getRatingHandle(), 0);
+        if (d.getRatingCount() > 0) bestDishes.upsert(d.getRatingHandle(), llround(d.getRating() * 1000));
+    }
+
+    void removeDish(const Dish& d) {
+        unique_lock<shared_mutex> guard(lock);
+        dishes.erase(d.getRatingHandle());
+        bestDishes.erase(d.getRatingHandle());
+        popularDishes.erase(d.getRatingHandle());
+    }
+
+    void onRatingPublished(uint32_t handle, uint32_t milliStars) {
+        unique_lock<shared_mutex> guard(lock);
+        auto r = restaurants.find(handle);
+        if (r != restaurants.end()) {
+            bestRestaurants.upsert(handle, milliStars);
+            bestByCuisine[r->second.cuisine].upsert(handle, milliStars);
+        } else if (dishes.count(handle)) {
+            bestDishes.upsert(handle, milliStars);
+        }
+    }
+
+    void recordOrder(const Restaurant& r, const CartItems& items) {
+        unique_lock<shared_mutex> guard(lock);
+        uint32_t rh = r.getRatingHandle();
+        busiestRestaurants.upsert(rh, busiestRestaurants.scoreOf(rh) + 1);
+        for (const auto& pair : items) {
+            uint32_t dh = pair.first.getRatingHandle();
+            if (dishes.count(dh)) popularDishes.upsert(dh, popularDishes.scoreOf(dh) + pair.second);
+        }
+    }
+
+    vector<Restaurant*> topRestaurants(RankBy by, size_t offset, size_t limit) const {
+        shared_lock<shared_mutex> guard(lock);
+        const RankTree& tree = (by == RANK_BEST_RATED) ? bestRestaurants : busiestRestaurants;
+        vector<Restaurant*> out;
+        for (const auto& entry : tree.page(offset, limit)) out.push_back(restaurants.at(entry.first).restaurant);
+        return out;
+    }
+
+    vector<Restaurant*> topInCuisine(const string& cuisine, size_t offset, size_t limit) const {
+        shared_lock<shared_mutex> guard(lock);
+        vector<Restaurant*> out;
+        auto tree = bestByCuisine.find(cuisine);
+        if (tree == bestByCuisine.end()) return out;
+        for (const auto& entry : tree->second.page(offset, limit)) out.push_back(restaurants.at(entry.first).restaurant);
+        return out;
+    }
+
+    vector<RankedDish> topDishes(RankBy by, size_t offset, size_t limit) const {
+        shared_lock<shared_mutex> guard(lock);
+        const RankTree& tree = (by == RANK_BEST_RATED) ? bestDishes : popularDishes;
+        vector<RankedDish> out;
+        for (const auto& entry : tree.page(offset, limit)) {
+            const DishEntry& d = dishes.at(entry.first);
+            out.push_back({d.name, d.restaurantId, d.restaurantName, entry.second});
+        }
+        return out;
+    }
+
+    size_t restaurantCount() const {
+        shared_lock<shared_mutex> guard(lock);
+        return restaurants.size();
+    }
+
+    // False once the dish has been removed from its menu
+    bool describeDish(uint32_t handle, RankedDish& out) const {
+        shared_lock<shared_mutex> guard(lock);
+        auto d = dishes.find(handle);
+        if (d == dishes.end()) return false;
+        out = {d->second.name, d->second.restaurantId, d->second.restaurantName, popularDishes.scoreOf(handle)};
+        return true;
+    }
+};
+
+// --- SEARCH ---
+// -------------------------------------------------------------
+struct SearchHit {
+    string name;
+    bool isRestaurant;
+    string restaurantId;
+    string restaurantName;
+    double rating;
+};
+
+// Catalog-wide name search. A prefix trie answers autocomplete: every node
+// but the root caches its best-rated documents, so a lookup is a walk down
+// the prefix plus a copy of that cache, independent of catalog size. Every word of a name is
+// indexed, so "butt" finds "Paneer Butter Masala". Trigram postings catch
+// typos when the prefix path finds too little.
+class SearchIndex {
+private:
+    static constexpr size_t CACHE_SIZE = 16; // kept per node; queries return fewer
+    static const size_t MAX_KEY_DEPTH = 24;
+
+    struct Doc {
+        string name;
+        string lower;
+        uint32_t handle;
+        bool isRestaurant;
+        string restaurantId;
+        string restaurantName;
+        long long score;
+        bool live;
+        vector<string> keys;
+    };
+
+    struct TrieNode {
+        vector<pair<char, uint32_t>> children; // sorted by char
+        vector<uint32_t> terminal;             // docs whose key ends here
+        vector<pair<long long, uint32_t>> top; // best (score, doc), highest first
+    };
+
+    mutable shared_mutex lock;
+    vector<Doc> docs;
+    unordered_map<uint32_t, uint32_t> docByHandle;
+    vector<TrieNode> trie{TrieNode()};
+    unordered_map<uint32_t, vector<uint32_t>> trigrams; // doc ids, sorted
+    vector<uint32_t> freeIds; // removed docs, reused by the next add
+
+    static string toLower(const string& text) {
+        string out = text;
+        for (char& ch : out) ch = static_cast<char>(tolower(static_cast<unsigned char>(ch)));
+        return out;
+    }
+
+    // Each word is padded on its own so word boundaries form trigrams too
+    static vector<uint32_t> trigramsOf(const string& lower) {
+        vector<uint32_t> grams;
+        stringstream words(lower);
+        string word;
+        while (words >> word) {
+            string padded = "$" + word + "$";
+            for (size_t i = 0; i + 3 <= padded.size(); i++) {
+                grams.push_back((static_cast<uint8_t>(padded[i]) << 16) | (static_cast<uint8_t>(padded[i + 1]) << 8) | static_cast<uint8_t>(padded[i + 2]));
+            }
+        }
+        sort(grams.begin(), grams.end());
+        grams.erase(unique(grams.begin(), grams.end()), grams.end());
+        return grams;
+    }
+
+    // One key per word start: "veg biryani" -> "veg biryani", "biryani"
+    static vector<string> keysOf(const string& lower) {
+        vector<string> keys;
+        for (size_t i = 0; i < lower.size(); i++) {
+            if (lower[i] != ' ' && (i == 0 || lower[i - 1] == ' ')) keys.push_back(lower.substr(i, MAX_KEY_DEPTH));
+        }
+        sort(keys.begin(), keys.end());
+        keys.erase(unique(keys.begin(), keys.end()), keys.end());
+        return keys;
+    }
+
+    uint32_t child(uint32_t node, char ch, bool create) {
+        auto& kids = trie[node].children;
+        auto it = lower_bound(kids.begin(), kids.end(), make_pair(ch, 0u));
+        if (it != kids.end() && it->first == ch) return it->second;
+        if (!create) return 0;
+        uint32_t fresh = static_cast<uint32_t>(trie.size());
+        trie[node].children.insert(it, {ch, fresh}); // insert before push_back invalidates kids
+        trie.push_back(TrieNode());
+        return fresh;
+    }
+
+    uint32_t find(const string& prefix) const {
+        uint32_t node = 0;
+        for (char ch : prefix) {
+            const auto& kids = trie[node].children;
+            auto it = lower_bound(kids.begin(), kids.end(), make_pair(ch, 0u));
+            if (it == kids.end() || it->first != ch) return 0;
+            node = it->second;
+        }
+        return node;
+    }
+
+    bool dropFromTop(uint32_t node, uint32_t doc) {
+        auto& top = trie[node].top;
+        for (size_t i = 0; i < top.size(); i++) {
+            if (top[i].second == doc) { top.erase(top.begin() + i); return true; }
+        }
+        return false;
+    }
+
+    void offer(uint32_t node, uint32_t doc, long long score) {
+        dropFromTop(node, doc);
+        auto& top = trie[node].top;
+        auto pos = top.begin();
+        while (pos != top.end() && *pos > make_pair(score, doc)) ++pos; // the order refill sorts in
+        if (pos - top.begin() >= static_cast<long>(CACHE_SIZE)) return;
+        top.insert(pos, {score, doc});
+        if (top.size() > CACHE_SIZE) top.pop_back();
+    }
+
+    // Rebuilds a node's cache after removals and score drops, from the docs
+    // ending here and the children's caches, which must be current already:
+    // a doc in this node's best K is in the best K of every child holding it.
+    // So the cost is the fan-out, not the subtree.
+    void refill(uint32_t node) {
+        vector<pair<long long, uint32_t>> all;
+        for (uint32_t d : trie[node].terminal) all.push_back({docs[d].score, d});
+        for (const auto& kid : trie[node].children) {
+            for (const auto& entry : trie[kid.second].top) all.push_back({docs[entry.second].score, entry.second});
+        }
+        sort(all.begin(), all.end(), greater<pair<long long, uint32_t>>());
+        all.erase(unique(all.begin(), all.end()), all.end());
+        if (all.size() > CACHE_SIZE) all.resize(CACHE_SIZE);
+        trie[node].top = all;
+    }
+
+    // Every node on the doc's key paths but the root, once each, deepest
+    // first so children are settled before their parent is refilled
+    vector<uint32_t> nodesOf(uint32_t id) {
+        vector<pair<size_t, uint32_t>> byDepth;
+        for (const string& key : docs[id].keys) {
+            uint32_t node = 0;
+            for (size_t depth = 0; depth < key.size(); depth++) {
+                node = child(node, key[depth], false);
+                byDepth.push_back({depth + 1, node});
+            }
+        }
+        sort(byDepth.begin(), byDepth.end(), greater<pair<size_t, uint32_t>>());
+        byDepth.erase(unique(byDepth.begin(), byDepth.end()), byDepth.end());
+        vector<uint32_t> nodes;
+        for (const auto& entry : byDepth) nodes.push_back(entry.second);
+        return nodes;
+    }
+
+    void reoffer(uint32_t node, uint32_t doc, long long score) {
+        offer(node, doc, score);
+        const auto& top = trie[node].top;
+        if (top.size() < CACHE_SIZE || top.back().second == doc) refill(node);
+    }
+
+    void addDoc(Doc doc) {
+        uint32_t id = static_cast<uint32_t>(docs.size());
+        if (!freeIds.empty()) {
+            id = freeIds.back();
+            freeIds.pop_back();
+        }
+        doc.keys = keysOf(doc.lower);
+        docByHandle[doc.handle] = id;
+        if (id == docs.size()) docs.push_back(doc);
+        else docs[id] = doc;
+
+        for (const string& key : docs[id].keys) {
+            uint32_t node = 0;
+            for (char ch : key) {
+                if (node) offer(node, id, docs[id].score);
+                node = child(node, ch, true);
+            }
+            trie[node].terminal.push_back(id);
+            offer(node, id, docs[id].score);
+        }
+        for (uint32_t gram : trigramsOf(docs[id].lower)) {
+            auto& postings = trigrams[gram];
+            postings.insert(upper_bound(postings.begin(), postings.end(), id), id);
+        }
+    }
+
+    void removeDoc(uint32_t handle) {
+        auto found = docByHandle.find(handle);
+        if (found == docByHandle.end()) return;
+        uint32_t id = found->second;
+        docByHandle.erase(found);
+
+        for (const string& key : docs[id].keys) {
+            uint32_t node = 0;
+            for (char ch : key) node = child(node, ch, false);
+            auto& terminal = trie[node].terminal;
+            terminal.erase(remove(terminal.begin(), terminal.end(), id), terminal.end());
+        }
+        for (uint32_t node : nodesOf(id)) {
+            if (dropFromTop(node, id)) refill(node);
+        }
+        for (uint32_t gram : trigramsOf(docs[id].lower)) {
+            auto postings = trigrams.find(gram);
+            if (postings == trigrams.end()) continue;
+            auto& ids = postings->second;
+            auto at = lower_bound(ids.begin(), ids.end(), id);
+            if (at != ids.end() && *at == id) ids.erase(at);
+            if (ids.empty()) trigrams.erase(postings);
+        }
+        docs[id] = Doc();
+        docs[id].live = false;
+        freeIds.push_back(id);
+    }
+
+    SearchHit hitFor(uint32_t id) const {
+        const Doc& d = docs[id];
+        return {d.name, d.isRestaurant, d.restaurantId, d.restaurantName, d.score / 1000.0};
+    }
+
+public:
+    void addRestaurant(const Restaurant& r) {
+        unique_lock<shared_mutex> guard(lock);
+        addDoc({r.getName(), toLower(r.getName()), r.getRatingHandle(), true, r.getId(), r.getName(),
+                llround(r.getRating() * 1000), true, {}});
+    }
+
+    void addDish(const Restaurant& r, const Dish& d) {
+        unique_lock<shared_mutex> guard(lock);
+        addDoc({d.getName(), toLower(d.getName()), d.getRatingHandle(), false, r.getId(), r.getName(),
+                d.getRatingCount() > 0 ? llround(d.getRating() * 1000) : 0, true, {}});
+    }
+
+    void removeDish(const Dish& d) {
+        unique_lock<shared_mutex> guard(lock);
+        removeDoc(d.getRatingHandle());
+    }
+
+    // A score change re-offers the doc along its key paths. A drop can push
+    // it out of a node's cache, or to its last place ahead of a doc the cache
+    // never held; either way the node is refilled from its children.
+    void onRatingPublished(uint32_t handle, uint32_t milliStars) {
+        unique_lock<shared_mutex> guard(lock);
+        auto found = docByHandle.find(handle);
+        if (found == docByHandle.end()) return;
+        uint32_t id = found->second;
+        docs[id].score = milliStars;
+        for (uint32_t node : nodesOf(id)) reoffer(node, id, milliStars);
+    }
+
+    vector<SearchHit> autocomplete(const string& prefix, size_t limit = 8) const {
+        shared_lock<shared_mutex> guard(lock);
+        vector<SearchHit> hits;
+        string key = toLower(prefix);
+        if (key.empty()) return hits;
+        uint32_t node = find(key.substr(0, MAX_KEY_DEPTH));
+        if (node == 0) return hits;
+        for (const auto& entry : trie[node].top) {
+            if (hits.size() >= limit) break;
+            if (docs[entry.second].live && docs[entry.second].lower.find(key) != string::npos) hits.push_back(hitFor(entry.second));
+        }
+        return hits;
+    }
+
+    // Prefix hits first, then typo-tolerant matches ranked by trigram overlap and rating
+    vector<SearchHit> search(const string& query, size_t limit = 8) const {
+        vector<SearchHit> hits = autocomplete(query, limit);
+        if (hits.size() >= limit) return hits;
+
+        shared_lock<shared_mutex> guard(lock);
+        vector<uint32_t> grams = trigramsOf(toLower(query));
+        unordered_map<uint32_t, int> shared;
+        for (uint32_t gram : grams) {
+            auto postings = trigrams.find(gram);
+            if (postings == trigrams.end()) continue;
+            for (uint32_t id : postings->second) shared[id]++;
+        }
+
+        vector<pair<double, uint32_t>> ranked;
+        for (const auto& entry : shared) {
+            const Doc& d = docs[entry.first];
+            if (!d.live) continue;
+            double similarity = static_cast<double>(entry.second) / grams.size(); // share of the query found
+            if (similarity < 0.4) continue;
+            ranked.push_back({similarity * 5.0 + d.score / 1000.0, entry.first}); // similarity dominates, rating breaks ties
+        }
+        sort(ranked.begin(), ranked.end(), greater<pair<double, uint32_t>>());
+
+        for (const auto& entry : ranked) {
+            if (hits.size() >= limit) break;
+            const Doc& d = docs[entry.second];
+            bool seen = false;
+            for (const SearchHit& h : hits) seen = seen || (h.name == d.name && h.restaurantId == d.restaurantId);
+            if (!seen) hits.push_back(hitFor(entry.second));
+        }
+        return hits;
+    }
+};
+
+// --- RECOMMENDATIONS ---
+// -------------------------------------------------------------
+// Completed orders flattened into arrays: order i is dishes/quantities[offsets[i], offsets[i + 1]).
+struct OrderHistoryBatch {
+    vector<long long> customers;
+    vector<size_t> offsets{0};
+    vector<uint32_t> dishes;
+    vector<int> quantities;
+
+    void addOrder(long long customer, const CartItems& items) {
+        customers.push_back(customer);
+        for (const auto& pair : items) {
+            dishes.push_back(pair.first.getRatingHandle());
+            quantities.push_back(pair.second);
+        }
+        offsets.push_back(dishes.size());
+    }
+
+    size_t size() const { return customers.size(); }
+};
+
+typedef vector<pair<uint32_t, uint32_t>> TopList; // (key, count), highest first
+
+// Counts per key plus the K largest. Counts only ever grow, so the top list
+// stays exact with an O(K) update per bump, and reading it is a copy.
+class TopCounts {
+private:
+    static const size_t TOP_K = 5;
+    unordered_map<uint32_t, uint32_t> counts;
+    TopList best;
+
+public:
+    void bump(uint32_t key, uint32_t by) {
+        uint32_t count = (counts[key] += by);
+        auto pos = find_if(best.begin(), best.end(), [key](const pair<uint32_t, uint32_t>& e) { return e.first == key; });
+        if (pos != best.end()) {
+            pos->second = count;
+        } else if (best.size() < TOP_K) {
+            best.push_back({key, count});
+            pos = best.end() - 1;
+        } else if (count > best.back().second) {
+            best.back() = {key, count};
+            pos = best.end() - 1;
+        } else {
+            return;
+        }
+        while (pos != best.begin() && (pos - 1)->second < pos->second) { // bubble up
+            iter_swap(pos, pos - 1);
+            --pos;
+        }
+    }
+
+    const TopList& top() const { return best; }
+};
+
+// "Customers also ordered" from a sparse dish co-occurrence matrix and
+// "your usuals" from per-customer dish counts, each row a TopCounts.
+class Recommender {
+private:
+    typedef TopCounts Row;
+
+    mutable shared_mutex lock;
+    unordered_map<uint32_t, Row> coOrdered;  // dish -> dishes seen in the same order
+    unordered_map<long long, Row> usuals;    // customer -> dishes they ordered
+
+    static void addOrderTo(unordered_map<uint32_t, Row>& rows, const uint32_t* dishes, size_t n, unsigned part, unsigned parts) {
+        for (size_t a = 0; a < n; a++) {
+            if (dishes[a] % parts != part) continue;
+            Row& row = rows[dishes[a]];
+            for (size_t b = 0; b < n; b++) {
+                if (b != a && dishes[b] != dishes[a]) row.bump(dishes[b], 1);
+            }
+        }
+    }
+
+public:
+    void ingest(long long customer, const CartItems& items) {
+        vector<uint32_t> dishes;
+        for (const auto& pair : items) dishes.push_back(pair.first.getRatingHandle());
+
+        unique_lock<shared_mutex> guard(lock);
+        addOrderTo(coOrdered, dishes.data(), dishes.size(), 0, 1);
+        Row& mine = usuals[customer];
+        for (const auto& pair : items) mine.bump(pair.first.getRatingHandle(), pair.second);
+    }
+
+    // Each thread owns the rows whose key hashes to it and scans the whole
+    // history read-only, so there is nothing to merge afterwards.
+    void rebuild(const OrderHistoryBatch& history, unsigned threadCount = 0) {
+        if (threadCount == 0) threadCount = max(1u, thread::hardware_concurrency());
+        vector<unordered_map<uint32_t, Row>> dishParts(threadCount);
+        vector<unordered_map<long long, Row>> customerParts(threadCount);
+
+        auto work = [&](unsigned part) {
+            for (size_t i = 0; i < history.size(); i++) {
+                size_t begin = history.offsets[i], end = history.offsets[i + 1];
+                addOrderTo(dishParts[part], &history.dishes[begin], end - begin, part, threadCount);
+                if (static_cast<unsigned long long>(history.customers[i]) % threadCount == part) {
+                    Row& mine = customerParts[part][history.customers[i]];
+                    for (size_t l = begin; l < end; l++) mine.bump(history.dishes[l], history.quantities[l]);
+                }
+            }
+        };
+        vector<thread> workers;
+        for (unsigned t = 1; t < threadCount; t++) workers.emplace_back(work, t);
+        work(0);
+        for (thread& w : workers) w.join();
+
+        unordered_map<uint32_t, Row> rebuiltDishes;
+        unordered_map<long long, Row> rebuiltUsuals;
+        for (auto& part : dishParts) for (auto& row : part) rebuiltDishes.emplace(row.first, move(row.second));
+        for (auto& part : customerParts) for (auto& row : part) rebuiltUsuals.emplace(row.first, move(row.second));
+
+        unique_lock<shared_mutex> guard(lock);
+        coOrdered.swap(rebuiltDishes);
+        usuals.swap(rebuiltUsuals);
+    }
+
+    TopList alsoOrdered(uint32_t dish) const {
+        shared_lock<shared_mutex> guard(lock);
+        auto row = coOrdered.find(dish);
+        return row == coOrdered.end() ? TopList() : row->second.top();
+    }
+
+    TopList usualsFor(long long customer) const {
+        shared_lock<shared_mutex> guard(lock);
+        auto row = usuals.find(customer);
+        return row == usuals.end() ? TopList() : row->second.top();
+    }
+};
+
+// --- ORDER ARCHIVE ---
+// -------------------------------------------------------------
+// Finished orders stored column by column. Rows fill an open block; full
+// blocks are sealed by delta + zigzag + varint encoding each column, which
+// shrinks sorted timestamps and small IDs to a byte or two per row. Queries
+// decode only the columns they read, spread blocks across threads, and keep
+// their inner loops branch-free so the compiler can vectorize them.
+struct TipStats {
+    static const int BUCKETS = 6; // $0, <$2, <$5, <$10, <$20, $20+
+    long long counts[BUCKETS] = {0, 0, 0, 0, 0, 0};
+    long long orders = 0;
+    Money total;
+};
+
+// Dish rating handles and offer slots only hold for one run. A saved
+// archive names dishes and offers instead, and these map the names back.
+class ArchiveCatalog {
+public:
+    virtual bool dishName(uint32_t handle, string& restaurantId, string& name) const = 0;
+    virtual int64_t dishHandle(const string& restaurantId, const string& name) = 0; // -1 if gone
+    virtual string offerCode(int slot) const = 0;
+    virtual int offerSlot(const string& code) const = 0; // -1 if gone
+    virtual ~ArchiveCatalog() = default;
+};
+
+class OrderArchive {
+public:
+    enum Column { COL_CREATED, COL_DELIVERED, COL_RESTAURANT, COL_PARTNER, COL_CUSTOMER,
+                  COL_SUBTOTAL, COL_DISCOUNT, COL_TIP, COL_OFFER, COL_LINE_COUNT, ORDER_COLUMNS };
+    enum LineColumn { LINE_DISH, LINE_QTY, LINE_COLUMNS };
+
+private:
+    static const size_t BLOCK_ROWS = 65536;
+    static const long long MICROS_PER_HOUR = 3600LL * 1000000LL;
+
+    using Values = vector<int64_t, TaggedAllocator<int64_t, MEM_COMPLETED_ORDERS>>;
+    using Packed = vector<uint8_t, TaggedAllocator<uint8_t, MEM_COMPLETED_ORDERS>>;
+
+    struct Block {
+        size_t rows = 0, lineRows = 0;
+        Values cols[ORDER_COLUMNS];
+        Values lines[LINE_COLUMNS];
+    };
+    struct SealedBlock {
+        uint64_t id = 0; // kept in the file, so loading a block twice is noticed
+        size_t rows = 0, lineRows = 0;
+        long long minCreated = 0, maxCreated = 0;
+        Packed cols[ORDER_COLUMNS];
+        Packed lines[LINE_COLUMNS];
+    };
+
+    mutable mutex lock;
+    Block open;
+    vector<shared_ptr<const SealedBlock>> sealed;
+
+    static void encode(const Values& values, Packed& out) {
+        int64_t prev = 0;
+        for (int64_t v : values) {
+            uint64_t delta = static_cast<uint64_t>(v) - static_cast<uint64_t>(prev);
+            uint64_t zig = (delta << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(delta) >> 63);
+            while (zig >= 0x80) { out.push_back(static_cast<uint8_t>(zig | 0x80)); zig >>= 7; }
+            out.push_back(static_cast<uint8_t>(zig));
+            prev = v;
+        }
+    }
+
+    // False if the bytes run out, or a varint runs long, before n values
+    static bool decode(const Packed& bytes, size_t n, Values& out) {
+        if (n > bytes.size()) return false; // every value takes at least a byte
+        out.resize(n);
+        const uint8_t* p = bytes.data();
+        const uint8_t* end = p + bytes.size();
+        int64_t prev = 0;
+        for (size_t i = 0; i < n; i++) {
+            uint64_t zig = 0;
+            int shift = 0;
+            while (p < end && (*p & 0x80) && shift < 63) { zig |= static_cast<uint64_t>(*p++ & 0x7f) << shift; shift += 7; }
+            if (p == end || (*p & 0x80)) return false;
+            zig |= static_cast<uint64_t>(*p++) << shift;
+            prev += static_cast<int64_t>((zig >> 1) ^ (0 - (zig & 1)));
+            out[i] = prev;
+        }
+        return true;
+    }
+
+    // Decodes every column once, so a damaged file is turned away at load
+    // rather than read out of bounds by a later query
+    static bool wellFormed(const SealedBlock& b) {
+        Values values;
+        for (int c = 0; c < ORDER_COLUMNS; c++) {
+            if (!decode(b.cols[c], b.rows, values)) return false;
+        }
+        int64_t lines = 0;
+        for (int64_t n : values) { // COL_LINE_COUNT, the last column
+            if (n < 0) return false;
+            lines += n;
+        }
+        if (static_cast<uint64_t>(lines) != b.lineRows) return false;
+        for (int c = 0; c < LINE_COLUMNS; c++) {
+            if (!decode(b.lines[c], b.lineRows, values)) return false;
+        }
+        return true;
+    }
+
+    static shared_ptr<SealedBlock> newSealedBlock() {
+        return allocate_shared<SealedBlock>(TaggedAllocator<SealedBlock, MEM_COMPLETED_ORDERS>());
+    }
+
+    static shared_ptr<const SealedBlock> seal(const Block& b) {
+        shared_ptr<SealedBlock> s = newSealedBlock();
+        s->id = secureRandom64();
+        s->rows = b.rows;
+        s->lineRows = b.lineRows;
+        if (b.rows) {
+            s->minCreated = *min_element(b.cols[COL_CREATED].begin(), b.cols[COL_CREATED].end());
+            s->maxCreated = *max_element(b.cols[COL_CREATED].begin(), b.cols[COL_CREATED].end());
+        }
+        for (int c = 0; c < ORDER_COLUMNS; c++) encode(b.cols[c], s->cols[c]);
+        for (int c = 0; c < LINE_COLUMNS; c++) encode(b.lines[c], s->lines[c]);
+        return s;
+    }
+
+    // Hands each block, with only the requested columns decoded, to fn(worker, block)
+    void forEachBlock(unsigned columnMask, bool withLines, const function<void(unsigned, const Block&)>& fn, unsigned threadCount) const {
+        vector<shared_ptr<const SealedBlock>> blocks;
+        Block tail; // a copy of the rows still filling up, only the columns asked for
+        {
+            lock_guard<mutex> guard(lock);
+            blocks = sealed;
+            tail.rows = open.rows;
+            tail.lineRows = open.lineRows;
+            for (int c = 0; c < ORDER_COLUMNS; c++) {
+                if (columnMask & (1u << c)) tail.cols[c] = open.cols[c];
+            }
+            if (withLines) for (int c = 0; c < LINE_COLUMNS; c++) tail.lines[c] = open.lines[c];
+        }
+        atomic<size_t> next(0);
+        auto work = [&](unsigned worker) {
+            Block decoded;
+            for (size_t i = next++; i < blocks.size(); i = next++) {
+                const SealedBlock& s = *blocks[i];
+                decoded.rows = s.rows;
+                decoded.lineRows = s.lineRows;
+                for (int c = 0; c < ORDER_COLUMNS; c++) {
+                    if (columnMask & (1u << c)) decode(s.cols[c], s.rows, decoded.cols[c]);
+                }
+                if (withLines) for (int c = 0; c < LINE_COLUMNS; c++) decode(s.lines[c], s.lineRows, decoded.lines[c]);
+                fn(worker, decoded);
+            }
+        };
+        vector<thread> workers;
+        for (unsigned t = 1; t < threadCount; t++) workers.emplace_back(work, t);
+        work(0);
+        for (thread& w : workers) w.join();
+        if (tail.rows) fn(0, tail);
+    }
+
+    static unsigned workerCount(unsigned requested) {
+        return requested ? requested : max(1u, thread::hardware_concurrency());
+    }
+
+public:
+    void append(const Order& o) {
+        long long values[ORDER_COLUMNS] = {
+            o.getTrace().at[STAGE_CREATED], o.getTrace().at[STAGE_DELIVERED],
+            IDGenerator::numericPart(o.getRestaurantId()), IDGenerator::numericPart(o.getPartnerId()),
+            IDGenerator::numericPart(o.getCustomerId()),
+            o.getSubtotal().getCents(), o.getDiscount().getCents(), o.getTip().getCents(),
+            o.getOfferSlot(), static_cast<long long>(o.getDishes().size())
+        };
+
+        lock_guard<mutex> guard(lock);
+        for (int c = 0; c < ORDER_COLUMNS; c++) open.cols[c].push_back(values[c]);
+        for (const auto& pair : o.getDishes()) {
+            open.lines[LINE_DISH].push_back(pair.first.getRatingHandle());
+            open.lines[LINE_QTY].push_back(pair.second);
+        }
+        open.rows++;
+        open.lineRows += o.getDishes().size();
+        if (open.rows == BLOCK_ROWS) {
+            sealed.push_back(seal(open));
+            open = Block();
+        }
+    }
+
+    size_t size() const {
+        lock_guard<mutex> guard(lock);
+        size_t rows = open.rows;
+        for (const auto& b : sealed) rows += b->rows;
+        return rows;
+    }
+
+    size_t compressedBytes() const {
+        lock_guard<mutex> guard(lock);
+        size_t bytes = 0;
+        for (const auto& b : sealed) {
+            for (const auto& c : b->cols) bytes += c.size();
+            for (const auto& c : b->lines) bytes += c.size();
+        }
+        return bytes;
+    }
+
+    // (restaurant, hour since epoch) -> food revenue (subtotal - discount) for orders created in [from, to)
+    map<pair<long long, long long>, Money> revenuePerRestaurantHour(long long fromMicros, long long toMicros, unsigned threads = 0) const {
+        threads = workerCount(threads);
+        vector<unordered_map<uint64_t, long long>> partial(threads);
+        unsigned mask = (1u << COL_CREATED) | (1u << COL_RESTAURANT) | (1u << COL_SUBTOTAL) | (1u << COL_DISCOUNT);
+
+        forEachBlock(mask, false, [&](unsigned worker, const Block& b) {
+            const int64_t* created = b.cols[COL_CREATED].data();
+            const int64_t* subtotal = b.cols[COL_SUBTOTAL].data();
+            const int64_t* discount = b.cols[COL_DISCOUNT].data();
+            vector<int64_t> revenue(b.rows);
+            for (size_t i = 0; i < b.rows; i++) { // branch-free filter, vectorizes
+                int64_t inRange = (created[i] >= fromMicros) & (created[i] < toMicros);
+                revenue[i] = (subtotal[i] - discount[i]) * inRange;
+            }
+            auto& groups = partial[worker];
+            for (size_t i = 0; i < b.rows; i++) {
+                if (!revenue[i]) continue;
+                uint64_t key = (static_cast<uint64_t>(b.cols[COL_RESTAURANT][i]) << 32) | static_cast<uint64_t>(created[i] / MICROS_PER_HOUR);
+                groups[key] += revenue[i];
+            }
+        }, threads);
+
+        map<pair<long long, long long>, Money> out;
+        for (const auto& groups : partial) {
+            for (const auto& g : groups) {
+                out[{static_cast<long long>(g.first >> 32), static_cast<long long>(g.first & 0xffffffffULL)}] += Money::fromCents(g.second);
+            }
+        }
+        return out;
+    }
+
+    // offer tracker slot -> total discount given
+    map<int, Money> discountCostPerOffer(unsigned threads = 0) const {
+        threads = workerCount(threads);
+        vector<vector<long long>> partial(threads);
+        unsigned mask = (1u << COL_OFFER) | (1u << COL_DISCOUNT);
+
+        forEachBlock(mask, false, [&](unsigned worker, const Block& b) {
+            auto& cost = partial[worker];
+            const int64_t* offer = b.cols[COL_OFFER].data();
+            const int64_t* discount = b.cols[COL_DISCOUNT].data();
+            for (size_t i = 0; i < b.rows; i++) {
+                if (offer[i] < 0) continue;
+                if (static_cast<size_t>(offer[i]) >= cost.size()) cost.resize(offer[i] + 1, 0);
+                cost[offer[i]] += discount[i];
+            }
+        }, threads);
+
+        map<int, Money> out;
+        for (const auto& cost : partial) {
+            for (size_t slot = 0; slot < cost.size(); slot++) {
+                if (cost[slot]) out[static_cast<int>(slot)] += Money::fromCents(cost[slot]);
+            }
+        }
+        return out;
+    }
+
+    // partner -> tip histogram; orders without a partner are skipped
+    map<long long, TipStats> tipDistributionPerPartner(unsigned threads = 0) const {
+        static const long long BOUNDS[TipStats::BUCKETS - 1] = {1, 200, 500, 1000, 2000};
+        threads = workerCount(threads);
+        vector<unordered_map<long long, TipStats>> partial(threads);
+        unsigned mask = (1u << COL_PARTNER) | (1u << COL_TIP);
+
+        forEachBlock(mask, false, [&](unsigned worker, const Block& b) {
+            const int64_t* partner = b.cols[COL_PARTNER].data();
+            const int64_t* tip = b.cols[COL_TIP].data();
+            for (size_t i = 0; i < b.rows; i++) {
+                if (!partner[i]) continue;
+                int bucket = 0;
+                for (long long bound : BOUNDS) bucket += tip[i] >= bound;
+                TipStats& stats = partial[worker][partner[i]];
+                stats.counts[bucket]++;
+                stats.orders++;
+                stats.total += Money::fromCents(tip[i]);
+            }
+        }, threads);
+
+        map<long long, TipStats> out;
+        for (const auto& groups : partial) {
+            for (const auto& g : groups) {
+                TipStats& stats = out[g.first];
+                for (int k = 0; k < TipStats::BUCKETS; k++) stats.counts[k] += g.second.counts[k];
+                stats.orders += g.second.orders;
+                stats.total += g.second.total;
+            }
+        }
+        return out;
+    }
+
+    // Customer and line-item columns, in the shape the Recommender rebuilds from
+    OrderHistoryBatch exportHistory() const {
+        OrderHistoryBatch history;
+        unsigned mask = (1u << COL_CUSTOMER) | (1u << COL_LINE_COUNT);
+        forEachBlock(mask, true, [&](unsigned, const Block& b) {
+            size_t line = 0;
+            for (size_t i = 0; i < b.rows; i++) {
+                history.customers.push_back(b.cols[COL_CUSTOMER][i]);
+                for (int64_t n = 0; n < b.cols[COL_LINE_COUNT][i]; n++, line++) {
+                    if (b.lines[LINE_DISH][line] < 0) continue; // no longer on any menu
+                    history.dishes.push_back(static_cast<uint32_t>(b.lines[LINE_DISH][line]));
+                    history.quantities.push_back(static_cast<int>(b.lines[LINE_QTY][line]));
+                }
+                history.offsets.push_back(history.dishes.size());
+            }
+        }, 1); // one worker keeps the batch in archive order
+        return history;
+    }
+
+    // Dishes are written as (restaurant, name) and offers as promo codes, in
+    // tables ahead of the blocks; the columns hold indexes into them
+    bool saveTo(const string& path, const ArchiveCatalog& catalog) {
+        lock_guard<mutex> guard(lock);
+        if (open.rows) {
+            sealed.push_back(seal(open));
+            open = Block();
+        }
+        ofstream file(path, ios::binary | ios::trunc);
+        if (!file) return false;
+
+        vector<pair<string, string>> dishNames;
+        vector<string> offerCodes;
+        unordered_map<int64_t, int64_t> dishIndex, offerIndex;
+        vector<shared_ptr<const SealedBlock>> named;
+        for (const auto& b : sealed) {
+            Values dishes, offers;
+            decode(b->lines[LINE_DISH], b->lineRows, dishes);
+            decode(b->cols[COL_OFFER], b->rows, offers);
+            for (int64_t& d : dishes) {
+                if (d < 0) continue;
+                auto it = dishIndex.find(d);
+                if (it == dishIndex.end()) {
+                    pair<string, string> name; // stays empty for a dish since removed
+                    catalog.dishName(static_cast<uint32_t>(d), name.first, name.second);
+                    it = dishIndex.emplace(d, static_cast<int64_t>(dishNames.size())).first;
+                    dishNames.push_back(name);
+                }
+                d = it->second;
+            }
+            for (int64_t& o : offers) {
+                if (o < 0) continue;
+                auto it = offerIndex.find(o);
+                if (it == offerIndex.end()) {
+                    it = offerIndex.emplace(o, static_cast<int64_t>(offerCodes.size())).first;
+                    offerCodes.push_back(catalog.offerCode(static_cast<int>(o)));
+                }
+                o = it->second;
+            }
+            shared_ptr<SealedBlock> copy = newSealedBlock();
+            *copy = *b;
+            copy->lines[LINE_DISH].clear();
+            copy->cols[COL_OFFER].clear();
+            encode(dishes, copy->lines[LINE_DISH]);
+            encode(offers, copy->cols[COL_OFFER]);
+            named.push_back(copy);
+        }
+
+        auto put = [&file](uint64_t v) { file.write(reinterpret_cast<const char*>(&v), sizeof(v)); };
+        auto putBytes = [&](const Packed& bytes) {
+            put(bytes.size());
+            file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+        };
+        auto putText = [&](const string& text) {
+            put(text.size());
+            file.write(text.data(), text.size());
+        };
+        file.write("FMARC3\0\0", 8);
+        put(dishNames.size());
+        for (const auto& d : dishNames) { putText(d.first); putText(d.second); }
+        put(offerCodes.size());
+        for (const string& code : offerCodes) putText(code);
+        put(named.size());
+        for (const auto& b : named) {
+            put(b->id); put(b->rows); put(b->lineRows);
+            put(static_cast<uint64_t>(b->minCreated)); put(static_cast<uint64_t>(b->maxCreated));
+            for (const auto& c : b->cols) putBytes(c);
+            for (const auto& c : b->lines) putBytes(c);
+        }
+        return static_cast<bool>(file);
+    }
+
+    // Appends the blocks stored in path that aren't archived already; false
+    // if it is missing or malformed. Dishes and offers that no longer exist
+    // are kept as -1.
+    bool loadFrom(const string& path, ArchiveCatalog& catalog) {
+        ifstream file(path, ios::binary | ios::ate);
+        if (!file) return false;
+        uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+        file.seekg(0);
+        char magic[8];
+        if (!file.read(magic, 8) || string(magic, 6) != "FMARC3") return false;
+
+        auto left = [&]() { return fileSize - static_cast<uint64_t>(file.tellg()); };
+        auto get = [&file]() { uint64_t v = 0; file.read(reinterpret_cast<char*>(&v), sizeof(v)); return v; };
+        auto getBytes = [&](Packed& bytes) {
+            uint64_t n = get();
+            if (!file || n > left()) { file.setstate(ios::failbit); return; } // a length past the end of the file
+            bytes.resize(n);
+            file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+        };
+        auto getText = [&](string& text) {
+            uint64_t n = get();
+            if (!file || n > left()) { file.setstate(ios::failbit); return; }
+            text.resize(n);
+            file.read(&text[0], n);
+        };
+
+        // Table index -> this run's handle or slot
+        vector<int64_t> dishes, offers;
+        uint64_t count = get();
+        if (!file || count > left() / 16) return false; // each entry takes two lengths
+        for (uint64_t i = 0; i < count && file; i++) {
+            string restaurantId, name;
+            getText(restaurantId);
+            getText(name);
+            dishes.push_back(catalog.dishHandle(restaurantId, name));
+        }
+        count = get();
+        if (!file || count > left() / 8) return false;
+        for (uint64_t i = 0; i < count && file; i++) {
+            string code;
+            getText(code);
+            offers.push_back(catalog.offerSlot(code));
+        }
+        // An index outside its table is as corrupt as a bad varint
+        auto remap = [](Packed& bytes, size_t n, const vector<int64_t>& table) {
+            Values values;
+            decode(bytes, n, values);
+            for (int64_t& v : values) {
+                if (v < 0) continue;
+                if (static_cast<uint64_t>(v) >= table.size()) return false;
+                v = table[v];
+            }
+            bytes.clear();
+            encode(values, bytes);
+            return true;
+        };
+
+        vector<shared_ptr<const SealedBlock>> loaded;
+        count = get();
+        for (uint64_t i = 0; i < count && file; i++) {
+            shared_ptr<SealedBlock> b = newSealedBlock();
+            b->id = get(); b->rows = get(); b->lineRows = get();
+            b->minCreated = static_cast<long long>(get()); b->maxCreated = static_cast<long long>(get());
+            for (auto& c : b->cols) getBytes(c);
+            for (auto& c : b->lines) getBytes(c);
+            if (!file || !wellFormed(*b)) return false;
+            if (!remap(b->lines[LINE_DISH], b->lineRows, dishes) || !remap(b->cols[COL_OFFER], b->rows, offers)) return false;
+            loaded.push_back(b);
+        }
+        if (!file) return false;
+
+        lock_guard<mutex> guard(lock);
+        unordered_set<uint64_t> present;
+        for (const auto& b : sealed) present.insert(b->id);
+        for (const auto& b : loaded) {
+            if (present.insert(b->id).second) sealed.push_back(b);
+        }
+        return true;
+    }
+};
+
+// --- ORDER TRACES ---
+// -------------------------------------------------------------
+// Traces of the most recent finished orders, kept in a fixed ring so memory
+// stays flat however long the app runs. Records are plain numbers (IDs by
+// their numeric part, like the archive) so a full ring is about 4 MB.
+struct TraceRecord {
+    uint32_t order = 0;
+    uint32_t restaurant = 0;
+    uint32_t partner = 0;
+    OrderTrace trace;
+};
+
+struct StageStats {
+    size_t samples = 0;
+    long long p50 = 0, p90 = 0, p99 = 0, max = 0; // micros
+};
+
+enum TraceGroup { GROUP_BY_RESTAURANT, GROUP_BY_PARTNER };
+
+class TraceLog {
+private:
+    static const size_t CAPACITY = 1 << 16;
+
+    mutable mutex lock;
+    vector<TraceRecord, TaggedAllocator<TraceRecord, MEM_COMPLETED_ORDERS>> ring;
+    size_t next = 0;
+    size_t total = 0;
+
+    vector<TraceRecord> snapshot() const {
+        lock_guard<mutex> guard(lock);
+        return vector<TraceRecord>(ring.begin(), ring.end());
+    }
+
+    static long long pick(vector<long long>& v, double q) {
+        size_t k = min(v.size() - 1, static_cast<size_t>(q * v.size()));
+        nth_element(v.begin(), v.begin() + k, v.end());
+        return v[k];
+    }
+
+public:
+    TraceLog() { ring.reserve(CAPACITY); }
+
+    void record(const Order& o) {
+        TraceRecord r;
+        r.order = static_cast<uint32_t>(IDGenerator::numericPart(o.getId()));
+        r.restaurant = static_cast<uint32_t>(IDGenerator::numericPart(o.getRestaurantId()));
+        r.partner = static_cast<uint32_t>(IDGenerator::numericPart(o.getPartnerId()));
+        r.trace = o.getTrace();
+
+        lock_guard<mutex> guard(lock);
+        if (ring.size() < CAPACITY) ring.push_back(r);
+        else ring[next] = r;
+        next = (next + 1) % CAPACITY;
+        total++;
+    }
+
+    size_t size() const {
+        lock_guard<mutex> guard(lock);
+        return ring.size();
+    }
+
+    // Span percentiles per restaurant or per partner. Orders that never
+    // reached both ends of a span are left out of that span only.
+    map<uint32_t, vector<StageStats>> stageReport(TraceGroup group) const {
+        vector<TraceRecord> records = snapshot();
+        map<uint32_t, vector<vector<long long>>> samples;
+        for (const TraceRecord& r : records) {
+            uint32_t key = group == GROUP_BY_RESTAURANT ? r.restaurant : r.partner;
+            if (!key) continue; // orders nobody was assigned to have no partner
+            vector<vector<long long>>& spans = samples[key];
+            spans.resize(STAGE_COUNT - 1);
+            for (int s = 0; s < STAGE_COUNT - 1; s++) {
+                long long d = r.trace.spanMicros(s);
+                if (d >= 0) spans[s].push_back(d);
+            }
+        }
+
+        map<uint32_t, vector<StageStats>> report;
+        for (auto& entry : samples) {
+            vector<StageStats>& out = report[entry.first];
+            out.resize(STAGE_COUNT - 1);
+            for (int s = 0; s < STAGE_COUNT - 1; s++) {
+                vector<long long>& v = entry.second[s];
+                if (v.empty()) continue;
+                out[s].samples = v.size();
+                out[s].max = *max_element(v.begin(), v.end());
+                out[s].p50 = pick(v, 0.50);
+                out[s].p90 = pick(v, 0.90);
+                out[s].p99 = pick(v, 0.99);
+            }
+        }
+        return report;
+    }
+
+    // Chrome trace-event JSON (chrome://tracing, Perfetto). Each restaurant is
+    // a process and each order a thread holding one span per stage, nested
+    // under a span for the whole order.
+    bool exportChromeTrace(const string& path) const {
+        vector<TraceRecord> records = snapshot();
+        ofstream out(path, ios::trunc);
+        if (!out) return false;
+
+        out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+        bool first = true;
+        auto event = [&](const char* name, const TraceRecord& r, long long start, long long dur) {
+            out << (first ? "\n" : ",\n")
+                << "{\"name\":\"" << name << "\",\"cat\":\"order\",\"ph\":\"X\",\"ts\":" << start << ",\"dur\":" << dur
+                << ",\"pid\":" << r.restaurant << ",\"tid\":" << r.order
+                << ",\"args\":{\"order\":\"O" << r.order << "\",\"partner\":\"U" << r.partner << "\"}}";
+            first = false;
+        };
+
+        map<uint32_t, bool> named;
+        for (const TraceRecord& r : records) {
+            if (!named[r.restaurant]) {
+                out << (first ? "\n" : ",\n") << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":" << r.restaurant
+                    << ",\"args\":{\"name\":\"R" << r.restaurant << "\"}}";
+                first = false;
+                named[r.restaurant] = true;
+            }
+            long long last = 0;
+            for (int s = 0; s < STAGE_COUNT; s++) last = max(last, r.trace.at[s]);
+            event("order", r, r.trace.at[STAGE_CREATED], last - r.trace.at[STAGE_CREATED]);
+            for (int s = 0; s < STAGE_COUNT - 1; s++) {
+                long long d = r.trace.spanMicros(s);
+                if (d >= 0) event(SPAN_NAMES[s], r, r.trace.at[s], d);
+            }
+        }
+        out << "\n]}\n";
+        return static_cast<bool>(out);
+    }
+};
+
+// --- DASHBOARDS ---
+// -------------------------------------------------------------
+// Rolling one-hour total in one-minute buckets. Adding and reading only
+// expire the buckets that went stale since the last call, so both are O(1)
+// amortized and never look at history.
+class SlidingHour {
+private:
+    static const int BUCKETS = 60;
+    static const long long MICROS_PER_MINUTE = 60LL * 1000000LL;
+    long long buckets[BUCKETS] = {};
+    long long minuteOf[BUCKETS] = {};
+    long long total = 0;
+
+    void expire(long long minute) {
+        for (int i = 0; i < BUCKETS; i++) {
+            if (buckets[i] && minuteOf[i] <= minute - BUCKETS) {
+                total -= buckets[i];
+                buckets[i] = 0;
+            }
+        }
+    }
+
+public:
+    void add(long long nowMicros, long long value) {
+        long long minute = nowMicros / MICROS_PER_MINUTE;
+        int slot = static_cast<int>(minute % BUCKETS);
+        if (minuteOf[slot] != minute) {
+            total -= buckets[slot];
+            buckets[slot] = 0;
+            minuteOf[slot] = minute;
+        }
+        buckets[slot] += value;
+        total += value;
+    }
+
+    long long sum(long long nowMicros) {
+        expire(nowMicros / MICROS_PER_MINUTE);
+        return total;
+    }
+};
+
+struct RestaurantDashboard {
+    long long ordersLastHour = 0;
+    long long ordersToday = 0;
+    Money revenueToday;
+    double avgPrepMinutes = 0.0;
+    double rating = 0.0;
+    TopList topDishes; // (dish rating handle, quantity)
+};
+
+struct PartnerDashboard {
+    Money earningsLastHour;
+    Money earningsTotal;
+    long long offered = 0;
+    long long accepted = 0;
+    long long completed = 0;
+    double avgDeliveryMinutes = 0.0;
+    double rating = 0.0;
+};
+
+// Counters owners and partners watch, updated on every order event so a
+// dashboard read is a constant-time copy.
+class DashboardService {
+private:
+    static const long long MICROS_PER_DAY = 86400LL * 1000000LL;
+
+    struct RestaurantStats {
+        SlidingHour orders;
+        long long day = -1;
+        long long ordersToday = 0;
+        Money revenueToday;
+        long long prepMicros = 0, prepCount = 0;
+        TopCounts dishes;
+    };
+    struct PartnerStats {
+        SlidingHour earnings;
+        Money earningsTotal;
+        long long offered = 0, accepted = 0, completed = 0;
+        long long deliveryMicros = 0, deliveryCount = 0;
+    };
+
+    mutex lock;
+    unordered_map<string, RestaurantStats> restaurants;
+    unordered_map<string, PartnerStats> partners;
+
+    RestaurantStats& today(const string& restaurantId, long long now) {
+        RestaurantStats& r = restaurants[restaurantId];
+        if (r.day != now / MICROS_PER_DAY) {
+            r.day = now / MICROS_PER_DAY;
+            r.ordersToday = 0;
+            r.revenueToday = Money();
+        }
+        return r;
+    }
+
+public:
+    void onOrderPlaced(const Order& o) {
+        long long now = Clock::nowMicros();
+        lock_guard<mutex> guard(lock);
+        RestaurantStats& r = today(o.getRestaurantId(), now);
+        r.orders.add(now, 1);
+        r.ordersToday++;
+        r.revenueToday += o.getSubtotal() - o.getDiscount();
+        for (const auto& pair : o.getDishes()) r.dishes.bump(pair.first.getRatingHandle(), pair.second);
+    }
+
+    void onPartnerOffered(const string& partnerId, bool accepted) {
+        lock_guard<mutex> guard(lock);
+        PartnerStats& p = partners[partnerId];
+        p.offered++;
+        if (accepted) p.accepted++;
+    }
+
+    void onStatusChanged(const Order& o, const string& newStatus) {
+        lock_guard<mutex> guard(lock);
+        const OrderTrace& t = o.getTrace();
+        if (newStatus == STATUS_OUT_FOR_DELIVERY && t.has(STAGE_PREPARING)) {
+            RestaurantStats& r = restaurants[o.getRestaurantId()];
+            r.prepMicros += t.spanMicros(STAGE_PREPARING);
+            r.prepCount++;
+        } else if (newStatus == STATUS_DELIVERED && t.has(STAGE_PICKED_UP) && !o.getPartnerId().empty()) {
+            PartnerStats& p = partners[o.getPartnerId()];
+            p.deliveryMicros += t.spanMicros(STAGE_PICKED_UP);
+            p.deliveryCount++;
+        }
+    }
+
+    void onDeliveryRated(const string& partnerId, Money earnings) {
+        long long now = Clock::nowMicros();
+        lock_guard<mutex> guard(lock);
+        PartnerStats& p = partners[partnerId];
+        p.earnings.add(now, earnings.getCents());
+        p.earningsTotal += earnings;
+        p.completed++;
+    }
+
+    RestaurantDashboard forRestaurant(const Restaurant& rest) {
+        long long now = Clock::nowMicros();
+        lock_guard<mutex> guard(lock);
+        RestaurantStats& r = today(rest.getId(), now);
+        RestaurantDashboard d;
+        d.ordersLastHour = r.orders.sum(now);
+        d.ordersToday = r.ordersToday;
+        d.revenueToday = r.revenueToday;
+        d.avgPrepMinutes = r.prepCount ? r.prepMicros / 60e6 / r.prepCount : 0.0;
+        d.rating = rest.getRating();
+        d.topDishes = r.dishes.top();
+        return d;
+    }
+
+    PartnerDashboard forPartner(const DeliveryPartner& partner) {
+        long long now = Clock::nowMicros();
+        lock_guard<mutex> guard(lock);
+        PartnerStats& p = partners[partner.getId()];
+        PartnerDashboard d;
+        d.earningsLastHour = Money::fromCents(p.earnings.sum(now));
+        d.earningsTotal = p.earningsTotal;
+        d.offered = p.offered;
+        d.accepted = p.accepted;
+        d.completed = p.completed;
+        d.avgDeliveryMinutes = p.deliveryCount ? p.deliveryMicros / 60e6 / p.deliveryCount : 0.0;
+        d.rating = partner.getRating();
+        return d;
+    }
+};
+
+// --- ZONES & SURGE ---
+// -------------------------------------------------------------
+// Delivery zones are the GeoPoint grid cells. Each zone keeps live
+// counts of open orders and free partners, bumped as orders are placed and
+// finished. A ticker turns those counts into a smoothed surge multiplier per
+// zone; a tick walks the zones only and never looks at an order.
+class SurgePricing {
+public:
+    static const int ZONE_COUNT = GeoPoint::GRID * GeoPoint::GRID;
+    static const uint32_t BASE_MILLI = 1000;
+    static const uint32_t MAX_MILLI = 2500;
+
+private:
+    struct Zone {
+        atomic<int> openOrders{0};
+        atomic<int> freePartners{0};
+        atomic<uint32_t> multiplierMilli{BASE_MILLI};
+    };
+
+    Zone zones[ZONE_COUNT];
+    double smoothing; // share of the gap to the target closed per tick
+    atomic<bool> stopping;
+    thread ticker;
+
+public:
+    explicit SurgePricing(int tickMs = TIMER_INTERVAL_MS[TIMER_SURGE_TICK], double alpha = 0.3) : smoothing(alpha), stopping(false) {
+        if (RunContext::instance().isDeterministic()) return;
+        ticker = thread([this, tickMs]() {
+            while (!stopping.load(memory_order_relaxed)) {
+                this_thread::sleep_for(chrono::milliseconds(tickMs));
+                tick();
+            }
+        });
+    }
+
+    ~SurgePricing() {
+        stopping.store(true, memory_order_relaxed);
+        if (ticker.joinable()) ticker.join();
+    }
+
+    static int zoneFor(const string& address) { return GeoPoint::locate(address).zone(); }
+
+    void orderOpened(int zone) { zones[zone].openOrders.fetch_add(1, memory_order_relaxed); }
+    void orderClosed(int zone) { zones[zone].openOrders.fetch_sub(1, memory_order_relaxed); }
+    void partnerFree(int zone) { zones[zone].freePartners.fetch_add(1, memory_order_relaxed); }
+    void partnerBusy(int zone) { zones[zone].freePartners.fetch_sub(1, memory_order_relaxed); }
+
+    // Target is demand over supply (both +1 so an idle zone sits at 1x),
+    // clamped to [1x, MAX]; the published value eases toward it
+    void tick() {
+        for (Zone& z : zones) {
+            double open = max(0, z.openOrders.load(memory_order_relaxed));
+            double free = max(0, z.freePartners.load(memory_order_relaxed));
+            double target = min<double>(MAX_MILLI, max<double>(BASE_MILLI, BASE_MILLI * (open + 1) / (free + 1)));
+            double current = z.multiplierMilli.load(memory_order_relaxed);
+            z.multiplierMilli.store(static_cast<uint32_t>(lround(current + smoothing * (target - current))), memory_order_relaxed);
+        }
+    }
+
+    uint32_t multiplierMilli(int zone) const { return zones[zone].multiplierMilli.load(memory_order_relaxed); }
+    int openOrders(int zone) const { return zones[zone].openOrders.load(memory_order_relaxed); }
+    int freePartners(int zone) const { return zones[zone].freePartners.load(memory_order_relaxed); }
+};
+
+// --- ROUTING & ETA ---
+// -------------------------------------------------------------
+struct RouteQuote {
+    int branch = -1;     // -1 when no branch can take the order
+    int prepMinutes = 0;
+    int etaMinutes = 0;  // checkout to doorstep
+};
+
+// Door-to-door estimate: a partner rides to the branch while the food cooks,
+// then rides to the customer. Ride time is road distance times a per-zone
+// minutes-per-km learned from finished deliveries. Everything is arithmetic
+// on a few numbers per branch, so scoring every branch costs well under a
+// microsecond each.
+class EtaModel {
+private:
+    static constexpr double ROAD_FACTOR = 1.3;      // roads vs straight line
+    static constexpr double HANDOFF_MINUTES = 2.0;  // parking, pickup, handover
+    static constexpr double NO_PARTNER_MINUTES = 15.0;
+    static constexpr double LEARN_RATE = 0.2;
+    static const uint32_t DEFAULT_MILLI_PER_KM = 3000; // ~20 km/h by bike
+
+    atomic<uint32_t> milliPerKm[SurgePricing::ZONE_COUNT];
+
+public:
+    EtaModel() {
+        for (auto& m : milliPerKm) m.store(DEFAULT_MILLI_PER_KM, memory_order_relaxed);
+    }
+
+    double legMinutes(const GeoPoint& from, const GeoPoint& to) const {
+        double km = from.distanceTo(to) * ROAD_FACTOR;
+        return km * milliPerKm[to.zone()].load(memory_order_relaxed) / 1000.0 + HANDOFF_MINUTES;
+    }
+
+    // Ride from the closest zone that has a free partner
+    double partnerMinutes(const SurgePricing& surge, const GeoPoint& branch) const {
+        double best = NO_PARTNER_MINUTES;
+        for (int z = 0; z < SurgePricing::ZONE_COUNT; z++) {
+            if (surge.freePartners(z) > 0) best = min(best, legMinutes(GeoPoint::zoneCentre(z), branch));
+        }
+        return best;
+    }
+
+    static double predict(int prepMinutes, double partnerMinutes, double deliveryMinutes) {
+        return max<double>(prepMinutes, partnerMinutes) + deliveryMinutes;
+    }
+
+    // Learns from a finished pickup-to-door leg. Legs under 30s are
+    // simulation runs or scan mistakes and would drag the estimate to zero.
+    void observeLeg(const GeoPoint& from, const GeoPoint& to, long long micros) {
+        double km = from.distanceTo(to) * ROAD_FACTOR;
+        if (micros < 30LL * 1000000 || km < 0.2) return;
+        double minutes = micros / 60e6 - HANDOFF_MINUTES;
+        if (minutes <= 0) return;
+        atomic<uint32_t>& cell = milliPerKm[to.zone()];
+        double current = cell.load(memory_order_relaxed);
+        cell.store(static_cast<uint32_t>(lround(current + LEARN_RATE * (minutes * 1000.0 / km - current))), memory_order_relaxed);
+    }
+};
+
+// --- SCHEDULED ORDERS ---
+// -------------------------------------------------------------
+// Pre-orders book a 15-minute delivery slot up to a week ahead. Each
+// restaurant and each delivery zone has a calendar: a ring with a counter per
+// slot for the next 7 days, plus a bitmap with a bit set for every slot at
+// capacity. Finding open slots ORs the two bitmaps a word at a time, so a
+// week (672 slots) is eleven words and a counter check per candidate.
+// Restaurants book cook-minutes against what their open kitchens turn out in
+// a slot; zones book drops against their share of the partner fleet.
+class SlotCalendar : public Tracked<MEM_ACTIVE_ORDERS> {
+public:
+    static const int SLOT_MINUTES = 15;
+    static const long long SLOT_MICROS = SLOT_MINUTES * 60LL * 1000000LL;
+    static const int HORIZON = 7 * 24 * 60 / SLOT_MINUTES;
+    static const int WORDS = (HORIZON + 63) / 64;
+
+private:
+    int64_t firstSlot = 0; // oldest slot still in the ring
+    int capacity = 0;
+    uint16_t booked[HORIZON] = {};
+    uint64_t full[WORDS] = {}; // ring positions past HORIZON stay set
+
+    void mark(int pos) {
+        bool isFull = booked[pos] > 0 && booked[pos] >= capacity;
+        if (isFull) full[pos / 64] |= 1ULL << (pos % 64);
+        else full[pos / 64] &= ~(1ULL << (pos % 64));
+    }
+
+public:
+    SlotCalendar() {
+        for (int pos = HORIZON; pos < WORDS * 64; pos++) full[pos / 64] |= 1ULL << (pos % 64);
+    }
+
+    // Forgets slots that have gone by, so their ring positions come round fresh
+    void roll(int64_t nowSlot) {
+        if (nowSlot - firstSlot >= HORIZON) firstSlot = nowSlot - HORIZON;
+        for (; firstSlot < nowSlot; firstSlot++) {
+            int pos = static_cast<int>(firstSlot % HORIZON);
+            booked[pos] = 0;
+            mark(pos);
+        }
+    }
+
+    // Capacity follows supply; the bitmap is only redone when it moves
+    void sync(int cap) {
+        if (cap == capacity) return;
+        capacity = cap;
+        for (int pos = 0; pos < HORIZON; pos++) mark(pos);
+    }
+
+    bool inWindow(int64_t slot) const { return slot >= firstSlot && slot < firstSlot + HORIZON; }
+
+    // An empty slot takes any one order, however large
+    bool fits(int64_t slot, int units) const {
+        int b = booked[slot % HORIZON];
+        return b == 0 || b + units <= capacity;
+    }
+
+    void book(int64_t slot, int units) {
+        int pos = static_cast<int>(slot % HORIZON);
+        booked[pos] = static_cast<uint16_t>(min(65535, booked[pos] + units));
+        mark(pos);
+    }
+
+    void unbook(int64_t slot, int units) {
+        if (!inWindow(slot)) return;
+        int pos = static_cast<int>(slot % HORIZON);
+        booked[pos] = static_cast<uint16_t>(max(0, booked[pos] - units));
+        mark(pos);
+    }
+
+    // Calls fn(slot) for each slot in [from, to) open in both calendars,
+    // until fn returns false. Whole words of full slots are skipped at once.
+    template <class Fn>
+    static void forEachOpen(const SlotCalendar& a, const SlotCalendar& b, int64_t from, int64_t to, Fn fn) {
+        int64_t slot = from;
+        while (slot < to) {
+            int pos = static_cast<int>(slot % HORIZON);
+            uint64_t open = ~(a.full[pos / 64] | b.full[pos / 64]) >> (pos % 64);
+            if (!open) {
+                slot += min(64 - pos % 64, HORIZON - pos);
+                continue;
+            }
+            slot += __builtin_ctzll(open);
+            if (slot >= to || !fn(slot)) return;
+            slot++;
+        }
+    }
+};
+
+class PreorderBook {
+public:
+    static const int MIN_LEAD_MINUTES = 45;      // the earliest slot is this far out
+    static const int PREORDER_PERCENT = 60;      // of kitchen and fleet; the rest is for orders placed now
+    static const int RELEASE_BUFFER_MINUTES = 10; // on top of the quoted door-to-door time
+    static const int PARTNER_SLOTS_PER_DROP = 2;
+    static const int RETRY_SECONDS = 60;         // before a release the kitchen turned away is tried again
+
+    enum Phase { PHASE_RELEASE, PHASE_DUE };
+    struct Task {
+        long long at;
+        uint64_t seq; // keeps tasks due at the same time in booking order
+        Phase phase;
+        int64_t slot;
+        Order* order;
+    };
+
+private:
+    struct Later {
+        bool operator()(const Task& a, const Task& b) const { return a.at != b.at ? a.at > b.at : a.seq > b.seq; }
+    };
+
+    unordered_map<const Restaurant*, unique_ptr<SlotCalendar>> kitchens;
+    SlotCalendar zones[SurgePricing::ZONE_COUNT];
+    priority_queue<Task, vector<Task>, Later> timeline;
+    unordered_set<Order*> booked; // paid for but not yet released; owned here until then
+    uint64_t nextSeq = 0;
+
+    SlotCalendar& kitchen(const Restaurant* r, int capacity, int64_t nowSlot) {
+        unique_ptr<SlotCalendar>& cal = kitchens[r];
+        if (!cal) cal.reset(new SlotCalendar());
+        cal->roll(nowSlot);
+        cal->sync(capacity);
+        return *cal;
+    }
+
+    SlotCalendar& zone(int z, int capacity, int64_t nowSlot) {
+        zones[z].roll(nowSlot);
+        zones[z].sync(capacity);
+        return zones[z];
+    }
+
+public:
+    ~PreorderBook() {
+        for (Order* o : booked) delete o;
+    }
+
+    static int64_t slotAt(long long micros) { return micros / SlotCalendar::SLOT_MICROS; }
+    static long long slotStart(int64_t slot) { return slot * SlotCalendar::SLOT_MICROS; }
+    static int64_t earliestSlot(long long now) {
+        return slotAt(now + MIN_LEAD_MINUTES * 60LL * 1000000LL + SlotCalendar::SLOT_MICROS - 1);
+    }
+
+    // "Sat 12:30", in local time
+    static string describe(int64_t slot) {
+        time_t seconds = static_cast<time_t>(slotStart(slot) / 1000000);
+        tm local;
+        localtime_r(&seconds, &local);
+        char text[16];
+        strftime(text, sizeof(text), "%a %H:%M", &local);
+        return text;
+    }
+
+    // "12:30" is the next 12:30 that can still be booked; "Sat 12:30" is
+    // that day's. -1 if the text names no bookable slot.
+    static int64_t parseTime(const string& text, long long now) {
+        string day, clock = text;
+        size_t space = text.find(' ');
+        if (space != string::npos) {
+            day = text.substr(0, space);
+            clock = text.substr(space + 1);
+        }
+        int hour, minute;
+        char extra;
+        if (sscanf(clock.c_str(), "%d:%d%c", &hour, &minute, &extra) != 2 || hour < 0 || hour > 23 || minute < 0 || minute > 59) return -1;
+        char wanted[16];
+        snprintf(wanted, sizeof(wanted), "%02d:%02d", hour, minute);
+        int64_t first = earliestSlot(now);
+        for (int64_t slot = first; slot < slotAt(now) + SlotCalendar::HORIZON; slot++) {
+            string label = describe(slot);
+            if (label.compare(4, 5, wanted) != 0) continue;
+            bool sameDay = day.size() >= 3;
+            for (size_t i = 0; i < 3 && sameDay; i++) sameDay = tolower(label[i]) == tolower(day[i]);
+            if (day.empty() || sameDay) return slot;
+        }
+        return -1;
+    }
+
+    // Up to `limit` bookable slots from the earliest on, for an order of `work` cook-minutes
+    vector<int64_t> openSlots(const Restaurant* r, int z, int kitchenCap, int zoneCap, int work, size_t limit, long long now) {
+        int64_t nowSlot = slotAt(now);
+        SlotCalendar& k = kitchen(r, kitchenCap, nowSlot);
+        SlotCalendar& d = zone(z, zoneCap, nowSlot);
+        vector<int64_t> open;
+        SlotCalendar::forEachOpen(k, d, earliestSlot(now), nowSlot + SlotCalendar::HORIZON, [&](int64_t slot) {
+            if (k.fits(slot, work)) open.push_back(slot);
+            return open.size() < limit;
+        });
+        return open;
+    }
+
+    // Takes room in both calendars while the customer pays
+    bool hold(const Restaurant* r, int z, int kitchenCap, int zoneCap, int64_t slot, int work, long long now) {
+        int64_t nowSlot = slotAt(now);
+        SlotCalendar& k = kitchen(r, kitchenCap, nowSlot);
+        SlotCalendar& d = zone(z, zoneCap, nowSlot);
+        if (slot < earliestSlot(now) || !k.inWindow(slot) || !k.fits(slot, work) || !d.fits(slot, 1)) return false;
+        k.book(slot, work);
+        d.book(slot, 1);
+        return true;
+    }
+
+    void release(const Restaurant* r, int z, int64_t slot, int work) {
+        auto it = kitchens.find(r);
+        if (it != kitchens.end()) it->second->unbook(slot, work);
+        zones[z].unbook(slot, 1);
+    }
+
+    // Takes the paid order; it is released to the kitchen leadMinutes before its slot
+    void schedule(Order* order, int64_t slot, int leadMinutes, long long now) {
+        booked.insert(order);
+        long long at = max(now, slotStart(slot) - leadMinutes * 60LL * 1000000LL);
+        timeline.push({at, nextSeq++, PHASE_RELEASE, slot, order});
+    }
+
+    // Pops the next task due by `now`. A release must be answered with
+    // released() or retry().
+    bool nextDue(long long now, Task& task) {
+        if (timeline.empty() || timeline.top().at > now) return false;
+        task = timeline.top();
+        timeline.pop();
+        return true;
+    }
+
+    // The kitchen took the order: it leaves the book and its delivery at the
+    // slot goes on the timeline
+    void released(const Task& task, long long now) {
+        booked.erase(task.order);
+        timeline.push({max(now, slotStart(task.slot)), nextSeq++, PHASE_DUE, task.slot, task.order});
+    }
+
+    // The kitchen turned it away; it stays booked and is released again later
+    void retry(const Task& task, long long now) {
+        timeline.push({now + RETRY_SECONDS * 1000000LL, nextSeq++, PHASE_RELEASE, task.slot, task.order});
+    }
+
+    // It can't be made; the caller takes the order back
+    void drop(const Task& task) { booked.erase(task.order); }
+
+    size_t pending() const { return booked.size(); }
+};
+
+// --- ORDER EVENT STREAM ---
+// -------------------------------------------------------------
+// Order events go out through a ring in shared memory ("/dev/shm/foodmate-orders"
+// by default). There is one writer, the process that owns the orders, and any
+// number of local readers, each going at its own pace. Every slot is one cache
+// line holding a fixed-layout event and its sequence number. The writer never
+// waits on anyone: it overwrites the oldest slot, and a reader that falls a
+// whole ring behind sees the jump in sequence numbers and counts the gap.
+// Readers work on the mapped slot in place and then check that its sequence
+// number didn't change while they read it.
+enum OrderEventType : uint8_t { ORDER_PLACED = 1, ORDER_ASSIGNED, ORDER_STATUS_CHANGED, ORDER_RATED };
+const char* const ORDER_EVENT_NAMES[] = {"", "placed", "assigned", "status", "rated"};
+const string* const ORDER_STATUSES[] = {&STATUS_PENDING, &STATUS_PREPARING, &STATUS_OUT_FOR_DELIVERY, &STATUS_DELIVERED,
+                                        &STATUS_CANCELLED};
+const uint8_t ORDER_STATUS_COUNT = 5;
+
+// IDs travel as their numeric part; the letter is implied by the field
+struct OrderEvent {
+    int64_t atMicros;
+    int64_t amountCents; // the order's total at the time of the event
+    uint64_t orderNo;
+    uint32_t customerNo;
+    uint32_t restaurantNo;
+    uint32_t partnerNo;  // 0 until a partner is assigned
+    uint8_t type;        // OrderEventType
+    uint8_t status;      // index into ORDER_STATUSES
+    uint8_t foodStars;   // ratings are only set on ORDER_RATED
+    uint8_t deliveryStars;
+};
+
+class OrderEventStream {
+public:
+    static const uint32_t CAPACITY = 1 << 14; // 1 MB of slots
+    static const uint64_t MAGIC = 0x3156454f4d46ULL; // "FMOEV1"
+
+    struct alignas(64) Slot {
+        atomic<uint64_t> seq; // 0 while the writer is filling it
+        OrderEvent event;
+    };
+    struct Header {
+        atomic<uint64_t> magic; // set last, once the ring is ready
+        uint32_t capacity;
+        int64_t generation;     // writer start time; changes when it restarts
+        alignas(64) atomic<uint64_t> published; // sequence of the newest event
+    };
+    static const size_t MAPPED_BYTES = sizeof(Header) + sizeof(Slot) * CAPACITY;
+
+private:
+    Header* header = nullptr;
+    Slot* slots = nullptr;
+    uint64_t next = 0;
+
+    OrderEventStream() {}
+
+public:
+    static OrderEventStream& instance() {
+        static OrderEventStream stream;
+        return stream;
+    }
+
+    ~OrderEventStream() {
+#ifdef __linux__
+        if (header) munmap(header, MAPPED_BYTES);
+#endif
+    }
+
+    static uint8_t statusCode(const string& status) {
+        for (uint8_t i = 0; i < ORDER_STATUS_COUNT; i++) {
+            if (*ORDER_STATUSES[i] == status) return i;
+        }
+        return 0;
+    }
+
+    // The segment is reused across restarts so attached readers stay mapped;
+    // they notice the new generation and start over.
+    bool create(const string& name) {
+#ifdef __linux__
+        int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+        if (fd < 0) return false;
+        void* mem = MAP_FAILED;
+        if (ftruncate(fd, MAPPED_BYTES) == 0) mem = mmap(nullptr, MAPPED_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (mem == MAP_FAILED) return false;
+
+        header = static_cast<Header*>(mem);
+        slots = reinterpret_cast<Slot*>(static_cast<char*>(mem) + sizeof(Header));
+        header->magic.store(0, memory_order_release);
+        for (uint32_t i = 0; i < CAPACITY; i++) slots[i].seq.store(0, memory_order_relaxed);
+        header->capacity = CAPACITY;
+        header->generation = Clock::nowMicros();
+        header->published.store(0, memory_order_relaxed);
+        next = 0;
+        header->magic.store(MAGIC, memory_order_release);
+        return true;
+#else
+        (void)name;
+        return false;
+#endif
+    }
+
+    bool isOpen() const { return header != nullptr; }
+    uint64_t getPublished() const { return next; }
+
+    // Called from the ordering path only, which is a single thread. No locks,
+    // no system calls: a few stores into an already mapped cache line.
+    void publish(OrderEventType type, const Order& order, int foodStars = 0, int deliveryStars = 0) {
+        if (!header) return;
+        uint64_t seq = ++next;
+        Slot& slot = slots[seq & (CAPACITY - 1)];
+        slot.seq.store(0, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        OrderEvent& e = slot.event;
+        e.atMicros = Clock::nowMicros();
+        e.amountCents = order.getFinalAmount().getCents();
+        e.orderNo = static_cast<uint64_t>(IDGenerator::numericPart(order.getId()));
+        e.customerNo = static_cast<uint32_t>(IDGenerator::numericPart(order.getCustomerId()));
+        e.restaurantNo = static_cast<uint32_t>(IDGenerator::numericPart(order.getRestaurantId()));
+        e.partnerNo = static_cast<uint32_t>(IDGenerator::numericPart(order.getPartnerId()));
+        e.type = type;
+        e.status = statusCode(order.getStatus());
+        e.foodStars = static_cast<uint8_t>(foodStars);
+        e.deliveryStars = static_cast<uint8_t>(deliveryStars);
+
+        slot.seq.store(seq, memory_order_release);
+        header->published.store(seq, memory_order_release);
+    }
+};
+
+#ifdef __linux__
+enum ReadResult { READ_EMPTY, READ_EVENT, READ_GAP, READ_RESTARTED };
+
+class OrderEventReader {
+private:
+    const OrderEventStream::Header* header = nullptr;
+    const OrderEventStream::Slot* slots = nullptr;
+    int64_t generation = 0;
+    uint64_t expected = 1; // sequence of the next event to read
+    uint64_t missed = 0;
+    const OrderEventStream::Slot* current = nullptr;
+
+    // Jumps back in, half a ring behind the writer, so the next lap isn't immediate
+    void skipAhead(uint64_t newest) {
+        uint64_t resume = newest + 1 > OrderEventStream::CAPACITY / 2 ? newest + 1 - OrderEventStream::CAPACITY / 2 : 1;
+        resume = max(resume, expected + 1);
+        missed += resume - expected;
+        expected = resume;
+    }
+
+public:
+    ~OrderEventReader() {
+        if (header) munmap(const_cast<OrderEventStream::Header*>(header), OrderEventStream::MAPPED_BYTES);
+    }
+
+    // From the oldest event still in the ring, or only events after now
+    bool attach(const string& name, bool fromOldest) {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) return false;
+        struct stat info;
+        void* mem = MAP_FAILED;
+        if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= OrderEventStream::MAPPED_BYTES) {
+            mem = mmap(nullptr, OrderEventStream::MAPPED_BYTES, PROT_READ, MAP_SHARED, fd, 0);
+        }
+        close(fd);
+        if (mem == MAP_FAILED) return false;
+        header = static_cast<const OrderEventStream::Header*>(mem);
+        slots = reinterpret_cast<const OrderEventStream::Slot*>(static_cast<const char*>(mem) + sizeof(OrderEventStream::Header));
+        if (header->magic.load(memory_order_acquire) != OrderEventStream::MAGIC || header->capacity != OrderEventStream::CAPACITY) {
+            return false;
+        }
+        generation = header->generation;
+        uint64_t newest = header->published.load(memory_order_acquire);
+        if (!fromOldest) expected = newest + 1;
+        else expected = newest >= OrderEventStream::CAPACITY ? newest - OrderEventStream::CAPACITY + 1 : 1;
+        return true;
+    }
+
+    // On READ_EVENT `view` points into the ring; call done() when finished
+    // with it to learn whether the writer overwrote it meanwhile.
+    ReadResult next(const OrderEvent*& view, uint64_t& seq) {
+        view = nullptr;
+        if (header->generation != generation || header->magic.load(memory_order_acquire) != OrderEventStream::MAGIC) {
+            if (header->magic.load(memory_order_acquire) != OrderEventStream::MAGIC) return READ_EMPTY; // mid-restart
+            generation = header->generation;
+            expected = 1;
+            return READ_RESTARTED;
+        }
+        uint64_t newest = header->published.load(memory_order_acquire);
+        if (newest < expected) return READ_EMPTY;
+
+        const OrderEventStream::Slot& slot = slots[expected & (OrderEventStream::CAPACITY - 1)];
+        if (slot.seq.load(memory_order_acquire) != expected) {
+            skipAhead(newest); // overwritten by a later lap, or being overwritten now
+            return READ_GAP;
+        }
+        current = &slot;
+        view = &slot.event;
+        seq = expected;
+        return READ_EVENT;
+    }
+
+    bool done() {
+        atomic_thread_fence(memory_order_acquire);
+        bool intact = current->seq.load(memory_order_relaxed) == expected;
+        if (intact) expected++;
+        else skipAhead(header->published.load(memory_order_acquire));
+        current = nullptr;
+        return intact;
+    }
+
+    uint64_t getMissed() const { return missed; }
+    uint64_t getNewest() const { return header->published.load(memory_order_acquire); }
+};
+#endif
+
+// --- SYSTEM MANAGER (GLOBAL DATA AND LOGIC) ---
+// -------------------------------------------------------------
+using UserList = vector<User*, TaggedAllocator<User*, MEM_USERS>>;
+using RestaurantList = vector<Restaurant*, TaggedAllocator<Restaurant*, MEM_CATALOG>>;
+
+class SystemManager : public CatalogListener, public ArchiveCatalog {
+private:
+    MemoryAudit audit{"SystemManager"}; // first in, last out: checks nothing outlived the rest
+    UserList allUsers;
+    unordered_map<long long, User*, hash<long long>, equal_to<long long>,
+                  TaggedAllocator<pair<const long long, User*>, MEM_USERS>> usersById; // numeric part of the user ID -> user
+    TokenTable tokens;
+    RestaurantList allRestaurants;
+    vector<Order*, TaggedAllocator<Order*, MEM_ACTIVE_ORDERS>> activeOrders;
+    OrderArchive orderArchive;
+    TraceLog traces;
+    DashboardService dashboards;
+    OfferList availableOffers;
+    RedemptionTracker redemptions;
+    PaymentGateway paymentGateway;
+    RankingIndex rankings; // declared before ratings: the flusher's last publish lands here
+    SearchIndex search;
+    Recommender recommender;
+    shared_mutex dishOwnersLock; // written on menu edits, read by the rating flusher
+    unordered_map<uint32_t, Restaurant*> dishOwners; // dish rating handle -> restaurant
+    RatingAggregator ratings;
+    SurgePricing surge;
+    FeeSchedule fees;
+    EtaModel eta;
+    PreorderBook preorders;
+    int partnerCount = 0;
+    Notification notifier;
+
+    void seedData() 
+    {
+        addUser(new Customer("Alice", "pass", "101 Maple St"));
+        addUser(new RestaurantOwner("ChefBob", "pass"));
+        addUser(new DeliveryPartner("Dan", "pass", "Bike"));
+        
+        // Updated to use string constants in constructors
+        Restaurant* r1 = new Restaurant("Spice Garden", CUISINE_INDIAN, "spice@mail.com");
+        r1->getMenu().addDish({"Paneer Butter Masala", 12.50, DISH_VEG, CUISINE_INDIAN, COURSE_DINNER, 20});
+        r1->getMenu().addDish({"Veg Biryani", 10.00, DISH_VEG, CUISINE_INDIAN, COURSE_LUNCH, 25});
+        r1->getMenu().addDish({"Chicken Tikka", 15.00, DISH_NON_VEG, CUISINE_INDIAN, COURSE_DINNER, 20});
+        r1->addBranch("Riverside Branch", GeoPoint::locate("Riverside"));
+        
+        Restaurant* r2 = new Restaurant("Pizza Hub", CUISINE_ITALIAN, "pizza@mail.com");
+        r2->getMenu().addDish({"Margherita Pizza", 18.00, DISH_VEG, CUISINE_ITALIAN, COURSE_DINNER, 12});
+        r2->getMenu().addDish({"Pepperoni Pizza", 20.00, DISH_NON_VEG, CUISINE_ITALIAN, COURSE_DINNER, 12});
+
+        addRestaurant(r1);
+        addRestaurant(r2);
+
+        dynamic_cast<RestaurantOwner*>(allUsers[1])->addRestaurant(r1);
+        dynamic_cast<RestaurantOwner*>(allUsers[1])->addRestaurant(r2);
+
+        addOffer({"FIRST30", 30.0, false, 50, 1});
+        addOffer({"LOYALTY50", 50.0, true, 20, 3});
+    }
+
+public:
+    SystemManager() {
+        fees.deliveryFee = Money::fromDollars(2.99);
+        ratings.setPublishListener([this](uint32_t handle, uint32_t milliStars, uint32_t) {
+            rankings.onRatingPublished(handle, milliStars);
+            search.onRatingPublished(handle, milliStars);
+            shared_lock<shared_mutex> guard(dishOwnersLock);
+            auto it = dishOwners.find(handle);
+            if (it != dishOwners.end()) it->second->getMenu().noteRerated(handle);
+        });
+        seedData();
+        cout << "FoodMate System Initialized." << endl;
+    }
+
+    ~SystemManager() {
+        {
+            unique_lock<shared_mutex> guard(dishOwnersLock);
+            dishOwners.clear(); // the rating flusher outlives the restaurants below
+        }
+        for (User* u : allUsers) delete u;
+        for (Restaurant* r : allRestaurants) delete r;
+        for (Order* o : activeOrders) delete o;      // Deletes any incomplete orders
+    }
+
+    // User IDs are "U" + a unique number, so the number alone keys the index
+    User* findUser(const string& id) {
+        if (id.size() > 18) return nullptr;
+        auto it = usersById.find(IDGenerator::numericPart(id));
+        return (it != usersById.end() && it->second->getId() == id) ? it->second : nullptr;
+    }
+
+    // One hash lookup, a role byte and a salted digest; nothing scans or casts
+    AuthResult authenticate(const string& id, const string& pass, UserRole role, User*& user, AuthToken& token) {
+        User* u = findUser(id);
+        if (!u || !u->checkPassword(pass)) return AUTH_BAD_CREDENTIALS;
+        if (u->getRole() != role) return AUTH_WRONG_ROLE;
+        user = u;
+        token = tokens.issue(u);
+        return AUTH_OK;
+    }
+
+    TokenTable& getTokens() { return tokens; }
+
+   Restaurant* findRestaurant(const string& id) {
+    for (Restaurant* r : allRestaurants) {
+        if (r->getId() == id) {
+            return r;
+        }
+    }
+    return nullptr;
+}
+    
+    // getter functions ,Public Accessors
+    const RestaurantList& getRestaurants() const { return allRestaurants; }
+    const OfferList& getOffers() const { return availableOffers; }
+    const UserList& getUsers() const { return allUsers; }
+    
+    // User Management
+    void addUser(User* u) {
+        allUsers.push_back(u);
+        usersById[IDGenerator::numericPart(u->getId())] = u;
+        // New partners start spread across zones until their first drop-off
+        if (DeliveryPartner* dp = dynamic_cast<DeliveryPartner*>(u)) {
+            dp->moveTo(SurgePricing::zoneFor(dp->getId()));
+            surge.partnerFree(dp->getZone());
+            partnerCount++;
+        }
+    }
+
+    // Quotes carts against the live offers and fees
+    vector<Quote> quoteCarts(const QuoteBatch& batch, unsigned threads = 0) const {
+        return QuoteEngine(availableOffers, fees).quoteBatch(batch, threads);
+    }
+
+    uint32_t surgeAt(const string& address) const { return surge.multiplierMilli(SurgePricing::zoneFor(address)); }
+
+    // Prices delivery from the surge in the order's zone at checkout time
+    void applyDeliveryFee(Order* order) {
+        uint32_t milli = surge.multiplierMilli(SurgePricing::zoneFor(order->getAddress()));
+        order->setDeliveryFee(fees.deliveryFeeAt(milli), milli);
+    }
+
+    // The partner waits for the next job where they dropped this one off
+    void releasePartner(DeliveryPartner* partner, const Order& order, Money earnings) {
+        partner->completeDelivery(earnings);
+        partner->moveTo(SurgePricing::zoneFor(order.getAddress()));
+        surge.partnerFree(partner->getZone());
+    }
+
+    // A customer who leaves before rating still frees their partner and closes the order
+    void closeUnrated(Order* order) {
+        if (DeliveryPartner* partner = dynamic_cast<DeliveryPartner*>(findUser(order->getPartnerId()))) {
+            releasePartner(partner, *order, order->getTip());
+        }
+        finalizeOrder(order->getId());
+    }
+
+    void addRestaurant(Restaurant* r) {
+         allRestaurants.push_back(r);
+         rankings.addRestaurant(r);
+         search.addRestaurant(*r);
+         r->getMenu().attach(this, r);
+         for (const Dish& d : r->getMenu().getAllDishes()) {
+             onDishAdded(*r, d);
+         }
+    }
+
+    void onDishAdded(const Restaurant& r, const Dish& d) override {
+        rankings.addDish(r, d);
+        search.addDish(r, d);
+        unique_lock<shared_mutex> guard(dishOwnersLock);
+        dishOwners[d.getRatingHandle()] = findRestaurant(r.getId());
+    }
+
+    void onDishRemoved(const Restaurant&, const Dish& d) override {
+        rankings.removeDish(d);
+        search.removeDish(d);
+        unique_lock<shared_mutex> guard(dishOwnersLock);
+        dishOwners.erase(d.getRatingHandle());
+    }
+
+    const RankingIndex& getRankings() const { return rankings; }
+    const SearchIndex& getSearch() const { return search; }
+
+    // Dishes most often ordered together with anything in the cart, cart items excluded
+    vector<RankedDish> recommendForCart(const Cart& cart, size_t limit) const {
+        map<uint32_t, uint32_t> votes;
+        for (const auto& pair : cart.getItems()) {
+            for (const auto& entry : recommender.alsoOrdered(pair.first.getRatingHandle())) votes[entry.first] += entry.second;
+        }
+        for (const auto& pair : cart.getItems()) votes.erase(pair.first.getRatingHandle());
+
+        vector<pair<uint32_t, uint32_t>> ranked;
+        for (const auto& v : votes) ranked.push_back({v.second, v.first});
+        sort(ranked.begin(), ranked.end(), greater<pair<uint32_t, uint32_t>>());
+
+        vector<RankedDish> out;
+        for (const auto& entry : ranked) {
+            RankedDish d;
+            if (out.size() < limit && rankings.describeDish(entry.second, d)) out.push_back(d);
+        }
+        return out;
+    }
+
+    vector<RankedDish> usualsFor(const Customer* c, size_t limit) const {
+        vector<RankedDish> out;
+        for (const auto& entry : recommender.usualsFor(IDGenerator::numericPart(c->getId()))) {
+            RankedDish d;
+            if (out.size() < limit && rankings.describeDish(entry.first, d)) out.push_back(d);
+        }
+        return out;
+    }
+
+    void rebuildRecommendations() {
+        recommender.rebuild(orderArchive.exportHistory());
+    }
+
+    const OrderArchive& getArchive() const { return orderArchive; }
+    DashboardService& getDashboards() { return dashboards; }
+    OrderArchive& getArchive() { return orderArchive; }
+    TraceLog& getTraces() { return traces; }
+
+    static const char* const METRICS_FILE;
+
+    // Prometheus text exposition format, written whole to a temp file and
+    // renamed so a scraper never reads a half-written snapshot
+    bool exportMetrics() const {
+        MetricsSnapshot snap = Metrics::instance().snapshot();
+        string tmp = string(METRICS_FILE) + ".tmp";
+        {
+            ofstream out(tmp, ios::trunc);
+            if (!out) return false;
+            out << "# TYPE foodmate_uptime_seconds gauge\nfoodmate_uptime_seconds " << snap.uptimeSeconds << "\n";
+            for (int c = 0; c < COUNTER_COUNT; c++) {
+                out << "# TYPE foodmate_" << COUNTER_NAMES[c] << "_total counter\n"
+                    << "foodmate_" << COUNTER_NAMES[c] << "_total " << snap.counters[c] << "\n";
+            }
+            out << "# TYPE foodmate_latency_seconds summary\n";
+            for (int h = 0; h < HISTOGRAM_COUNT; h++) {
+                const HistogramSummary& hs = snap.histograms[h];
+                const char* name = HISTOGRAM_NAMES[h];
+                out << "foodmate_latency_seconds{op=\"" << name << "\",quantile=\"0.5\"} " << hs.p50Nanos / 1e9 << "\n"
+                    << "foodmate_latency_seconds{op=\"" << name << "\",quantile=\"0.99\"} " << hs.p99Nanos / 1e9 << "\n"
+                    << "foodmate_latency_seconds{op=\"" << name << "\",quantile=\"0.999\"} " << hs.p999Nanos / 1e9 << "\n"
+                    << "foodmate_latency_seconds_sum{op=\"" << name << "\"} " << hs.meanNanos * hs.count / 1e9 << "\n"
+                    << "foodmate_latency_seconds_count{op=\"" << name << "\"} " << hs.count << "\n";
+            }
+            out << "# TYPE foodmate_memory_live_bytes gauge\n";
+            for (int t = 0; t < MEM_TAG_COUNT; t++) {
+                MemoryUsage u = MemoryLedger::instance().usage(static_cast<MemoryTag>(t));
+                out << "foodmate_memory_live_bytes{subsystem=\"" << MEMORY_TAG_NAMES[t] << "\"} " << u.liveBytes << "\n"
+                    << "foodmate_memory_peak_bytes{subsystem=\"" << MEMORY_TAG_NAMES[t] << "\"} " << u.peakBytes << "\n"
+                    << "foodmate_memory_allocations_total{subsystem=\"" << MEMORY_TAG_NAMES[t] << "\"} " << u.allocations << "\n";
+            }
+            if (!out) return false;
+        }
+        return rename(tmp.c_str(), METRICS_FILE) == 0;
+    }
+
+    // Offer tracker slots back to promo codes, for reports
+    string offerCodeForSlot(int slot) const {
+        for (const Offer& o : availableOffers) {
+            if (o.getTrackerSlot() == slot) return o.getCode();
+        }
+        return "#" + to_string(slot);
+    }
+
+    bool dishName(uint32_t handle, string& restaurantId, string& name) const override {
+        RankedDish d;
+        if (!rankings.describeDish(handle, d)) return false;
+        restaurantId = d.restaurantId;
+        name = d.name;
+        return true;
+    }
+
+    int64_t dishHandle(const string& restaurantId, const string& name) override {
+        Restaurant* r = findRestaurant(restaurantId);
+        if (!r) return -1;
+        for (const Dish& d : r->getMenu().getAllDishes()) {
+            if (d.getName() == name) return d.getRatingHandle();
+        }
+        return -1;
+    }
+
+    string offerCode(int slot) const override { return offerCodeForSlot(slot); }
+
+    int offerSlot(const string& code) const override {
+        for (const Offer& o : availableOffers) {
+            if (o.getCode() == code) return o.getTrackerSlot();
+        }
+        return -1;
+    }
+
+    // Offer Management
+    void addOffer(Offer offer) {
+         offer.setTrackerSlot(redemptions.registerOffer(offer));
+         availableOffers.push_back(offer);
+    }
+
+    bool redeemOffer(const Customer* c, const Offer& offer) {
+        RedeemResult result = redemptions.tryRedeem(c->getId(), offer.getTrackerSlot());
+        if (result == REDEEM_CUSTOMER_LIMIT) {
+            cout << "    [Offer Failed] You have already used " << offer.getCode() << " the maximum number of times." << endl;
+        } else if (result == REDEEM_GLOBAL_LIMIT) {
+            cout << "    [Offer Failed] " << offer.getCode() << " is fully redeemed." << endl;
+        }
+        return result == REDEEM_OK;
+    }
+
+    void releaseOffer(const Customer* c, const Offer& offer) {
+        redemptions.release(c->getId(), offer.getTrackerSlot());
+    }
+
+    // Payments are keyed by order, so resubmitting the same order can't charge twice
+    shared_future<PaymentResult> submitPayment(const Order* order, const Payment& method, PaymentCallback onDone = nullptr) {
+        return method.processPayment(paymentGateway, "PAY-" + order->getId(), order->getFinalAmount(), onDone);
+    }
+
+    PaymentResult abandonPayment(const Order* order) { return paymentGateway.abandon("PAY-" + order->getId()); }
+
+    void submitRating(uint32_t handle, int stars) {
+        ratings.submit({handle, stars, Clock::nowMicros()});
+    }
+
+    void flushRatings() { ratings.flush(); }
+
+    void fireTimer(TimerId timer) {
+        if (timer == TIMER_SURGE_TICK) surge.tick();
+        else if (timer == TIMER_RATING_FLUSH) ratings.flush();
+        else if (timer == TIMER_PREORDER_RELEASE) releasePreorders();
+    }
+
+    // A replay answers card and UPI payments from the trace instead of the gateway
+    void setManualPayments(bool on) { paymentGateway.setManual(on); }
+    bool settlePayment(const string& key, const PaymentResult& result) { return paymentGateway.settle(key, result); }
+
+    // Order Management
+    void placeOrder(Order* order) {
+    ScopedTimer timer(HIST_PLACE_ORDER);
+    Metrics::instance().count(CTR_ORDERS_PLACED);
+    // Add the order to the active orders list
+    activeOrders.push_back(order);
+    OrderEventStream::instance().publish(ORDER_PLACED, *order);
+    surge.orderOpened(SurgePricing::zoneFor(order->getAddress()));
+    if (Restaurant* r = findRestaurant(order->getRestaurantId())) {
+        rankings.recordOrder(*r, order->getDishes());
+    }
+    dashboards.onOrderPlaced(*order);
+
+    // Notify customer that order is received
+    notifier.sendNotification(order->getCustomerId(),"Order " + order->getId() + " received! Status: " + order->getStatus()
+    );
+
+    DeliveryPartner* partner = nullptr;
+
+    // Find an available delivery partner
+    for (User* u : allUsers) 
+    {
+        DeliveryPartner* dp = dynamic_cast<DeliveryPartner*>(u);
+        if (dp && dp->isCurrentlyAvailable()) {
+            partner = dp;
+            break;
+        }
+    }
+
+    // Assign partner if found
+    if (partner) 
+    {
+        order->assignPartner(partner->getId());
+        OrderEventStream::instance().publish(ORDER_ASSIGNED, *order);
+        partner->startDelivery();
+        surge.partnerBusy(partner->getZone());
+        dashboards.onPartnerOffered(partner->getId(), true); // partners auto-accept for now
+
+        notifier.sendNotification(
+            order->getCustomerId(),
+            "Partner " + partner->getName() + " assigned!"
+        );
+    }
+    else 
+    {
+        Metrics::instance().count(CTR_PARTNER_NOT_FOUND);
+    }
+}
+
+    Branch* branchFor(const Order& order) {
+        Restaurant* r = findRestaurant(order.getRestaurantId());
+        if (!r || order.getBranch() >= static_cast<int>(r->branchCount())) return nullptr;
+        return &r->getBranch(order.getBranch());
+    }
+
+    // Picks the open branch that can cook every dish and gets the food to
+    // the door soonest, and pins the order to it. Branches that have paused
+    // new orders are skipped, unless it is a pre-order: that cooks at its lead
+    // time, so neither the current wait nor today's stock applies to it.
+    RouteQuote routeOrder(Order* order, bool preorder = false) {
+        ScopedTimer timer(HIST_ROUTE_ORDER);
+        RouteQuote best;
+        Restaurant* r = findRestaurant(order->getRestaurantId());
+        if (!r) return best;
+
+        GeoPoint home = GeoPoint::locate(order->getAddress());
+        double bestEta = 0;
+        for (size_t i = 0; i < r->branchCount(); i++) {
+            Branch& b = r->getBranch(i);
+            Kitchen& k = b.getKitchen();
+            if (!b.isOpen() || !b.canServe(order->getDishes(), !preorder)) continue;
+            if (!preorder && k.waitMinutes() >= k.getDeferWait()) continue;
+
+            int prep = preorder ? Kitchen::longestDish(order->getDishes()) : k.quoteMinutes(order->getDishes());
+            double total = EtaModel::predict(prep, eta.partnerMinutes(surge, b.getLocation()), eta.legMinutes(b.getLocation(), home));
+            if (best.branch < 0 || total < bestEta) {
+                best.branch = static_cast<int>(i);
+                best.prepMinutes = prep;
+                best.etaMinutes = static_cast<int>(ceil(total));
+                bestEta = total;
+            }
+        }
+        if (best.branch >= 0) order->setBranch(best.branch);
+        return best;
+    }
+
+    // Reserves kitchen time at the order's branch at checkout
+    Admission admitToKitchen(Order* order, bool acceptLongWait) {
+        Branch* b = branchFor(*order);
+        if (!b) return ADMIT_DEFERRED;
+        int work = Kitchen::workFor(order->getDishes());
+        Admission result = b->getKitchen().admit(work, acceptLongWait);
+        if (result == ADMIT_OK) order->setKitchenMinutes(work);
+        return result;
+    }
+
+    // Takes every unit the order needs at its branch, or none of them
+    bool reserveStock(Order* order) {
+        Restaurant* r = findRestaurant(order->getRestaurantId());
+        Branch* b = branchFor(*order);
+        if (!r || !b) return false;
+        StockBoard& board = StockBoard::instance();
+        vector<pair<const Dish*, int>> taken;
+        for (const auto& pair : order->getDishes()) {
+            if (!board.reserve(pair.first.getStockHandle(), b->getIndex(), pair.second)) {
+                for (const auto& t : taken) board.release(t.first->getStockHandle(), b->getIndex(), t.second);
+                return false;
+            }
+            taken.push_back({&pair.first, pair.second});
+            if (board.available(pair.first.getStockHandle(), b->getIndex()) == 0) r->refreshStock(pair.first);
+        }
+        order->setStockHeld(true);
+        return true;
+    }
+
+    // Safe to call more than once, like releaseKitchen
+    void releaseStock(Order* order) {
+        if (!order->isStockHeld()) return;
+        Restaurant* r = findRestaurant(order->getRestaurantId());
+        Branch* b = branchFor(*order);
+        if (r && b) {
+            for (const auto& pair : order->getDishes()) {
+                StockBoard::instance().release(pair.first.getStockHandle(), b->getIndex(), pair.second);
+                if (pair.first.isSoldOut()) r->refreshStock(pair.first);
+            }
+        }
+        order->setStockHeld(false);
+    }
+
+    // Each open branch turns out SLOT_MINUTES of cooking per cook in a slot;
+    // pre-orders may book their share of that
+    int kitchenSlotCapacity(Restaurant* r) {
+        int cookMinutes = 0;
+        for (size_t i = 0; i < r->branchCount(); i++) {
+            Branch& b = r->getBranch(i);
+            if (b.isOpen()) cookMinutes += b.getKitchen().getSlots() * SlotCalendar::SLOT_MINUTES;
+        }
+        return cookMinutes * PreorderBook::PREORDER_PERCENT / 100;
+    }
+
+    // Partners roam, so each zone gets an even share of the fleet's drops;
+    // never below one, so every zone can book something
+    int zoneSlotCapacity() const {
+        int drops = partnerCount * PreorderBook::PREORDER_PERCENT / 100 / PreorderBook::PARTNER_SLOTS_PER_DROP;
+        return max(1, drops / SurgePricing::ZONE_COUNT);
+    }
+
+    vector<int64_t> openSlots(Restaurant* r, int zone, int work, size_t limit) {
+        return preorders.openSlots(r, zone, kitchenSlotCapacity(r), zoneSlotCapacity(), work, limit, Clock::nowMicros());
+    }
+
+    bool holdSlot(Restaurant* r, int zone, int64_t slot, int work) {
+        return preorders.hold(r, zone, kitchenSlotCapacity(r), zoneSlotCapacity(), slot, work, Clock::nowMicros());
+    }
+
+    void releaseSlot(const Restaurant* r, int zone, int64_t slot, int work) { preorders.release(r, zone, slot, work); }
+
+    // Takes over the paid order; returns how many minutes before its slot it goes to the kitchen
+    int scheduleOrder(Order* order, int64_t slot, int etaMinutes) {
+        int lead = etaMinutes + PreorderBook::RELEASE_BUFFER_MINUTES;
+        preorders.schedule(order, slot, lead, Clock::nowMicros());
+        notifier.sendNotification(order->getCustomerId(), "Order " + order->getId() + " booked for " + PreorderBook::describe(slot) + ".");
+        return lead;
+    }
+
+    // Booked orders go to the kitchen at their lead time and are delivered at
+    // their slot, the way the console simulates delivery for orders placed now
+    void releasePreorders() {
+        PreorderBook::Task task;
+        long long now = Clock::nowMicros();
+        while (preorders.nextDue(now, task)) {
+            Order* order = task.order;
+            if (task.phase == PreorderBook::PHASE_RELEASE) {
+                // The slot set kitchen time aside, but a backlog of orders
+                // placed now can still push the wait past the defer limit
+                if (admitToKitchen(order, true) != ADMIT_OK) {
+                    preorders.retry(task, now);
+                    continue;
+                }
+                // Stock is only taken now. Short stock may be restocked
+                // before the slot; after that the order is called off.
+                if (!reserveStock(order)) {
+                    releaseKitchen(order);
+                    if (now < PreorderBook::slotStart(task.slot)) {
+                        preorders.retry(task, now);
+                    } else {
+                        preorders.drop(task);
+                        notifier.sendNotification(order->getCustomerId(), "Order " + order->getId() + " for " +
+                                                  PreorderBook::describe(task.slot) + " was cancelled: part of it sold out.");
+                        delete order;
+                    }
+                    continue;
+                }
+                preorders.released(task, now);
+                placeOrder(order);
+                updateOrderStatus(order->getId(), STATUS_PREPARING);
+            } else {
+                updateOrderStatus(order->getId(), STATUS_OUT_FOR_DELIVERY);
+                updateOrderStatus(order->getId(), STATUS_DELIVERED);
+                closeUnrated(order);
+            }
+        }
+    }
+
+    size_t scheduledCount() const { return preorders.pending(); }
+
+    // Safe to call more than once; only the first call gives the time back
+    void releaseKitchen(Order* order) {
+        if (!order->getKitchenMinutes()) return;
+        if (Branch* b = branchFor(*order)) b->getKitchen().release(order->getKitchenMinutes());
+        order->setKitchenMinutes(0);
+    }
+
+    void updateOrderStatus(const string& orderId, const string& newStatus) 
+    {
+        ScopedTimer timer(HIST_UPDATE_STATUS);
+        Order* targetOrder = nullptr;
+
+        for (Order* o : activeOrders) {
+            if (o->getId() == orderId) {
+                targetOrder = o;
+                break;
+            }
+        }
+
+        if (targetOrder) 
+        {
+            targetOrder->setStatus(newStatus);
+            OrderEventStream::instance().publish(ORDER_STATUS_CHANGED, *targetOrder);
+            dashboards.onStatusChanged(*targetOrder, newStatus);
+            if (newStatus == STATUS_OUT_FOR_DELIVERY || newStatus == STATUS_CANCELLED) releaseKitchen(targetOrder);
+            if (newStatus == STATUS_CANCELLED) releaseStock(targetOrder);
+            notifier.sendNotification(targetOrder->getCustomerId(), 
+                "Order " + orderId + " status updated to: " + newStatus);
+
+            if (newStatus == STATUS_DELIVERED || newStatus == STATUS_CANCELLED) {
+                surge.orderClosed(SurgePricing::zoneFor(targetOrder->getAddress()));
+            }
+            Branch* branch = branchFor(*targetOrder);
+            if (newStatus == STATUS_DELIVERED && branch) {
+                eta.observeLeg(branch->getLocation(), GeoPoint::locate(targetOrder->getAddress()),
+                               targetOrder->getTrace().spanMicros(STAGE_PICKED_UP));
+            }
+
+            if (newStatus == STATUS_DELIVERED) 
+            {
+                Customer* cust = dynamic_cast<Customer*>(findUser(targetOrder->getCustomerId()));
+                if (cust) {
+                    cust->addOrderToHistory(targetOrder->getId());
+                    cust->addLoyaltyPoints(targetOrder->getFinalAmount().percentBps(500)); // 5% back
+                }
+            }
+        }
+    }
+
+    
+    void finalizeOrder(const string& orderId) 
+    {
+        for (auto it = activeOrders.begin(); it != activeOrders.end(); ++it) {
+            if ((*it)->getId() == orderId) {
+                Order* orderToMove = *it;           // Get the pointer
+                activeOrders.erase(it);             // Remove from active list
+                recommender.ingest(IDGenerator::numericPart(orderToMove->getCustomerId()), orderToMove->getDishes());
+                orderArchive.append(*orderToMove);  // Finished orders live on only as archive rows
+                traces.record(*orderToMove);
+                delete orderToMove;
+                break;                              // Exit loop once done
+            }
+        }
+    }
+
+};
+
+const char* const SystemManager::METRICS_FILE = "foodmate_metrics.prom";
+
+void Rating::apply(Order* order, SystemManager& manager, int foodStars, int deliveryStars, const string& feedback) {
+    ScopedTimer timer(HIST_RATING);
+    Metrics::instance().count(CTR_RATINGS);
+    Restaurant* restaurant = manager.findRestaurant(order->getRestaurantId());
+    if (restaurant) 
+    {
+        manager.submitRating(restaurant->getRatingHandle(), foodStars);
+        
+        // The order's dish copies carry the same rating handles as the menu
+        for (const auto& pair : order->getDishes()) 
+        {
+            manager.submitRating(pair.first.getRatingHandle(), foodStars);
+        }
+    }
+
+    if (!order->getPartnerId().empty()) 
+    {
+        DeliveryPartner* partner = dynamic_cast<DeliveryPartner*>(manager.findUser(order->getPartnerId()));
+        if (partner) {
+            manager.releasePartner(partner, *order, order->getTip());
+            manager.submitRating(partner->getRatingHandle(), deliveryStars);
+            manager.getDashboards().onDeliveryRated(partner->getId(), order->getTip());
+        }
+    }
+
+    cout << "\n Thank you for your feedback! Food Rated: " << foodStars 
+             << ", Delivery Rated: " << deliveryStars << "." << endl;
+    if (!feedback.empty()) {
+        cout << "Your textual feedback: \"" << feedback << "\" has been recorded." << endl;
+    }
+    
+    order->markRated();
+    OrderEventStream::instance().publish(ORDER_RATED, *order, foodStars, deliveryStars);
+    manager.finalizeOrder(order->getId());
+}
+
+
+// --- SESSIONS ---
+// -------------------------------------------------------------
+// Every console flow is a state machine fed one input line at a time, so a
+// single thread can keep thousands of users mid-conversation. A session only
+// remembers where it is and who it is talking to; the cart and order being
+// built live in a Checkout that exists just for that stretch of the flow.
+enum SessionState : uint8_t {
+    S_MAIN_MENU, S_AUTH_CHOICE, S_LOGIN_ID, S_LOGIN_PASSWORD,
+    S_REGISTER_NAME, S_REGISTER_PASSWORD, S_REGISTER_ADDRESS, S_REGISTER_VEHICLE, S_RESUME_TOKEN, S_REPORTS_MENU,
+    S_PICK_RESTAURANT, S_SEARCH_QUERY, S_CUISINE, S_COURSE, S_TYPE, S_ADD_DISH, S_WHEN, S_PICK_SLOT, S_CONFIRM_WAIT,
+    S_PROMO, S_PAYMENT_MODE, S_PAYMENT_PENDING, S_TIP, S_FOOD_RATING, S_DELIVERY_RATING, S_FEEDBACK,
+    S_OWNER_RESTAURANT, S_OWNER_MENU, S_DISH_NAME, S_DISH_PRICE, S_DISH_TYPE, S_DISH_CUISINE,
+    S_DISH_COURSE, S_DISH_PREP, S_KITCHEN_BRANCH, S_KITCHEN_PARALLEL, S_KITCHEN_THROTTLE, S_KITCHEN_DEFER,
+    S_BRANCH_MENU, S_BRANCH_NUMBER, S_BRANCH_DISH, S_BRANCH_STOCK, S_BRANCH_NAME, S_BRANCH_STREET,
+    S_PRICE_DISH, S_PRICE_VALUE, S_CLOSED
+};
+
+struct Checkout {
+    string cuisine = CUISINE_ANY, course = COURSE_ANY, dishType = DISH_BOTH;
+    vector<Dish> dishes;
+    Cart cart;
+    Order* order = nullptr;
+    bool placed = false;
+    const Offer* redeemedOffer = nullptr;
+    RouteQuote route;
+    string paymentMode;
+    shared_future<PaymentResult> payment;
+    int foodRating = 0, deliveryRating = 0;
+    int64_t slot = -1;            // delivery slot of a pre-order, -1 for now
+    bool slotHeld = false;        // room taken in the calendars until paid or dropped
+    int slotZone = 0, slotWork = 0;
+    vector<int64_t> offeredSlots;
+};
+
+// Answers collected across the prompts of one login, sign-up or owner form
+struct Draft {
+    string id, name, pass;
+    string dishType, cuisine, course;
+    double price = 0;
+    int branch = 0, action = 0, parallel = 0, throttle = 0;
+};
+
+class Session {
+private:
+    static const size_t PAGE_SIZE = 5;
+    static const size_t SLOT_CHOICES = 8;
+
+    SystemManager& manager;
+    User* user = nullptr;
+    Restaurant* restaurant = nullptr;
+    unique_ptr<Checkout> checkout;
+    unique_ptr<Draft> draft;
+    AuthToken token;
+    uint16_t page = 0;
+    SessionState state = S_MAIN_MENU;
+    char userType = 0;
+    RankBy rankBy = RANK_BEST_RATED;
+
+    // Token prompts behave like `cin >>`: blank lines are skipped and only the first word counts
+    static bool firstWord(const string& line, string& word) {
+        istringstream in(line);
+        return static_cast<bool>(in >> word);
+    }
+
+    template <class T>
+    static bool parse(const string& word, T& value) {
+        istringstream in(word);
+        return static_cast<bool>(in >> value);
+    }
+
+    // Like parse, but only if nothing else follows the value
+    template <class T>
+    static bool parseWhole(const string& text, T& value) {
+        istringstream in(text);
+        return static_cast<bool>(in >> value) && (in >> ws).eof();
+    }
+
+    bool wantsWholeLine() const {
+        return state == S_SEARCH_QUERY || state == S_ADD_DISH || state == S_PICK_SLOT || state == S_FEEDBACK || state == S_REGISTER_ADDRESS ||
+               state == S_DISH_NAME || state == S_BRANCH_NAME || state == S_BRANCH_STREET;
+    }
+
+    Customer* customer() const { return static_cast<Customer*>(user); }
+
+    static UserRole roleFor(char type) {
+        return type == 'a' ? ROLE_CUSTOMER : type == 'b' ? ROLE_OWNER : ROLE_PARTNER;
+    }
+
+    void showMainMenu() {
+        cout << "\n--- Main Menu ---" << endl;
+        cout << "1. Login as:\n   a) Customer\n   b) Restaurant Owner\n   c) Delivery Partner\n   r) Reports\n   q) Quit Application\nSelect User Type (a/b/c/r/q): ";
+        state = S_MAIN_MENU;
+    }
+
+    // Never waits on the gateway: a payment still out is called off instead
+    bool paidFor(Checkout& co) {
+        if (!co.payment.valid()) return false;
+        if (co.payment.wait_for(chrono::seconds(0)) == future_status::ready) return co.payment.get().success;
+        return manager.abandonPayment(co.order).success;
+    }
+
+    // Gives back whatever an unfinished checkout was still holding. An order
+    // already charged for goes ahead, closed like one left unrated.
+    void dropCheckout() {
+        if (!checkout) return;
+        Checkout& co = *checkout;
+        if (co.order && co.placed) {
+            manager.closeUnrated(co.order);
+        } else if (co.order && paidFor(co)) {
+            if (co.slot >= 0) {
+                manager.scheduleOrder(co.order, co.slot, co.route.etaMinutes);
+                co.slotHeld = false;
+            } else {
+                manager.placeOrder(co.order);
+                manager.closeUnrated(co.order);
+            }
+        } else if (co.order) {
+            if (co.redeemedOffer) manager.releaseOffer(customer(), *co.redeemedOffer);
+            manager.releaseKitchen(co.order);
+            manager.releaseStock(co.order);
+            delete co.order;
+        }
+        if (co.slotHeld) manager.releaseSlot(restaurant, co.slotZone, co.slot, co.slotWork);
+        checkout.reset();
+    }
+
+    // Every flow ends back at the main menu, logged out
+    void finish() {
+        dropCheckout();
+        draft.reset();
+        if (user) {
+            manager.getTokens().revoke(token);
+            user->logout();
+        }
+        token = AuthToken();
+        user = nullptr;
+        restaurant = nullptr;
+        showMainMenu();
+    }
+
+    void onMainMenu(const string& in);
+    void onAuth(const string& in);
+    void enterAs(User* u);
+    void onCustomer(const string& in);
+    void onOwner(const string& in);
+    void onReports(int choice);
+
+    // --- customer ---
+    size_t restaurantPages() const {
+        size_t total = manager.getRankings().restaurantCount();
+        return max<size_t>(1, (total + PAGE_SIZE - 1) / PAGE_SIZE);
+    }
+    void startCustomer();
+    void showRestaurantPage();
+    void showDishes();
+    void showSlots();
+    void checkoutCart();
+    void admitted(Admission admission);
+    void deliver();
+
+    // --- owner ---
+    void startOwner();
+    void showKitchen(int branch);
+    void runPartner();
+
+public:
+    explicit Session(SystemManager& m) : manager(m) {}
+    // A dropped connection keeps its token, so the user can resume until it expires
+    ~Session() {
+        dropCheckout();
+        if (user) user->logout();
+    }
+
+    void start() { showMainMenu(); }
+    void onInput(string line);
+    bool resume();
+
+    // The settled payment a waiting session is about to resume with, keyed as the gateway keys it
+    bool paymentReady(string& key, PaymentResult& result) const {
+        if (state != S_PAYMENT_PENDING || checkout->payment.wait_for(chrono::seconds(0)) != future_status::ready) return false;
+        key = "PAY-" + checkout->order->getId();
+        result = checkout->payment.get();
+        return true;
+    }
+
+    bool isWaiting() const { return state == S_PAYMENT_PENDING; }
+    bool isClosed() const { return state == S_CLOSED; }
+};
+
+void Session::onInput(string line) {
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    string word;
+    if (!wantsWholeLine() && !firstWord(line, word)) return;
+    const string& in = wantsWholeLine() ? line : word;
+
+    // Every step of a signed-in flow re-checks the token, which also slides its expiry
+    if (user && !manager.getTokens().validate(token)) {
+        cout << "\nYour session has expired. Please log in again." << endl;
+        finish();
+        return;
+    }
+
+    if (state == S_MAIN_MENU) onMainMenu(in);
+    else if (state <= S_RESUME_TOKEN) onAuth(in);
+    else if (state == S_REPORTS_MENU) {
+        int choice;
+        if (!parse(in, choice) || choice < 1 || choice > 11) {
+            cout << "Invalid choice. Please enter 1-11: ";
+            return;
+        }
+        onReports(choice);
+        showMainMenu();
+    }
+    else if (state <= S_FEEDBACK) onCustomer(in);
+    else if (state < S_CLOSED) onOwner(in);
+}
+
+void Session::onMainMenu(const string& in) {
+    char choice = in[0];
+    if (choice == 'q') {
+        cout << "\nThank you for using FoodMate. Goodbye!" << endl;
+        state = S_CLOSED;
+    } else if (choice == 'r') {
+        OrderArchive& archive = manager.getArchive();
+        cout << "\n### Reports ###" << endl;
+        cout << "Archived orders: " << archive.size() << " (" << archive.compressedBytes() << " bytes sealed)" << endl;
+        cout << "1. Revenue per Restaurant per Hour (last 24h)\n2. Discount Cost per Offer\n3. Tip Distribution per Partner\n"
+             << "4. Save Archive to Disk\n5. Load Archive from Disk\n6. Metrics Snapshot\n"
+             << "7. Order Stage Times per Restaurant\n8. Order Stage Times per Partner\n9. Export Order Traces\n"
+             << "10. Memory per Subsystem\n11. Back\nSelect option: ";
+        state = S_REPORTS_MENU;
+    } else if (choice == 'a' || choice == 'b' || choice == 'c') {
+        userType = choice;
+        cout << "\n---\n1. Login\n2. Register\n3. Resume Session\nSelect Option: ";
+        state = S_AUTH_CHOICE;
+    } else {
+        cout << "Invalid choice. Please select 'a', 'b', 'c', 'r', or 'q'." << endl;
+        showMainMenu();
+    }
+}
+
+void Session::onAuth(const string& in) {
+    User* created = nullptr;
+    switch (state) {
+    case S_AUTH_CHOICE: {
+        int choice;
+        if (!parse(in, choice) || choice < 1 || choice > 3) {
+            cout << "Invalid choice. Please enter 1, 2 or 3: ";
+            return;
+        }
+        draft.reset(new Draft);
+        cout << (choice == 1 ? "Enter User ID: " : choice == 2 ? "Enter Name: " : "Enter Session Token: ");
+        state = (choice == 1) ? S_LOGIN_ID : (choice == 2) ? S_REGISTER_NAME : S_RESUME_TOKEN;
+        return;
+    }
+    case S_LOGIN_ID:
+        draft->id = in;
+        cout << "Enter Password: ";
+        state = S_LOGIN_PASSWORD;
+        return;
+    case S_LOGIN_PASSWORD: {
+        User* u = nullptr;
+        AuthResult result = manager.authenticate(draft->id, in, roleFor(userType), u, token);
+        if (result == AUTH_OK) {
+            draft.reset();
+            u->login();
+            enterAs(u);
+            return;
+        }
+        cout << (result == AUTH_WRONG_ROLE ? "Login failed: User type mismatch or ID not found."
+                                           : "Login failed: Invalid ID or Password.") << endl;
+        finish();
+        return;
+    }
+    case S_RESUME_TOKEN: {
+        AuthToken resumed;
+        User* u = AuthToken::parse(in, resumed) ? manager.getTokens().validate(resumed) : nullptr;
+        if (!u || u->getRole() != roleFor(userType)) {
+            cout << "Session expired or token not recognised." << endl;
+            finish();
+            return;
+        }
+        draft.reset();
+        token = resumed;
+        u->login();
+        enterAs(u);
+        return;
+    }
+    case S_REGISTER_NAME:
+        draft->name = in;
+        cout << "Enter Password: ";
+        state = S_REGISTER_PASSWORD;
+        return;
+    case S_REGISTER_PASSWORD:
+        draft->pass = in;
+        if (userType == 'a') {
+            cout << "Enter Delivery Address: ";
+            state = S_REGISTER_ADDRESS;
+            return;
+        }
+        if (userType == 'c') {
+            cout << "Enter Vehicle Type (Bike/Car): ";
+            state = S_REGISTER_VEHICLE;
+            return;
+        }
+        created = new RestaurantOwner(draft->name, draft->pass);
+        break;
+    case S_REGISTER_ADDRESS:
+        created = new Customer(draft->name, draft->pass, in);
+        break;
+    case S_REGISTER_VEHICLE:
+        created = new DeliveryPartner(draft->name, draft->pass, in);
+        break;
+    default:
+        return;
+    }
+
+    if (!created->registerUser()) {
+        delete created;
+        finish();
+        return;
+    }
+    manager.addUser(created);
+    if (created->getRole() == ROLE_OWNER) 
+    {
+        RestaurantOwner* newOwner = static_cast<RestaurantOwner*>(created);
+        cout << "\nSetting up your first restaurant..." << endl;
+        string restName = draft->name + "'s Cafe"; // Use the owner's name
+        Restaurant* newRest = new Restaurant(restName, CUISINE_OTHER, newOwner->getName() + "@mail.com");
+        manager.addRestaurant(newRest); // Add to global system list
+        newOwner->addRestaurant(newRest); // Add to this owner's list
+    }
+    token = manager.getTokens().issue(created);
+    created->login(); // Log in *after* setup
+    draft.reset();
+    enterAs(created);
+}
+
+void Session::enterAs(User* u) {
+    user = u;
+    if (u->getRole() == ROLE_PARTNER) {
+        runPartner();
+        return;
+    }
+    // Partners see one screen and leave; the longer flows can be resumed after a dropped connection
+    cout << "Session token: " << token.toString() << " (stays valid while you are active, "
+         << manager.getTokens().getTtlMinutes() << " min idle limit)" << endl;
+    if (u->getRole() == ROLE_CUSTOMER) startCustomer();
+    else startOwner();
+}
+
+void Session::startCustomer() {
+    cout << "\n### Welcome " << user->getName() << "! Start Ordering ###" << endl;
+
+    vector<RankedDish> usuals = manager.usualsFor(customer(), 3);
+    if (!usuals.empty()) {
+        cout << "\n--- Reorder Your Usuals ---" << endl;
+        for (const RankedDish& d : usuals) {
+            cout << "  [" << d.restaurantId << "] " << d.restaurantName << " - " << d.name << endl;
+        }
+    }
+    page = 0;
+    rankBy = RANK_BEST_RATED;
+    showRestaurantPage();
+}
+
+// Only the visible page is read from the ranking, never the full list
+void Session::showRestaurantPage() {
+    cout << "\n--- Select Restaurant (" << (rankBy == RANK_BEST_RATED ? "Top Rated" : "Most Ordered")
+         << ", page " << page + 1 << "/" << restaurantPages() << ") ---" << endl;
+    for (Restaurant* r : manager.getRankings().topRestaurants(rankBy, page * PAGE_SIZE, PAGE_SIZE)) {
+         r->displayInfo();
+    }
+    cout << "Enter Restaurant ID (e.g., R501), N/P for next/previous page, S to switch ranking, F to find a dish: ";
+    state = S_PICK_RESTAURANT;
+}
+
+void Session::showDishes() {
+    Checkout& co = *checkout;
+    co.dishes = restaurant->getMenu().filterDishes(co.cuisine, co.course, co.dishType);
+
+    cout << "\n--- Available Dishes at " << restaurant->getName() << " ---" << endl;
+    if (co.dishes.empty()) {
+         cout << "No dishes match your filters." << endl;
+         finish();
+         return;
+    }
+    for (const auto& dish : co.dishes) {
+         dish.display();
+    }
+    cout << "Enter dish ID to add (e.g., D257) (or 'DONE'): ";
+    state = S_ADD_DISH;
+}
+
+void Session::showSlots() {
+    Checkout& co = *checkout;
+    co.slotZone = SurgePricing::zoneFor(customer()->getAddress());
+    co.slotWork = Kitchen::workFor(co.cart.getItems());
+    co.offeredSlots = manager.openSlots(restaurant, co.slotZone, co.slotWork, SLOT_CHOICES);
+    if (co.offeredSlots.empty()) {
+        cout << "\n" << restaurant->getName() << " has no delivery slots left this week." << endl;
+        finish();
+        return;
+    }
+    cout << "\n--- Delivery Slots ---" << endl;
+    for (size_t i = 0; i < co.offeredSlots.size(); i++) {
+        cout << i + 1 << ". " << PreorderBook::describe(co.offeredSlots[i]) << endl;
+    }
+    cout << "Pick a slot, or enter a day and time (e.g. Sat 19:45): ";
+    state = S_PICK_SLOT;
+}
+
+void Session::checkoutCart() {
+    Checkout& co = *checkout;
+    if (co.cart.isEmpty()) {
+         cout << "Order cancelled." << endl;
+         finish();
+         return;
+    }
+
+    vector<RankedDish> suggestions = manager.recommendForCart(co.cart, 3);
+    if (!suggestions.empty()) {
+        cout << "\nCustomers also ordered: ";
+        for (size_t i = 0; i < suggestions.size(); i++) {
+            cout << (i ? ", " : "") << suggestions[i].name;
+        }
+        cout << endl;
+    }
+
+    co.order = new Order(customer(), restaurant, co.cart);
+    co.route = manager.routeOrder(co.order, co.slot >= 0);
+    if (co.route.branch < 0) {
+        cout << "\nNo branch of " << restaurant->getName() << " can take this order right now." << endl;
+        finish();
+        return;
+    }
+    if (co.slot >= 0) {
+        admitted(ADMIT_OK); // it is cooked on release, from kitchen time the slot set aside
+        return;
+    }
+    Admission admission = manager.admitToKitchen(co.order, false);
+    if (admission == ADMIT_THROTTLED) {
+        cout << "\n" << restaurant->getName() << " is busy right now. Food will take about " << co.route.prepMinutes
+             << " min. Continue? (y/n): ";
+        state = S_CONFIRM_WAIT;
+        return;
+    }
+    admitted(admission);
+}
+
+void Session::admitted(Admission admission) {
+    Checkout& co = *checkout;
+    Branch& branch = restaurant->getBranch(co.route.branch);
+    Kitchen& kitchen = branch.getKitchen();
+    if (admission == ADMIT_DEFERRED) {
+        cout << "\n" << restaurant->getName() << " is not taking new orders at the moment. Please try again in about "
+             << max(1, kitchen.waitMinutes() - kitchen.getDeferWait() + 1) << " min." << endl;
+        finish();
+        return;
+    }
+    if (co.slot < 0 && !manager.reserveStock(co.order)) { // a pre-order takes its stock on release
+        cout << "\nSorry, part of your order just sold out at " << branch.getName() << "." << endl;
+        finish();
+        return;
+    }
+    if (co.slot >= 0) {
+        cout << "\nServed from " << branch.getName() << ", at your door " << PreorderBook::describe(co.slot) << endl;
+    } else {
+        cout << "\nServed from " << branch.getName() << ". Estimated prep time: " << co.route.prepMinutes
+             << " min, at your door in about " << co.route.etaMinutes << " min" << endl;
+    }
+    manager.applyDeliveryFee(co.order);
+
+    cout << "\n--- Offers ---" << endl;
+    for (const auto& offer : manager.getOffers()) {
+         cout << "- Code: " << offer.getCode() << endl;
+    }
+    cout << "Enter promo code (or 'NONE'): ";
+    state = S_PROMO;
+}
+
+void Session::onCustomer(const string& in) {
+    Checkout* co = checkout.get();
+    int n;
+    switch (state) {
+    case S_PICK_RESTAURANT:
+        if (in == "F" || in == "f") {
+            cout << "Search dishes or restaurants: ";
+            state = S_SEARCH_QUERY;
+            return;
+        }
+        if (in == "N" || in == "n") { if (static_cast<size_t>(page) + 1 < restaurantPages()) page++; }
+        else if (in == "P" || in == "p") { if (page > 0) page--; }
+        else if (in == "S" || in == "s") { rankBy = (rankBy == RANK_BEST_RATED) ? RANK_MOST_ORDERED : RANK_BEST_RATED; page = 0; }
+        else {
+            restaurant = manager.findRestaurant(in);
+            if (!restaurant) {
+                 cout << "Invalid Restaurant ID." << endl;
+                 finish();
+                 return;
+            }
+            checkout.reset(new Checkout);
+            cout << "\n--- Apply Filters (Optional) ---" << endl;
+            cout << "Cuisine (1:Indian, 2:Italian, 3:Chinese, 4:Mexican, 5:Japanese, 0:Any): ";
+            state = S_CUISINE;
+            return;
+        }
+        showRestaurantPage();
+        return;
+
+    case S_SEARCH_QUERY: {
+        vector<SearchHit> hits = manager.getSearch().search(in);
+        if (hits.empty()) cout << "No matches for \"" << in << "\"." << endl;
+        for (const SearchHit& h : hits) {
+            cout << fixed << setprecision(1) << "  [" << h.restaurantId << "] " << h.restaurantName;
+            if (!h.isRestaurant) cout << " - " << h.name;
+            if (h.rating > 0) cout << " | Rating: " << h.rating << "⭐";
+            cout << endl;
+        }
+        showRestaurantPage();
+        return;
+    }
+
+    case S_CUISINE: {
+        if (!parse(in, n) || n < 0 || n > 5) {
+             cout << "Invalid input. Please enter a number (0-5): ";
+             return;
+        }
+        const string cuisines[] = {CUISINE_ANY, CUISINE_INDIAN, CUISINE_ITALIAN, CUISINE_CHINESE, CUISINE_MEXICAN, CUISINE_JAPANESE};
+        co->cuisine = cuisines[n];
+        cout << "Course (1:Lunch, 2:Dinner, 0:Any): ";
+        state = S_COURSE;
+        return;
+    }
+
+    case S_COURSE:
+        if (!parse(in, n) || (n != 0 && n != 1 && n != 2)) {
+             cout << "Invalid input. Please enter 0, 1, or 2: ";
+             return;
+        }
+        co->course = (n == 1) ? COURSE_LUNCH : (n == 2) ? COURSE_DINNER : COURSE_ANY;
+        cout << "Type (1:Veg, 2:Non-Veg, 0:Both): ";
+        state = S_TYPE;
+        return;
+
+    case S_TYPE:
+        if (!parse(in, n) || n < 0 || n > 2) {
+             cout << "Invalid input. Please enter 0, 1, or 2: ";
+             return;
+        }
+        co->dishType = (n == 1) ? DISH_VEG : (n == 2) ? DISH_NON_VEG : DISH_BOTH;
+        showDishes();
+        return;
+
+    case S_ADD_DISH: {
+        if (in == "DONE") {
+            if (co->cart.isEmpty()) {
+                checkoutCart();
+                return;
+            }
+            cout << "\nWhen should it arrive?\n1. Now\n2. Schedule for later\nSelect option: ";
+            state = S_WHEN;
+            return;
+        }
+        Dish* foundDish = nullptr;
+        for (auto& d : co->dishes) {
+            if (d.getId() == in) {
+                foundDish = &d;
+                break;
+            }
+        }
+        if (foundDish) {
+            co->cart.addItem(*foundDish);
+        } else {
+            cout << "Dish not found." << endl;
+        }
+        cout << "Enter dish ID to add (e.g., D257) (or 'DONE'): ";
+        return;
+    }
+
+    case S_WHEN:
+        if (!parse(in, n) || n < 1 || n > 2) {
+             cout << "Invalid choice. Please enter 1 or 2: ";
+             return;
+        }
+        if (n == 1) checkoutCart();
+        else showSlots();
+        return;
+
+    case S_PICK_SLOT: {
+        int64_t slot;
+        if (parseWhole(in, n) && n >= 1 && n <= static_cast<int>(co->offeredSlots.size())) slot = co->offeredSlots[n - 1];
+        else slot = PreorderBook::parseTime(in, Clock::nowMicros());
+        if (slot < 0 || !manager.holdSlot(restaurant, co->slotZone, slot, co->slotWork)) {
+             cout << "That slot can't be booked. Pick one from the list or another time: ";
+             return;
+        }
+        co->slot = slot;
+        co->slotHeld = true;
+        checkoutCart();
+        return;
+    }
+
+    case S_CONFIRM_WAIT:
+        if (in[0] == 'y' || in[0] == 'Y') admitted(manager.admitToKitchen(co->order, true));
+        else {
+            cout << "Order cancelled." << endl;
+            finish();
+        }
+        return;
+
+    case S_PROMO:
+        if (in != "NONE") 
+        {
+            const Offer* foundOffer = nullptr;
+            for (const auto& o : manager.getOffers()) {
+                if (o.getCode() == in) {
+                    foundOffer = &o;
+                    break;
+                }
+            }
+
+            if (foundOffer) {
+                if (manager.redeemOffer(customer(), *foundOffer)) {
+                    co->order->applyOffer(*foundOffer, customer());
+                    if (co->order->getDiscount() > Money()) {
+                        co->redeemedOffer = foundOffer;
+                    } else {
+                        manager.releaseOffer(customer(), *foundOffer); // offer rejected, don't burn a use
+                    }
+                }
+            } else {
+                cout << "Invalid promo code." << endl;
+            }
+        }
+        co->order->displayDetails();
+        cout << "\n--- Payment ---" << endl;
+        cout << "1. UPI\n2. COD\n3. Credit Card\nSelect payment mode: ";
+        state = S_PAYMENT_MODE;
+        return;
+
+    case S_PAYMENT_MODE: {
+        if (!parse(in, n) || n < 1 || n > 3) {
+             cout << "Invalid choice. Please enter 1 for UPI, 2 for COD or 3 for Credit Card: ";
+             return;
+        }
+        unique_ptr<Payment> method;
+        if (n == 1) method.reset(new UPIPayment());
+        else if (n == 2) method.reset(new COD());
+        else method.reset(new CreditCardPayment());
+
+        // The gateway answers in the background and the engine resumes this session once it
+        // has. Only cash settles on the spot, so every gateway answer passes through poll().
+        co->paymentMode = method->getMode();
+        co->payment = manager.submitPayment(co->order, *method);
+        state = S_PAYMENT_PENDING;
+        if (n == 2) resume();
+        return;
+    }
+
+    case S_TIP:
+        if (!parse(in, n) || n < 0) {
+             cout << "Invalid amount. Please enter a positive number (or 0): $";
+             return;
+        }
+        co->order->addTip(Money::fromWhole(n));
+        cout << "Tip of $" << n << " added to final bill." << endl;
+        cout << "\n--- Rate Your Experience (1-5 Stars) ---" << endl;
+        cout << "Food Rating: ";
+        state = S_FOOD_RATING;
+        return;
+
+    case S_FOOD_RATING:
+    case S_DELIVERY_RATING:
+        if (!parse(in, n) || n < 1 || n > 5) {
+             cout << "Invalid rating. Please enter a number between 1 and 5: ";
+             return;
+        }
+        if (state == S_FOOD_RATING) {
+            co->foodRating = n;
+            cout << "Delivery Rating: ";
+            state = S_DELIVERY_RATING;
+        } else {
+            co->deliveryRating = n;
+            cout << "Write feedback (one line): ";
+            state = S_FEEDBACK;
+        }
+        return;
+
+    case S_FEEDBACK:
+        Rating().apply(co->order, manager, co->foodRating, co->deliveryRating, in);
+        co->order = nullptr; // finalized and archived by the rating
+        cout << "\nThank you for ordering from FoodMate! Have a great day!" << endl;
+        finish();
+        return;
+
+    default:
+        return;
+    }
+}
+
+// Picks the flow back up once the payment has settled; false while it is still out
+bool Session::resume() {
+    if (state != S_PAYMENT_PENDING || checkout->payment.wait_for(chrono::seconds(0)) != future_status::ready) return false;
+    Checkout& co = *checkout;
+    PaymentResult payment = co.payment.get();
+
+    if (!payment.success) {
+         cout << "Payment failed (" << payment.message << ", " << payment.attempts << " attempt(s)). Order cancelled." << endl;
+         finish();
+         return true;
+    }
+    cout << "Payment successful via " << co.paymentMode << "!";
+    if (!payment.reference.empty()) cout << " (Ref: " << payment.reference << ")";
+    cout << endl;
+    if (co.slot >= 0) {
+        int lead = manager.scheduleOrder(co.order, co.slot, co.route.etaMinutes);
+        cout << "Order " << co.order->getId() << " is booked for " << PreorderBook::describe(co.slot)
+             << ". The kitchen starts on it about " << lead << " min before." << endl;
+        co.order = nullptr; // the pre-order book owns it now
+        co.slotHeld = false;
+        cout << "\nThank you for ordering from FoodMate!" << endl;
+        finish();
+        return true;
+    }
+    manager.placeOrder(co.order);
+    co.placed = true;
+    deliver();
+    return true;
+}
+
+void Session::deliver() {
+    Order* order = checkout->order;
+
+    // Pass string constant
+    manager.updateOrderStatus(order->getId(), STATUS_PREPARING);
+    Chat chat(order->getId());
+    chat.autoGenerateMessage(STATUS_PREPARING); // Pass string constant
+
+    cout << "\n[Simulating Delivery Process...]" << endl;
+    manager.updateOrderStatus(order->getId(), STATUS_OUT_FOR_DELIVERY);
+    chat.autoGenerateMessage(STATUS_OUT_FOR_DELIVERY);
+
+    chat.sendMessage(user->getName(), "Hi, please come to gate 3.");
+    chat.sendMessage("DeliveryPartner", "Sure, on the way, arriving in 5 mins!");
+    chat.displayHistory();
+
+    manager.updateOrderStatus(order->getId(), STATUS_DELIVERED);
+    chat.autoGenerateMessage(STATUS_DELIVERED);
+
+    cout << "\n--- Tip Delivery Partner ---" << endl;
+    cout << "Tip (e.g., 5, 10, 20): $";
+    state = S_TIP;
+}
+
+void Session::startOwner() {
+    RestaurantOwner* owner = static_cast<RestaurantOwner*>(user);
+    cout << "\n### Restaurant Owner Dashboard ###" << endl;
+    owner->viewProfile();
+
+    if (owner->getOwnedRestaurants().empty()) {
+        cout << "\nYou do not own any restaurants to manage." << endl;
+        finish();
+        return;
+    }
+    cout << "\nEnter the ID of the restaurant you want to manage (e.g., R501): ";
+    state = S_OWNER_RESTAURANT;
+}
+
+void Session::showKitchen(int branch) {
+    draft->branch = branch;
+    Kitchen& k = restaurant->getBranch(branch).getKitchen();
+    cout << "\nCurrent: " << k.getSlots() << " parallel orders, busy warning at " << k.getThrottleWait()
+         << " min wait, pause new orders at " << k.getDeferWait() << " min wait" << endl;
+    cout << "Orders cooked in parallel: ";
+    state = S_KITCHEN_PARALLEL;
+}
+
+void Session::onOwner(const string& in) {
+    Restaurant* myRest = restaurant;
+    int n;
+    switch (state) {
+    case S_OWNER_RESTAURANT:
+        // Only restaurants in the owner's own portfolio can be managed
+        for (Restaurant* r : static_cast<RestaurantOwner*>(user)->getOwnedRestaurants()) {
+            if (r->getId() == in) {
+                restaurant = r;
+                break;
+            }
+        }
+        if (restaurant == nullptr) {
+            cout << "Error: Restaurant ID not found in your portfolio." << endl;
+            finish();
+            return;
+        }
+        cout << "\nManaging Menu for: " << restaurant->getName() << endl;
+        cout << "1. Add Dish\n2. View Menu\n3. Live Dashboard\n4. Kitchen Settings\n5. Branches\n6. Update Price\n7. Back\nSelect option: ";
+        state = S_OWNER_MENU;
+        return;
+
+    case S_OWNER_MENU:
+        if (!parse(in, n) || n < 1 || n > 7) {
+            cout << "Invalid choice. Please enter 1-7: ";
+            return;
+        }
+        draft.reset(new Draft);
+        if (n == 1) {
+            cout << "Dish Name: ";
+            state = S_DISH_NAME;
+        } else if (n == 2) {
+            cout << "\n--- Current Menu ---" << endl;
+            for (const auto& dish : myRest->getMenu().getAllDishes()) {
+                dish.display();
+            }
+            finish();
+        } else if (n == 3) {
+            RestaurantDashboard d = manager.getDashboards().forRestaurant(*myRest);
+            cout << "\n--- Live Dashboard: " << myRest->getName() << " ---" << endl;
+            cout << "Orders (last hour): " << d.ordersLastHour << endl;
+            cout << "Orders today: " << d.ordersToday << endl;
+            cout << "Revenue today: $" << d.revenueToday << endl;
+            cout << "Avg prep time: " << fixed << setprecision(1) << d.avgPrepMinutes << " min" << endl;
+            for (size_t i = 0; i < myRest->branchCount(); i++) {
+                Branch& b = myRest->getBranch(i);
+                cout << "Kitchen @ " << b.getName() << ": " << b.getKitchen().getOpenOrders() << " open orders, ~"
+                     << b.getKitchen().waitMinutes() << " min queue" << endl;
+            }
+            cout << "Rating: " << fixed << setprecision(1) << d.rating << "⭐" << endl;
+            cout << "Top dishes:" << endl;
+            if (d.topDishes.empty()) cout << "  (no orders yet)" << endl;
+            for (const auto& entry : d.topDishes) {
+                RankedDish dish;
+                if (manager.getRankings().describeDish(entry.first, dish)) {
+                    cout << "  " << entry.second << "x " << dish.name << endl;
+                }
+            }
+            finish();
+        } else if (n == 4) {
+            if (myRest->branchCount() > 1) {
+                for (size_t i = 0; i < myRest->branchCount(); i++) cout << i + 1 << ". " << myRest->getBranch(i).getName() << endl;
+                cout << "Branch: ";
+                state = S_KITCHEN_BRANCH;
+            } else {
+                showKitchen(0);
+            }
+        } else if (n == 5) {
+            cout << "\n--- Branches ---" << endl;
+            for (size_t i = 0; i < myRest->branchCount(); i++) {
+                Branch& b = myRest->getBranch(i);
+                cout << i + 1 << ". " << b.getName() << " (" << (b.isOpen() ? "Open" : "Closed") << ", zone "
+                     << b.getLocation().zone() << ")" << endl;
+            }
+            cout << "1. Open/Close a Branch\n2. Mark Dish Available/Unavailable\n3. Add Branch\n4. Set Dish Stock\n5. Back\nSelect option: ";
+            state = S_BRANCH_MENU;
+        } else if (n == 6) {
+            cout << "Dish ID: ";
+            state = S_PRICE_DISH;
+        } else {
+            finish();
+        }
+        return;
+
+    case S_DISH_NAME:
+        draft->name = in;
+        cout << "Price: $";
+        state = S_DISH_PRICE;
+        return;
+
+    case S_DISH_PRICE:
+        if (!parse(in, draft->price) || draft->price <= 0) {
+            cout << "Invalid input. Please enter a valid price (e.g., 12.50): $";
+            return;
+        }
+        cout << "Type (1:Veg, 2:Non-Veg): ";
+        state = S_DISH_TYPE;
+        return;
+
+    case S_DISH_TYPE:
+        if (!parse(in, n) || (n != 1 && n != 2)) {
+            cout << "Invalid input. Please enter 1 for Veg or 2 for Non-Veg: ";
+            return;
+        }
+        draft->dishType = (n == 1) ? DISH_VEG : DISH_NON_VEG;
+        cout << "Cuisine (0:Indian, 1:Italian, 2:Chinese, 3:Mexican, 4:Japanese, 5:Other): ";
+        state = S_DISH_CUISINE;
+        return;
+
+    case S_DISH_CUISINE: {
+        if (!parse(in, n) || n < 0 || n > 5) {
+            cout << "Invalid input. Please enter a number between 0 and 5: ";
+            return;
+        }
+        const string cuisines[] = {CUISINE_INDIAN, CUISINE_ITALIAN, CUISINE_CHINESE, CUISINE_MEXICAN, CUISINE_JAPANESE, CUISINE_OTHER};
+        draft->cuisine = cuisines[n];
+        cout << "Course (0:Breakfast, 1:Brunch, 2:Lunch, 3:Snacks, 4:Dinner, 5:Dessert, 6:Any): ";
+        state = S_DISH_COURSE;
+        return;
+    }
+
+    case S_DISH_COURSE: {
+        if (!parse(in, n) || n < 0 || n > 6) {
+            cout << "Invalid input. Please enter a number between 0 and 6: ";
+            return;
+        }
+        const string courses[] = {COURSE_BREAKFAST, COURSE_BRUNCH, COURSE_LUNCH, COURSE_SNACKS, COURSE_DINNER, COURSE_DESSERT, COURSE_ANY};
+        draft->course = courses[n];
+        cout << "Prep time (minutes): ";
+        state = S_DISH_PREP;
+        return;
+    }
+
+    case S_DISH_PREP:
+        if (!parse(in, n) || n < 1 || n > 240) {
+            cout << "Invalid input. Please enter 1-240 minutes: ";
+            return;
+        }
+        myRest->getMenu().addDish({draft->name, draft->price, draft->dishType, draft->cuisine, draft->course, n});
+        cout << "Dish '" << draft->name << "' added to the menu." << endl;
+        finish();
+        return;
+
+    case S_KITCHEN_BRANCH:
+    case S_BRANCH_NUMBER:
+        if (!parse(in, n) || n < 1 || n > static_cast<int>(myRest->branchCount())) {
+            cout << "Invalid input. Please enter 1-" << myRest->branchCount() << ": ";
+            return;
+        }
+        if (state == S_KITCHEN_BRANCH) {
+            showKitchen(n - 1);
+            return;
+        }
+        draft->branch = n - 1;
+        if (draft->action == 1) {
+            Branch& b = myRest->getBranch(draft->branch);
+            b.setOpen(!b.isOpen());
+            cout << b.getName() << " is now " << (b.isOpen() ? "open" : "closed") << "." << endl;
+            finish();
+            return;
+        }
+        cout << "Dish ID: ";
+        state = S_BRANCH_DISH;
+        return;
+
+    case S_KITCHEN_PARALLEL:
+        if (!parse(in, draft->parallel) || draft->parallel < 1) {
+            cout << "Invalid input. Please enter at least 1: ";
+            return;
+        }
+        cout << "Busy warning at wait (min): ";
+        state = S_KITCHEN_THROTTLE;
+        return;
+
+    case S_KITCHEN_THROTTLE:
+        if (!parse(in, draft->throttle) || draft->throttle < 0) {
+            cout << "Invalid input. Please enter 0 or more: ";
+            return;
+        }
+        cout << "Pause new orders at wait (min): ";
+        state = S_KITCHEN_DEFER;
+        return;
+
+    case S_KITCHEN_DEFER:
+        if (!parse(in, n) || n < draft->throttle) {
+            cout << "Invalid input. Please enter at least " << draft->throttle << ": ";
+            return;
+        }
+        myRest->getBranch(draft->branch).getKitchen().configure(draft->parallel, draft->throttle, n);
+        cout << "Kitchen settings updated." << endl;
+        finish();
+        return;
+
+    case S_BRANCH_MENU:
+        if (!parse(in, n) || n < 1 || n > 5) {
+            cout << "Invalid choice. Please enter 1-5: ";
+            return;
+        }
+        draft->action = n;
+        if (n == 1 || n == 2 || n == 4) {
+            cout << "Branch number: ";
+            state = S_BRANCH_NUMBER;
+        } else if (n == 3 && myRest->branchCount() >= static_cast<size_t>(StockBoard::MAX_BRANCHES)) {
+            cout << "A restaurant can have at most " << StockBoard::MAX_BRANCHES << " branches." << endl;
+            finish();
+        } else if (n == 3) {
+            cout << "Branch Name: ";
+            state = S_BRANCH_NAME;
+        } else {
+            finish();
+        }
+        return;
+
+    case S_BRANCH_DISH:
+    case S_BRANCH_STOCK: {
+        if (state == S_BRANCH_STOCK && (!parse(in, n) || n < -1)) {
+            cout << "Invalid input. Please enter -1 or more: ";
+            return;
+        }
+        if (state == S_BRANCH_DISH) draft->id = in;
+        Branch& b = myRest->getBranch(draft->branch);
+        for (const auto& dish : myRest->getMenu().getAllDishes()) {
+            if (dish.getId() != draft->id) continue;
+            if (state == S_BRANCH_STOCK) {
+                StockBoard::instance().setStock(dish.getStockHandle(), b.getIndex(), n);
+                myRest->refreshStock(dish);
+                cout << "Stock updated." << endl;
+            } else if (draft->action == 4) {
+                int32_t left = StockBoard::instance().available(dish.getStockHandle(), b.getIndex());
+                cout << "In stock now: " << (left == StockBoard::UNLIMITED ? string("unlimited") : to_string(left))
+                     << "\nNew stock (-1 for unlimited): ";
+                state = S_BRANCH_STOCK;
+                return;
+            } else {
+                bool nowAvailable = !b.isDishAvailable(dish.getRatingHandle());
+                b.setDishAvailable(dish.getRatingHandle(), nowAvailable);
+                cout << dish.getName() << " is now " << (nowAvailable ? "available" : "unavailable")
+                     << " at " << b.getName() << "." << endl;
+            }
+            finish();
+            return;
+        }
+        cout << "Dish not found." << endl;
+        finish();
+        return;
+    }
+
+    case S_BRANCH_NAME:
+        draft->name = in;
+        cout << "Street Address: ";
+        state = S_BRANCH_STREET;
+        return;
+
+    case S_BRANCH_STREET:
+        myRest->addBranch(draft->name, GeoPoint::locate(in));
+        cout << "Branch '" << draft->name << "' added." << endl;
+        finish();
+        return;
+
+    case S_PRICE_DISH:
+        draft->id = in;
+        cout << "New Price: $";
+        state = S_PRICE_VALUE;
+        return;
+
+    case S_PRICE_VALUE: {
+        if (!parse(in, draft->price) || draft->price <= 0) {
+            cout << "Invalid input. Please enter a valid price (e.g., 12.50): $";
+            return;
+        }
+        Menu& menu = myRest->getMenu();
+        uint64_t before = menu.getVersion();
+        if (menu.repriceDish(draft->id, Money::fromDollars(draft->price))) {
+            cout << "Price updated. Menu is now at version " << menu.getVersion() << " ("
+                 << menu.deltaSince(before).size() << "-byte update for synced clients)." << endl;
+        } else {
+            cout << "Dish not found." << endl;
+        }
+        finish();
+        return;
+    }
+
+    default:
+        return;
+    }
+}
+
+void Session::runPartner() {
+    DeliveryPartner* partner = static_cast<DeliveryPartner*>(user);
+    cout << "\n### Delivery Partner Dashboard ###" << endl;
+    partner->viewProfile();
+
+    PartnerDashboard d = manager.getDashboards().forPartner(*partner);
+    cout << "\n--- Live Stats ---" << endl;
+    cout << "Earnings (last hour): $" << d.earningsLastHour << endl;
+    cout << "Earnings (since start): $" << d.earningsTotal << endl;
+    cout << "Deliveries offered/accepted/completed: " << d.offered << "/" << d.accepted << "/" << d.completed << endl;
+    if (d.offered > 0) {
+        cout << "Acceptance rate: " << fixed << setprecision(0) << (100.0 * d.accepted / d.offered) << "%" << endl;
+    }
+    cout << "Avg delivery time: " << fixed << setprecision(1) << d.avgDeliveryMinutes << " min" << endl;
+    cout << "\nNo new delivery assignments in the current simulation." << endl;
+    finish();
+}
+
+void Session::onReports(int choice) 
+{
+    const string ARCHIVE_FILE = "foodmate_orders.arc";
+    const string TRACE_FILE = "foodmate_traces.json";
+    OrderArchive& archive = manager.getArchive();
+
+    if (choice == 1) {
+        long long now = Clock::nowMicros();
+        auto revenue = archive.revenuePerRestaurantHour(now - 24LL * 3600 * 1000000, now + 1);
+        if (revenue.empty()) cout << "No orders in the last 24 hours." << endl;
+        for (const auto& r : revenue) {
+            time_t hourStart = static_cast<time_t>(r.first.second * 3600);
+            char label[32];
+            strftime(label, sizeof(label), "%Y-%m-%d %H:00", localtime(&hourStart));
+            cout << "  R" << r.first.first << " @ " << label << " : $" << r.second << endl;
+        }
+    } else if (choice == 2) {
+        auto cost = archive.discountCostPerOffer();
+        if (cost.empty()) cout << "No discounts given yet." << endl;
+        for (const auto& c : cost) cout << "  " << manager.offerCodeForSlot(c.first) << " : $" << c.second << endl;
+    } else if (choice == 3) {
+        const char* labels[TipStats::BUCKETS] = {"$0", "<$2", "<$5", "<$10", "<$20", "$20+"};
+        auto tips = archive.tipDistributionPerPartner();
+        if (tips.empty()) cout << "No delivered orders yet." << endl;
+        for (const auto& t : tips) {
+            cout << "  U" << t.first << " : " << t.second.orders << " orders, $" << t.second.total << " total |";
+            for (int k = 0; k < TipStats::BUCKETS; k++) cout << " " << labels[k] << ":" << t.second.counts[k];
+            cout << endl;
+        }
+    } else if (choice == 4) {
+        cout << (archive.saveTo(ARCHIVE_FILE, manager) ? "Archive saved to " : "Could not write ") << ARCHIVE_FILE << endl;
+    } else if (choice == 5) {
+        if (archive.loadFrom(ARCHIVE_FILE, manager)) {
+            manager.rebuildRecommendations();
+            cout << "Archive loaded from " << ARCHIVE_FILE << "." << endl;
+        } else {
+            cout << "Could not read " << ARCHIVE_FILE << "." << endl;
+        }
+    } else if (choice == 6) {
+        MetricsSnapshot snap = Metrics::instance().snapshot();
+        cout << "\n--- Metrics (uptime " << fixed << setprecision(0) << snap.uptimeSeconds << "s) ---" << endl;
+        for (int c = 0; c < COUNTER_COUNT; c++) {
+            cout << "  " << setw(20) << left << COUNTER_NAMES[c] << right << snap.counters[c]
+                 << "  (" << setprecision(3) << snap.counters[c] / max(snap.uptimeSeconds, 1e-9) << "/s)" << endl;
+        }
+        cout << "  " << setw(20) << left << "latency (us)" << right << "  count      p50      p99     p999" << endl;
+        for (int h = 0; h < HISTOGRAM_COUNT; h++) {
+            const HistogramSummary& hs = snap.histograms[h];
+            cout << "  " << setw(20) << left << HISTOGRAM_NAMES[h] << right << setw(7) << hs.count << setprecision(1)
+                 << setw(9) << hs.p50Nanos / 1000 << setw(9) << hs.p99Nanos / 1000 << setw(9) << hs.p999Nanos / 1000 << endl;
+        }
+        cout << (manager.exportMetrics() ? "Exported to " : "Could not write ") << SystemManager::METRICS_FILE << endl;
+    } else if (choice == 7 || choice == 8) {
+        bool byRestaurant = choice == 7;
+        auto report = manager.getTraces().stageReport(byRestaurant ? GROUP_BY_RESTAURANT : GROUP_BY_PARTNER);
+        if (report.empty()) cout << "No finished orders traced yet." << endl;
+        for (const auto& entry : report) {
+            cout << "  " << (byRestaurant ? "R" : "U") << entry.first << "  (ms)      n      p50      p90      p99      max" << endl;
+            for (int s = 0; s < STAGE_COUNT - 1; s++) {
+                const StageStats& st = entry.second[s];
+                if (!st.samples) continue;
+                cout << "    " << setw(10) << left << SPAN_NAMES[s] << right << setw(9) << st.samples << fixed << setprecision(1)
+                     << setw(9) << st.p50 / 1000.0 << setw(9) << st.p90 / 1000.0 << setw(9) << st.p99 / 1000.0
+                     << setw(9) << st.max / 1000.0 << endl;
+            }
+        }
+    } else if (choice == 9) {
+        bool ok = manager.getTraces().exportChromeTrace(TRACE_FILE);
+        cout << (ok ? "Wrote " + to_string(manager.getTraces().size()) + " order traces to " : "Could not write ") << TRACE_FILE << endl;
+    } else if (choice == 10) {
+        cout << "\n--- Memory ---" << endl;
+        cout << "  " << setw(18) << left << "subsystem" << right << "   live KB   blocks   peak KB   allocations" << endl;
+        for (int t = 0; t < MEM_TAG_COUNT; t++) {
+            MemoryUsage u = MemoryLedger::instance().usage(static_cast<MemoryTag>(t));
+            cout << "  " << setw(18) << left << MEMORY_TAG_NAMES[t] << right << fixed << setprecision(1) << setw(10)
+                 << u.liveBytes / 1024.0 << setw(9) << u.liveBlocks << setw(10) << u.peakBytes / 1024.0 << setw(14)
+                 << u.allocations << endl;
+        }
+    }
+}
+
+// Binary trace of everything that reaches the engine from outside, enough to
+// rebuild a deterministic run exactly. Layout:
+//   "FMTRACE1" | varint seed | varint start micros | events...
+//   event: type byte | varint sim micros since the previous event | payload
+//     OPEN, CLOSE   session
+//     INPUT         session, line
+//     PAYMENT       idempotency key, success byte, attempts, reference, message
+//     TIMER         timer id byte
+// Strings are varint length + bytes, as in MenuDelta.
+enum TraceEventType : uint8_t { EVENT_OPEN = 1, EVENT_INPUT, EVENT_CLOSE, EVENT_PAYMENT, EVENT_TIMER };
+
+class TraceRecorder {
+private:
+    static const size_t FLUSH_BYTES = 64 * 1024;
+    ofstream file;
+    vector<uint8_t> buffer;
+    long long lastMicros;
+    uint64_t events = 0;
+
+    void begin(TraceEventType type) {
+        if (buffer.size() >= FLUSH_BYTES) flush();
+        long long now = Clock::nowMicros();
+        buffer.push_back(type);
+        MenuDelta::putVarint(buffer, static_cast<uint64_t>(max(0LL, now - lastMicros)));
+        lastMicros = max(lastMicros, now);
+        events++;
+    }
+
+public:
+    static const char* const MAGIC;
+
+    // The run must already be deterministic: the header records its seed and start time
+    bool open(const string& path) {
+        RunContext& ctx = RunContext::instance();
+        file.open(path, ios::binary | ios::trunc);
+        if (!file) return false;
+        buffer.assign(MAGIC, MAGIC + 8);
+        MenuDelta::putVarint(buffer, ctx.getSeed());
+        MenuDelta::putVarint(buffer, static_cast<uint64_t>(ctx.getStartMicros()));
+        lastMicros = ctx.getStartMicros();
+        return true;
+    }
 
-    Restaurant* selectedRestaurant = nullptr;
-    // Filters are  strings
-    string cuisineFilter = CUISINE_ANY;
-    string courseFilter = COURSE_ANY;
-    string typeFilter = DISH_BOTH;
+    ~TraceRecorder() { flush(); }
 
-    cout << "\n### Welcome " << customer->getName() << "! Start Ordering ###" << endl;
+    void flush() {
+        if (!buffer.empty()) file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+        buffer.clear();
+        file.flush();
+    }
 
-    cout << "\n--- Select Restaurant ---" << endl;
-    for (const auto& r : manager.getRestaurants()) {
-         r->displayInfo();
+    void opened(uint32_t session) {
+        begin(EVENT_OPEN);
+        MenuDelta::putVarint(buffer, session);
     }
-    string restId;
-    cout << "Enter Restaurant ID (e.g., R501): ";
-    cin >> restId;
-    selectedRestaurant = manager.findRestaurant(restId);
-    if (!selectedRestaurant) {
-         cout << "Invalid Restaurant ID." << endl;
-         return;
+
+    void input(uint32_t session, const string& line) {
+        begin(EVENT_INPUT);
+        MenuDelta::putVarint(buffer, session);
+        MenuDelta::putString(buffer, line);
     }
 
-    cout << "\n--- Apply Filters (Optional) ---" << endl;
-    
-    cout << "Cuisine (1:Indian, 2:Italian, 3:Chinese, 4:Mexican, 5:Japanese, 0:Any): ";
-    int c;
-    while (!(cin >> c) || c < 0 || c > 5) {
-         cout << "Invalid input. Please enter a number (0-5): ";
-         cin.clear();
-         cin.ignore(numeric_limits<streamsize>::max(), '\n');
-    }
-    // Set string filter based on input
-    if (c == 1) 
-        cuisineFilter = CUISINE_INDIAN;
-    else if (c == 2) 
-        cuisineFilter = CUISINE_ITALIAN;
-    else if (c == 3) 
-        cuisineFilter = CUISINE_CHINESE;
-    else if (c == 4) 
-        cuisineFilter = CUISINE_MEXICAN;
-    else if (c == 5) 
-        cuisineFilter = CUISINE_JAPANESE;
-    else if (c == 0) 
-        cuisineFilter = CUISINE_ANY;
-    
-    cout << "Course (1:Lunch, 2:Dinner, 0:Any): ";
-    int cs;
-    while (!(cin >> cs) || (cs != 0 && cs != 1 && cs != 2)) {
-         cout << "Invalid input. Please enter 0, 1, or 2: ";
-         cin.clear();
-         cin.ignore(numeric_limits<streamsize>::max(), '\n');
-    }
-    if (cs == 1) 
-        courseFilter = COURSE_LUNCH;
-    else if (cs == 2) 
-        courseFilter = COURSE_DINNER;
-    else if (cs == 0) 
-        courseFilter = COURSE_ANY;
-    
-    cout << "Type (1:Veg, 2:Non-Veg, 0:Both): ";
-    int t;
-    while (!(cin >> t) || t < 0 || t > 2) {
-         cout << "Invalid input. Please enter 0, 1, or 2: ";
-         cin.clear();
-         cin.ignore(numeric_limits<streamsize>::max(), '\n');
-    }
-    if (t == 1) 
-        typeFilter = DISH_VEG;
-    else if (t == 2) 
-        typeFilter = DISH_NON_VEG;
-    else if (t == 0) 
-        typeFilter = DISH_BOTH;
-
-    Cart customerCart;
-    // Pass string filters
-    vector<Dish> availableDishes = selectedRestaurant->getMenu().filterDishes(cuisineFilter, courseFilter, typeFilter);
-    
-    cout << "\n--- Available Dishes at " << selectedRestaurant->getName() << " ---" << endl;
-    if (availableDishes.empty()) {
-         cout << "No dishes match your filters." << endl;
-         return;
+    void closed(uint32_t session) {
+        begin(EVENT_CLOSE);
+        MenuDelta::putVarint(buffer, session);
     }
-    for (const auto& dish : availableDishes) {
-         dish.display();
+
+    void payment(const string& key, const PaymentResult& result) {
+        begin(EVENT_PAYMENT);
+        MenuDelta::putString(buffer, key);
+        buffer.push_back(result.success ? 1 : 0);
+        MenuDelta::putVarint(buffer, static_cast<uint64_t>(result.attempts));
+        MenuDelta::putString(buffer, result.reference);
+        MenuDelta::putString(buffer, result.message);
     }
-    
-    string dishInput;
-    cout << "Enter dish ID to add (e.g., D257) (or 'DONE'): ";
-    cin.ignore(); 
-    
-    getline(cin, dishInput);
-    if (!dishInput.empty() && dishInput.back() == '\r') {
-         dishInput.pop_back();
+
+    void timer(TimerId id) {
+        begin(EVENT_TIMER);
+        buffer.push_back(id);
     }
 
-    while (dishInput != "DONE") 
-    {
-        Dish* foundDish = nullptr;
+    uint64_t getEvents() const { return events; }
+};
 
-        for (auto& d : availableDishes) {
-            if (d.getId() == dishInput) {
-                foundDish = &d;
-                break;
-            }
+const char* const TraceRecorder::MAGIC = "FMTRACE1";
+
+// Multiplexes many sessions on one thread. Each feed runs the session until
+// it needs the next line and hands back everything it printed. Lines that
+// arrive while a session waits on its payment are held and replayed in order.
+//
+// In a deterministic run the engine also owns the sim clock: each call moves
+// it to the real time elapsed and fires any timers that came due. A recorder,
+// if attached, sees every input in the order the engine acted on it. While
+// replaying, the replayer sets the clock and fires timers itself.
+class SessionEngine {
+private:
+    struct Slot {
+        unique_ptr<Session> session;
+        vector<string> held;
+        bool closing = false; // closed mid-payment; dropped once the payment settles
+    };
+
+    SystemManager& manager;
+    unordered_map<uint32_t, Slot> sessions;
+    vector<uint32_t> waiting;
+    uint32_t nextId = 1;
+    TraceRecorder* recorder = nullptr;
+    bool replaying = false;
+    long long timerDueAt[TIMER_COUNT] = {};
+    uint64_t outputHash = 14695981039346656037ull; // FNV-1a over everything printed, deterministic runs only
+
+    // Sessions print through cout; while one runs, cout writes into its output
+    template <class Step>
+    void capture(string& output, Step step) {
+        ostringstream out;
+        streambuf* console = cout.rdbuf(out.rdbuf());
+        step();
+        cout.rdbuf(console);
+        string text = out.str();
+        if (RunContext::instance().isDeterministic()) {
+            for (unsigned char ch : text) outputHash = (outputHash ^ ch) * 1099511628211ull;
         }
+        output += text;
+    }
 
-        if (foundDish) {
-            customerCart.addItem(*foundDish);
-        } else {
-            cout << "Dish not found." << endl;
+    void advanceClock() {
+        RunContext& ctx = RunContext::instance();
+        if (replaying) return;
+        bool deterministic = ctx.isDeterministic();
+        long long now = deterministic ? ctx.getStartMicros() + ctx.realElapsedMicros() : Clock::nowMicros();
+        if (deterministic) ctx.setSimNow(now);
+        for (int t = 0; t < TIMER_COUNT; t++) {
+            if (now < timerDueAt[t] || (TIMER_OWN_THREAD[t] && !deterministic)) continue;
+            if (timerDueAt[t]) {
+                manager.fireTimer(static_cast<TimerId>(t));
+                if (recorder) recorder->timer(static_cast<TimerId>(t));
+            }
+            timerDueAt[t] = now + TIMER_INTERVAL_MS[t] * 1000LL;
         }
+    }
 
-        cout << "Enter dish ID to add (e.g., D257) (or 'DONE'): ";
-        getline(cin, dishInput);
-
-        if (!dishInput.empty() && dishInput.back() == '\r') {
-            dishInput.pop_back();
+    void replayHeld(uint32_t id, Slot& slot, string& output) {
+        vector<string> held;
+        held.swap(slot.held);
+        for (size_t i = 0; i < held.size(); i++) {
+            if (slot.session->isWaiting() || slot.session->isClosed()) {
+                if (slot.session->isWaiting()) slot.held.assign(held.begin() + i, held.end());
+                break;
+            }
+            capture(output, [&] { slot.session->onInput(held[i]); });
         }
+        if (slot.session->isWaiting()) waiting.push_back(id);
     }
 
+public:
+    explicit SessionEngine(SystemManager& m) : manager(m) {}
+    ~SessionEngine() {
+        string discarded;
+        capture(discarded, [&] { sessions.clear(); });
+    }
 
-    if (customerCart.isEmpty()) {
-         cout << "Order cancelled." << endl;
-         return;
+    void setRecorder(TraceRecorder* r) { recorder = r; }
+    // Lets an idle front end keep timers firing between inputs
+    void tick() { advanceClock(); }
+    void setReplaying(bool on) { replaying = on; }
+    uint64_t getOutputHash() const { return outputHash; }
+
+    uint32_t open(string& output) {
+        advanceClock();
+        uint32_t id = nextId++;
+        if (recorder) recorder->opened(id);
+        Slot& slot = sessions[id];
+        slot.session.reset(new Session(manager));
+        capture(output, [&] { slot.session->start(); });
+        return id;
     }
 
-    Order* newOrder = new Order(customer, selectedRestaurant, customerCart);
-    cout << "\n--- Offers ---" << endl;
-    for (const auto& offer : manager.getOffers()) {
-         cout << "- Code: " << offer.getCode() << endl;
+    // Returns false once the session has quit (or never existed)
+    bool feed(uint32_t id, const string& line, string& output) {
+        advanceClock();
+        auto it = sessions.find(id);
+        if (it == sessions.end() || it->second.closing) return false;
+        if (recorder) recorder->input(id, line);
+        Slot& slot = it->second;
+        if (slot.session->isWaiting()) {
+            slot.held.push_back(line);
+            return true;
+        }
+        capture(output, [&] { slot.session->onInput(line); });
+        if (slot.session->isWaiting()) waiting.push_back(id);
+        if (slot.session->isClosed()) {
+            sessions.erase(it);
+            return false;
+        }
+        return true;
     }
-    string promo;
-    cout << "Enter promo code (or 'NONE'): ";
-    cin >> promo;
-    if (promo != "NONE") 
-    {
-        const Offer* foundOffer = nullptr;
 
-        for (const auto& o : manager.getOffers()) {
-            if (o.getCode() == promo) {
-                foundOffer = &o;
-                break;
+    // Resumes every session whose payment has settled and collects what they printed
+    size_t poll(vector<pair<uint32_t, string>>& ready) {
+        advanceClock();
+        size_t before = ready.size();
+        vector<uint32_t> pending;
+        pending.swap(waiting);
+        for (uint32_t id : pending) {
+            auto it = sessions.find(id);
+            if (it == sessions.end()) continue;
+            Slot& slot = it->second;
+            string key, output;
+            PaymentResult result;
+            if (!slot.session->paymentReady(key, result)) {
+                waiting.push_back(id);
+                continue;
             }
+            if (recorder) recorder->payment(key, result); // closed sessions too, so a replay can settle them
+            if (slot.closing) {
+                capture(output, [&] { sessions.erase(it); });
+                continue;
+            }
+            capture(output, [&] { slot.session->resume(); });
+            replayHeld(id, slot, output);
+            ready.emplace_back(id, output);
+            if (slot.session->isClosed()) sessions.erase(it);
         }
+        return ready.size() - before;
+    }
 
-        if (foundOffer) {
-            newOrder->applyOffer(*foundOffer, customer);
-        } else {
-            cout << "Invalid promo code." << endl;
+    // Drops a session mid-flow, giving back anything its checkout held. One
+    // waiting on a payment is parked instead, so the engine never blocks on
+    // the gateway; poll() drops it once the payment settles.
+    void close(uint32_t id) {
+        auto it = sessions.find(id);
+        if (it == sessions.end() || it->second.closing) return;
+        advanceClock();
+        if (recorder) recorder->closed(id);
+        if (it->second.session->isWaiting()) {
+            it->second.closing = true;
+            it->second.held.clear();
+            return;
         }
+        string discarded;
+        capture(discarded, [&] { sessions.erase(id); });
     }
 
-
-    newOrder->displayDetails();
-    cout << "\n--- Payment ---" << endl;
-    cout << "1. UPI\n2. COD\nSelect payment mode: ";
-    
-    int paymentChoice;
-    while (!(cin >> paymentChoice) || (paymentChoice != 1 && paymentChoice != 2)) 
-    {
-         cout << "Invalid choice. Please enter 1 for UPI or 2 for COD: ";
-         cin.clear();
-         cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    bool isOpen(uint32_t id) const {
+        auto it = sessions.find(id);
+        return it != sessions.end() && !it->second.closing;
+    }
+    bool isWaiting(uint32_t id) const {
+        auto it = sessions.find(id);
+        return it != sessions.end() && it->second.session->isWaiting();
     }
+    bool hasWaiting() const { return !waiting.empty(); }
+    size_t size() const { return sessions.size(); }
+};
 
-    Payment* paymentMethod = nullptr;
-    if (paymentChoice == 1) 
-        paymentMethod = new UPIPayment();
-    else if (paymentChoice == 2) 
-        paymentMethod = new COD();
-    else 
-        { 
-            cout << "Invalid payment mode." << endl;
-            delete newOrder; 
-            return; 
-        } 
-
-    if (paymentMethod->processPayment(newOrder->getFinalAmount())) {
-         cout << "Payment successful via " << paymentMethod->getMode() << "!" << endl;
-         manager.placeOrder(newOrder);
-    } 
-    else {
-         cout << "Payment failed. Order cancelled." << endl;
-         delete newOrder;
-         return;
+// --- SOCKET FRONT END ---
+// -------------------------------------------------------------
+// Serves the session engine over loopback TCP or a Unix socket. Each
+// connection is one session. A request is one line, exactly what the console
+// would type. Each response is the text the session printed for that line,
+// framed as "<byte count>\n<bytes>" so pipelined replies can be told apart.
+// The greeting arrives as an unsolicited first frame.
+#ifdef __linux__
+class SocketServer {
+private:
+    static const size_t MAX_LINE = 4096;
+    static const size_t MAX_BUFFERED = 64 * 1024;
+    static const int MAX_EVENTS = 256;
+    static const int MAX_IOV = 64;
+
+    struct Connection {
+        int fd = -1;
+        uint32_t session = 0;
+        string in;              // bytes received that are not yet a whole request
+        string partial;         // what the session printed before parking on a payment
+        deque<string> out;      // frame headers and bodies, written as they are
+        size_t outOffset = 0;   // bytes of out.front() already sent
+        bool closing = false;   // flush what is queued, then hang up
+        bool readDone = false;  // peer shut its side; answer what it sent, then hang up
+        bool wantWrite = false;
+    };
+
+    SessionEngine engine;
+    int epfd = -1;
+    vector<int> listeners;
+    unordered_map<int, Connection> connections;
+    unordered_map<uint32_t, int> bySession;
+    string unixPath;
+    int unixListener = -1;
+    uint16_t tcpPort = 0;
+    atomic<bool> stopping{false};
+
+    static bool setNonBlocking(int fd) {
+        int flags = fcntl(fd, F_GETFL, 0);
+        return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
     }
-    delete paymentMethod;
 
-    // Pass string constant
-    manager.updateOrderStatus(newOrder->getId(), STATUS_PREPARING);
-    Chat chat(newOrder->getId());
-    chat.autoGenerateMessage(STATUS_PREPARING); // Pass string constant
+    bool addListener(int fd) {
+        if (listen(fd, 512) != 0 || !setNonBlocking(fd)) {
+            close(fd);
+            return false;
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+        listeners.push_back(fd);
+        return true;
+    }
 
-    cout << "\n[Simulating Delivery Process...]" << endl;
-    manager.updateOrderStatus(newOrder->getId(), STATUS_OUT_FOR_DELIVERY);
-    chat.autoGenerateMessage(STATUS_OUT_FOR_DELIVERY);
+    bool isListener(int fd) const {
+        return find(listeners.begin(), listeners.end(), fd) != listeners.end();
+    }
 
-    chat.sendMessage(customer->getName(), "Hi, please come to gate 3.");
-    chat.sendMessage("DeliveryPartner", "Sure, on the way, arriving in 5 mins!");
-    chat.displayHistory();
+    void watch(Connection& c, bool write, bool force = false) {
+        if (c.wantWrite == write && !force) return;
+        c.wantWrite = write;
+        uint32_t events = 0;
+        if (!c.readDone) events |= EPOLLIN; // a half-closed socket stays readable forever
+        if (write) events |= EPOLLOUT;
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = c.fd;
+        epoll_ctl(epfd, EPOLL_CTL_MOD, c.fd, &ev);
+    }
 
-    manager.updateOrderStatus(newOrder->getId(), STATUS_DELIVERED);
-    chat.autoGenerateMessage(STATUS_DELIVERED);
+    void queueFrame(Connection& c, string body) {
+        c.out.push_back(to_string(body.size()) + "\n");
+        if (!body.empty()) c.out.push_back(move(body));
+    }
 
-    int tip;
-    cout << "\n--- Tip Delivery Partner ---" << endl;
-    cout << "Tip (e.g., 5, 10, 20): $";
-    while (!(cin >> tip) || tip < 0) {
-         cout << "Invalid amount. Please enter a positive number (or 0): $";
-         cin.clear();
-         cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    void accepted(int fd, bool tcp) {
+        if (tcp) {
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev);
+
+        Connection& c = connections[fd];
+        c.fd = fd;
+        string greeting;
+        c.session = engine.open(greeting);
+        bySession[c.session] = fd;
+        queueFrame(c, move(greeting));
+        flush(c);
     }
-    newOrder->addTip(tip);
-    cout << "Tip of $" << tip << " added to final bill." << endl;
 
-    int foodRating, deliveryRating;
-    string feedback;
-    cout << "\n--- Rate Your Experience (1-5 Stars) ---" << endl;
-    cout << "Food Rating: ";
+    void drop(Connection& c) {
+        int fd = c.fd;
+        epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr);
+        close(fd);
+        bySession.erase(c.session);
+        engine.close(c.session);
+        connections.erase(fd);
+    }
 
-    while (!(cin >> foodRating) || foodRating < 1 || foodRating > 5) {
-         cout << "Invalid rating. Please enter a number between 1 and 5: ";
-         cin.clear();
-         cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    // Writes queued frames straight from their own buffers; false if the connection is gone
+    bool flush(Connection& c) {
+        while (!c.out.empty()) {
+            iovec iov[MAX_IOV];
+            int count = 0;
+            for (auto it = c.out.begin(); it != c.out.end() && count < MAX_IOV; ++it, ++count) {
+                size_t skip = count ? 0 : c.outOffset;
+                iov[count].iov_base = const_cast<char*>(it->data()) + skip;
+                iov[count].iov_len = it->size() - skip;
+            }
+            ssize_t n = writev(c.fd, iov, count);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    watch(c, true);
+                    return true;
+                }
+                drop(c);
+                return false;
+            }
+            size_t sent = static_cast<size_t>(n);
+            while (sent > 0) {
+                size_t left = c.out.front().size() - c.outOffset;
+                if (sent < left) {
+                    c.outOffset += sent;
+                    break;
+                }
+                sent -= left;
+                c.out.pop_front();
+                c.outOffset = 0;
+            }
+        }
+        watch(c, false);
+        if (c.closing) {
+            drop(c);
+            return false;
+        }
+        return true;
     }
-    
-    cout << "Delivery Rating: ";
-    while (!(cin >> deliveryRating) || deliveryRating < 1 || deliveryRating > 5) {
-         cout << "Invalid rating. Please enter a number between 1 and 5: ";
-         cin.clear();
-         cin.ignore(numeric_limits<streamsize>::max(), '\n');
+
+    // Feeds every complete line to the session, stopping while it waits on a payment
+    void process(Connection& c) {
+        size_t start = 0, nl;
+        while (!c.closing && !engine.isWaiting(c.session) && (nl = c.in.find('\n', start)) != string::npos) {
+            string output;
+            bool open = engine.feed(c.session, c.in.substr(start, nl - start), output);
+            start = nl + 1;
+            if (engine.isWaiting(c.session)) {
+                c.partial = move(output);
+                break;
+            }
+            queueFrame(c, move(output));
+            if (!open) c.closing = true;
+        }
+        c.in.erase(0, start);
+        bool lineTooLong = !engine.isWaiting(c.session) && c.in.size() > MAX_LINE;
+        if (lineTooLong || c.in.size() > MAX_BUFFERED) c.closing = true;
+        if (c.readDone && !engine.isWaiting(c.session)) c.closing = true; // every whole line is answered
     }
 
-    cout << "Write feedback (one line): ";
-    cin.ignore();
-    getline(cin, feedback);
+    void readFrom(Connection& c) {
+        char buf[16 * 1024];
+        while (true) {
+            ssize_t n = read(c.fd, buf, sizeof(buf));
+            if (n > 0) {
+                c.in.append(buf, static_cast<size_t>(n));
+                continue;
+            }
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+            if (n < 0) {
+                drop(c); // the socket failed
+                return;
+            }
+            // The peer is done sending; requests it pipelined before that still get answers
+            c.readDone = true;
+            watch(c, c.wantWrite, true);
+            break;
+        }
+        process(c);
+        flush(c);
+    }
 
-    if (!feedback.empty() && feedback.back() == '\r') {
-         feedback.pop_back();
+    void resumeSettled() {
+        vector<pair<uint32_t, string>> ready;
+        engine.poll(ready);
+        for (auto& r : ready) {
+            auto it = bySession.find(r.first);
+            if (it == bySession.end()) continue;
+            Connection& c = connections[it->second];
+            queueFrame(c, move(c.partial) + r.second);
+            c.partial.clear();
+            if (!engine.isOpen(c.session)) c.closing = true;
+            process(c);
+            flush(c);
+        }
     }
 
-    Rating().apply(newOrder, manager, foodRating, deliveryRating, feedback);
+public:
+    explicit SocketServer(SystemManager& manager) : engine(manager) {
+        epfd = epoll_create1(EPOLL_CLOEXEC);
+    }
 
-    cout << "\nThank you for ordering from FoodMate! Have a great day!" << endl;
-}
+    ~SocketServer() {
+        for (auto& entry : connections) close(entry.first);
+        for (int fd : listeners) close(fd);
+        if (epfd >= 0) close(epfd);
+        if (!unixPath.empty()) unlink(unixPath.c_str());
+    }
 
-void runOwnerFlow(RestaurantOwner* owner, SystemManager& manager) 
-{
-    if (!owner) return;
-    
-    cout << "\n### Restaurant Owner Dashboard ###" << endl;
-    owner->viewProfile();
-    
-    // 1. Safety Check
-    if (owner->getOwnedRestaurants().empty()) {
-        cout << "\nYou do not own any restaurants to manage." << endl;
-        return;
+    // Port 0 picks a free port; see getPort()
+    bool listenTcp(uint16_t port) {
+        int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return false;
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        socklen_t len = sizeof(addr);
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            getsockname(fd, reinterpret_cast<sockaddr*>(&addr), &len) != 0) {
+            close(fd);
+            return false;
+        }
+        tcpPort = ntohs(addr.sin_port);
+        return addListener(fd);
     }
 
-    // 2. Ask which restaurant to manage
-    string restIdToManage;
-    cout << "\nEnter the ID of the restaurant you want to manage (e.g., R501): ";
-    cin >> restIdToManage;
+    bool listenUnix(const string& path) {
+        sockaddr_un addr{};
+        if (path.size() >= sizeof(addr.sun_path)) return false;
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return false;
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        unlink(path.c_str());
+        if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) {
+            close(fd);
+            return false;
+        }
+        unixPath = path;
+        unixListener = fd;
+        return addListener(fd);
+    }
 
-    // 3. Find the selected restaurant *in their owned list*
-    Restaurant* myRest = nullptr;
-    for (Restaurant* r : owner->getOwnedRestaurants()) {
-        if (r->getId() == restIdToManage) {
-            myRest = r;
-            break;
+    // Runs the event loop on the calling thread until stop()
+    void run() {
+        epoll_event events[MAX_EVENTS];
+        while (!stopping.load(memory_order_relaxed)) {
+            // A parked payment is checked every millisecond; otherwise only wake to notice stop()
+            int n = epoll_wait(epfd, events, MAX_EVENTS, engine.hasWaiting() ? 1 : 100);
+            for (int i = 0; i < n; i++) {
+                int fd = events[i].data.fd;
+                if (isListener(fd)) {
+                    int client;
+                    while ((client = accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                        accepted(client, fd != unixListener);
+                    }
+                    continue;
+                }
+                auto it = connections.find(fd);
+                if (it == connections.end()) continue;
+                Connection& c = it->second;
+                if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                    drop(c);
+                    continue;
+                }
+                if ((events[i].events & EPOLLOUT) && !flush(c)) continue;
+                if (events[i].events & EPOLLIN) readFrom(c);
+            }
+            if (engine.hasWaiting()) resumeSettled();
+            engine.tick();
         }
     }
 
-    // 4. Handle if ID is wrong
-    if (myRest == nullptr) {
-        cout << "Error: Restaurant ID not found in your portfolio." << endl;
-        return;
+    // Only touches a lock-free atomic, so a signal handler may call it
+    void stop() { stopping.store(true, memory_order_relaxed); }
+
+    uint16_t getPort() const { return tcpPort; }
+    size_t connectionCount() const { return connections.size(); }
+    SessionEngine& getEngine() { return engine; }
+};
+
+// --- LOAD CLIENT ---
+// -------------------------------------------------------------
+// Drives many pipelined connections against a running server and reports
+// throughput and tail latency. Each connection logs in as the seed customer
+// and then browses: flips the restaurant ranking and runs a dish search.
+class LoadClient {
+private:
+    struct Link {
+        int fd = -1;
+        string in;
+        deque<long long> sentAt;   // steady-clock nanos per request still in flight
+        size_t next = 0;           // position in the browse script
+        int framesToSkip = 0;      // greeting and login replies are not measured
+    };
+
+    static long long nowNanos() {
+        return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
     }
-    
-    cin.ignore(numeric_limits<streamsize>::max(), '\n'); 
 
-    cout << "\nManaging Menu for: " << myRest->getName() << endl;
-    
-    cout << "1. Add Dish\n2. View Menu\n3. Back\nSelect option: ";
-    int choice;
-    while (!(cin >> choice) || choice < 1 || choice > 3) {
-        cout << "Invalid choice. Please enter 1, 2, or 3: ";
-        cin.clear();
-        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    // Pops one whole frame off the front of the buffer
+    static bool takeFrame(string& in) {
+        size_t nl = in.find('\n');
+        if (nl == string::npos) return false;
+        size_t len = strtoul(in.c_str(), nullptr, 10);
+        if (in.size() < nl + 1 + len) return false;
+        in.erase(0, nl + 1 + len);
+        return true;
     }
-    
-    if (choice == 1) 
-    {
-        string n; double p; int t_in, c_in, cs_in;
-        cout << "Dish Name: "; 
-       cin.ignore(numeric_limits<streamsize>::max(), '\n');
-        getline(cin, n);
-        if (!n.empty() && n.back() == '\r') {
-            n.pop_back();
+
+    static bool sendAll(int fd, const string& data) {
+        size_t done = 0;
+        while (done < data.size()) {
+            ssize_t n = write(fd, data.data() + done, data.size() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                this_thread::yield();
+                continue;
+            }
+            if (n <= 0) return false;
+            done += static_cast<size_t>(n);
         }
-        
-        cout << "Price: $";
-        while (!(cin >> p) || p <= 0) 
-        {
-            cout << "Invalid input. Please enter a valid price (e.g., 12.50): $";
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        return true;
+    }
+
+public:
+    string unixPath;
+    uint16_t port = 0;
+    int connections = 50;
+    int depth = 8;
+    int seconds = 5;
+
+    int connectOne() const {
+        int fd;
+        if (!unixPath.empty()) {
+            sockaddr_un addr{};
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, unixPath.c_str(), sizeof(addr.sun_path) - 1);
+            fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) { close(fd); fd = -1; }
+        } else {
+            sockaddr_in addr{};
+            addr.sin_family = AF_INET;
+            addr.sin_port = htons(port);
+            addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (fd >= 0 && connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0) { close(fd); fd = -1; }
+            int one = 1;
+            if (fd >= 0) setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
         }
+        return fd;
+    }
 
-        cout << "Type (1:Veg, 2:Non-Veg): ";
-        while (!(cin >> t_in) || (t_in != 1 && t_in != 2)) 
-        {
-            cout << "Invalid input. Please enter 1 for Veg or 2 for Non-Veg: ";
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    bool run() {
+        static const char* const LOGIN = "a\n1\nU1001\npass\n";
+        static const char* const BROWSE[] = {"S\n", "F\n", "pizza\n"};
+        const int BROWSE_STEPS = 3;
+
+        int epfd = epoll_create1(EPOLL_CLOEXEC);
+        vector<Link> links(connections);
+        for (int i = 0; i < connections; i++) {
+            Link& l = links[i];
+            l.fd = connectOne();
+            if (l.fd < 0 || !sendAll(l.fd, LOGIN)) {
+                cout << "Could not connect to the server." << endl;
+                for (Link& open : links) if (open.fd >= 0) close(open.fd);
+                close(epfd);
+                return false;
+            }
+            l.framesToSkip = 5;
+            fcntl(l.fd, F_SETFL, fcntl(l.fd, F_GETFL, 0) | O_NONBLOCK);
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.u32 = static_cast<uint32_t>(i);
+            epoll_ctl(epfd, EPOLL_CTL_ADD, l.fd, &ev);
         }
-        string dishT = (t_in == 1) ? DISH_VEG : DISH_NON_VEG; 
 
-        cout << "Cuisine (0:Indian, 1:Italian, 2:Chinese, 3:Mexican, 4:Japanese, 5:Other): ";
-        while (!(cin >> c_in) || c_in < 0 || c_in > 5) 
-        {
-            cout << "Invalid input. Please enter a number between 0 and 5: ";
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+        vector<long long> latencies;
+        epoll_event events[256];
+        char buf[64 * 1024];
+        bool ok = true;
+
+        // Keep `depth` requests in flight, written as one batch
+        auto topUp = [&](Link& l, long long now) {
+            string batch;
+            while (static_cast<int>(l.sentAt.size()) < depth) {
+                batch += BROWSE[l.next];
+                l.next = (l.next + 1) % BROWSE_STEPS;
+                l.sentAt.push_back(now);
+            }
+            if (!batch.empty() && !sendAll(l.fd, batch)) ok = false;
+        };
+
+        // Sign every link in before the clock starts: password checks are
+        // deliberately slow and would otherwise stall the first second of browsing
+        int signingIn = connections;
+        long long loginDeadline = nowNanos() + 30 * 1000000000LL;
+        while (ok && signingIn > 0 && nowNanos() < loginDeadline) {
+            int n = epoll_wait(epfd, events, 256, 100);
+            for (int e = 0; e < n; e++) {
+                Link& l = links[events[e].data.u32];
+                ssize_t got;
+                while ((got = read(l.fd, buf, sizeof(buf))) > 0) l.in.append(buf, static_cast<size_t>(got));
+                if (got == 0) ok = false;
+                while (l.framesToSkip > 0 && takeFrame(l.in))
+                    if (--l.framesToSkip == 0) signingIn--;
+            }
         }
-        // Map int to string constant
-        string dishC;
-        switch (c_in) 
-        {
-            case 0: dishC = CUISINE_INDIAN; break;
-            case 1: dishC = CUISINE_ITALIAN; break;
-            case 2: dishC = CUISINE_CHINESE; break;
-            case 3: dishC = CUISINE_MEXICAN; break;
-            case 4: dishC = CUISINE_JAPANESE; break;
-            default: dishC = CUISINE_OTHER;
+        if (signingIn > 0) ok = false;
+
+        long long start = nowNanos(), deadline = start + seconds * 1000000000LL;
+        if (ok) for (Link& l : links) topUp(l, start);
+        while (ok && nowNanos() < deadline) {
+            int n = epoll_wait(epfd, events, 256, 100);
+            for (int e = 0; e < n; e++) {
+                Link& l = links[events[e].data.u32];
+                ssize_t got;
+                while ((got = read(l.fd, buf, sizeof(buf))) > 0) l.in.append(buf, static_cast<size_t>(got));
+                if (got == 0) ok = false;
+                long long now = nowNanos();
+                while (takeFrame(l.in)) {
+                    if (!l.sentAt.empty()) {
+                        latencies.push_back(now - l.sentAt.front());
+                        l.sentAt.pop_front();
+                    }
+                }
+                topUp(l, now);
+            }
         }
+        double elapsed = (nowNanos() - start) / 1e9;
+        for (Link& l : links) close(l.fd);
+        close(epfd);
+
+        sort(latencies.begin(), latencies.end());
+        auto pct = [&](double p) {
+            if (latencies.empty()) return 0.0;
+            return latencies[min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))] / 1000.0;
+        };
+        cout << "\n--- Load Test (" << connections << " connections, pipeline depth " << depth << ") ---" << endl;
+        cout << "Requests: " << latencies.size() << " in " << fixed << setprecision(2) << elapsed << "s = "
+             << setprecision(0) << latencies.size() / max(elapsed, 1e-9) << " req/s" << endl;
+        cout << "Latency (us): p50 " << setprecision(1) << pct(0.50) << ", p99 " << pct(0.99) << ", p999 " << pct(0.999)
+             << ", max " << (latencies.empty() ? 0.0 : latencies.back() / 1000.0) << endl;
+        return ok;
+    }
+};
 
-        cout << "Course (0:Breakfast, 1:Brunch, 2:Lunch, 3:Snacks, 4:Dinner, 5:Dessert, 6:Any): ";
-        while (!(cin >> cs_in) || cs_in < 0 || cs_in > 6) 
-        {
-            cout << "Invalid input. Please enter a number between 0 and 6: ";
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+SocketServer* signalTarget = nullptr;
+volatile sig_atomic_t watching = 0;
+
+// `--watch-orders [--oldest]` prints order events as the app publishes them,
+// until Ctrl-C. Any number of watchers can run side by side.
+int runOrderWatcher(const string& stream, bool fromOldest) {
+    OrderEventReader reader;
+    if (!reader.attach(stream, fromOldest)) {
+        cout << "No order stream at " << stream << "; start the app or --serve first." << endl;
+        return 1;
+    }
+    cout << "Watching " << stream << ". Press Ctrl-C to stop." << endl;
+    watching = 1;
+    signal(SIGINT, [](int) { watching = 0; });
+
+    uint64_t shown = 0, seq = 0, reported = 0;
+    const OrderEvent* e = nullptr;
+    ostringstream line;
+    while (watching) {
+        ReadResult result = reader.next(e, seq);
+        if (result == READ_EMPTY) {
+            cout.flush();
+            this_thread::sleep_for(chrono::milliseconds(1));
+            continue;
         }
-        // Map int to string constant
-        string dishCS;
-        switch (cs_in) 
-        {
-            case 0: dishCS = COURSE_BREAKFAST; break;
-            case 1: dishCS = COURSE_BRUNCH; break;
-            case 2: dishCS = COURSE_LUNCH; break;
-            case 3: dishCS = COURSE_SNACKS; break;
-            case 4: dishCS = COURSE_DINNER; break;
-            case 5: dishCS = COURSE_DESSERT; break;
-            default: dishCS = COURSE_ANY;
+        if (result == READ_RESTARTED) {
+            cout << "[stream restarted]" << endl;
+            continue;
         }
-        
-        myRest->getMenu().addDish({n, p, dishT, dishC, dishCS});
-        cout << "Dish '" << n << "' added to the menu." << endl;
-    } 
-    
-    else if (choice == 2) 
-    {
-        cout << "\n--- Current Menu ---" << endl;
-        for (const auto& dish : myRest->getMenu().getAllDishes()) {
-            dish.display();
+        if (result == READ_EVENT) {
+            line.str("");
+            line << "#" << seq << " " << ORDER_EVENT_NAMES[e->type <= ORDER_RATED ? e->type : 0] << " O" << e->orderNo
+                 << " U" << e->customerNo << " R" << e->restaurantNo;
+            if (e->partnerNo) line << " partner U" << e->partnerNo;
+            line << " $" << Money::fromCents(e->amountCents) << " " << *ORDER_STATUSES[e->status < ORDER_STATUS_COUNT ? e->status : 0];
+            if (e->type == ORDER_RATED) line << " food " << int(e->foodStars) << "/5 delivery " << int(e->deliveryStars) << "/5";
+            if (reader.done()) {
+                cout << line.str() << "\n";
+                shown++;
+                continue;
+            }
         }
+        cout << "[gap: missed " << reader.getMissed() - reported << " events]" << endl;
+        reported = reader.getMissed();
     }
+    cout << "\nShowed " << shown << " events, missed " << reader.getMissed() << "." << endl;
+    return 0;
 }
 
-void runPartnerFlow(DeliveryPartner* partner, SystemManager& manager) 
-{
-    if (!partner) return;
-    
-    cout << "\n### Delivery Partner Dashboard ###" << endl;
-    partner->viewProfile();
-    cout << "\nNo new delivery assignments in the current simulation." << endl;
+// `--serve` runs the socket server until Ctrl-C. `--load` runs the load client;
+// with no --port/--unix it first starts a server on a background thread.
+int runNetworkMode(int argc, char* argv[], TraceRecorder* recorder) {
+    string mode = argv[1], unixPath;
+    int port = -1;
+    if (mode != "--serve" && mode != "--load") {
+        cout << "Usage: " << argv[0] << " [--serve|--load] [--port N] [--unix PATH]"
+             << " [--connections N] [--depth N] [--seconds N]\n       " << argv[0] << " --bench-login [users]\n       "
+             << argv[0] << " --bench-quotes [carts]\n       "
+             << argv[0] << " --check-menu-deltas [edits]\n       "
+             << argv[0] << " [--seed N] [--record FILE] | --replay FILE\n       "
+             << argv[0] << " [--kdf-iterations N] ...\n       " << argv[0]
+             << " [--stream NAME] --watch-orders [--oldest]" << endl;
+        return 1;
+    }
+    LoadClient client;
+    for (int i = 2; i + 1 < argc; i += 2) {
+        string flag = argv[i], value = argv[i + 1];
+        if (flag == "--port") port = atoi(value.c_str());
+        else if (flag == "--unix") unixPath = value;
+        else if (flag == "--connections") client.connections = max(1, atoi(value.c_str()));
+        else if (flag == "--depth") client.depth = max(1, atoi(value.c_str()));
+        else if (flag == "--seconds") client.seconds = max(1, atoi(value.c_str()));
+        else {
+            cout << "Unknown option " << flag << endl;
+            return 1;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    if (mode == "--load" && (port >= 0 || !unixPath.empty())) {
+        client.port = static_cast<uint16_t>(max(port, 0));
+        client.unixPath = unixPath;
+        return client.run() ? 0 : 1;
+    }
+
+    SystemManager manager;
+    SocketServer server(manager);
+    server.getEngine().setRecorder(recorder);
+    bool listening = (mode == "--load") ? server.listenTcp(0)
+                   : unixPath.empty() ? server.listenTcp(static_cast<uint16_t>(port < 0 ? 7070 : port))
+                   : server.listenUnix(unixPath) && (port < 0 || server.listenTcp(static_cast<uint16_t>(port)));
+    if (!listening) {
+        cout << "Could not open the listening socket." << endl;
+        return 1;
+    }
+
+    if (mode == "--load") {
+        client.port = server.getPort();
+        thread serving([&] { server.run(); });
+        bool ok = client.run();
+        server.stop();
+        serving.join();
+        return ok ? 0 : 1;
+    }
+
+    cout << "Serving FoodMate on " << (unixPath.empty() ? "127.0.0.1:" + to_string(server.getPort()) : unixPath)
+         << ". Press Ctrl-C to stop." << endl;
+    signalTarget = &server;
+    signal(SIGINT, [](int) { signalTarget->stop(); });
+    server.run();
+    signalTarget = nullptr;
+    cout << "\nServer stopped." << endl;
+    if (recorder) {
+        recorder->flush();
+        cout << "Recorded " << recorder->getEvents() << " events (seed " << RunContext::instance().getSeed()
+             << ", output hash " << hex << server.getEngine().getOutputHash() << dec << ")" << endl;
+    }
+    return 0;
 }
+#endif
 
-User* handleLoginOrRegister(SystemManager& manager, char userType) 
-{
-    string id, pass, name, extra, address;
-    User* currentUser = nullptr;
+// --- MAIN APPLICATION FLOW ---
+// -------------------------------------------------------------
+// `--bench-login [users]` times the two halves of a login separately, each
+// for 3 seconds. Token path: issue, check and revoke a token for a random one
+// of `users` customers; they are registered at a work factor of 1, since their
+// passwords are never checked. Password path: full sign-ins (PBKDF2 check +
+// token issue) for a few customers registered at the current work factor.
+int runLoginBenchmark(int users) {
+    SystemManager manager;
+    uint32_t workFactor = Credential::getWorkFactor();
+    Credential::setWorkFactor(1);
+    vector<User*> rush;
+    for (int i = 0; i < users; i++) {
+        User* u = new Customer("Rush" + to_string(i), "pw-" + to_string(i), "Street " + to_string(i));
+        manager.addUser(u);
+        rush.push_back(u);
+    }
+    Credential::setWorkFactor(workFactor);
+    const int SIGN_IN_USERS = 16;
+    vector<string> ids;
+    for (int i = 0; i < SIGN_IN_USERS; i++) {
+        User* u = new Customer("Early" + to_string(i), "pw-" + to_string(i), "Road " + to_string(i));
+        manager.addUser(u);
+        ids.push_back(u->getId());
+    }
 
-    cout << "\n---\n1. Login\n2. Register\nSelect Option: ";
-    int choice;
-    while (!(cin >> choice) || (choice != 1 && choice != 2)) 
-    {
-        cout << "Invalid choice. Please enter 1 or 2: ";
-        cin.clear();
-        cin.ignore(numeric_limits<streamsize>::max(), '\n');
+    mt19937 pick(12345);
+    long long failures = 0;
+    auto timed = [&](const function<bool()>& once, vector<long long>& latencies) {
+        auto start = chrono::steady_clock::now(), deadline = start + chrono::seconds(3);
+        while (chrono::steady_clock::now() < deadline) {
+            auto t0 = chrono::steady_clock::now();
+            if (!once()) failures++;
+            latencies.push_back(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - t0).count());
+        }
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    };
+    vector<long long> tokenTimes, passwordTimes;
+    double tokenElapsed = timed([&] {
+        User* u = rush[pick() % rush.size()];
+        AuthToken token = manager.getTokens().issue(u);
+        bool ok = manager.getTokens().validate(token) == u;
+        manager.getTokens().revoke(token);
+        return ok;
+    }, tokenTimes);
+    double passwordElapsed = timed([&] {
+        size_t i = pick() % ids.size();
+        User* u = nullptr;
+        AuthToken token;
+        bool ok = manager.authenticate(ids[i], "pw-" + to_string(i), ROLE_CUSTOMER, u, token) == AUTH_OK;
+        manager.getTokens().revoke(token);
+        return ok;
+    }, passwordTimes);
+
+    auto report = [](const char* label, vector<long long>& latencies, double elapsed) {
+        sort(latencies.begin(), latencies.end());
+        auto pct = [&](double p) { return latencies[min(latencies.size() - 1, static_cast<size_t>(p * latencies.size()))] / 1000.0; };
+        cout << label << latencies.size() << " in " << fixed << setprecision(2) << elapsed << "s = " << setprecision(0)
+             << latencies.size() / elapsed << "/s, latency (us): p50 " << setprecision(2) << pct(0.50) << ", p99 " << pct(0.99)
+             << ", p999 " << pct(0.999) << endl;
+    };
+    cout << "\n--- Login Benchmark (" << users << " users, " << workFactor << " PBKDF2 iterations) ---" << endl;
+    report("Token checks: ", tokenTimes, tokenElapsed);
+    report("Password sign-ins: ", passwordTimes, passwordElapsed);
+    cout << failures << " failed" << endl;
+    return failures ? 1 : 0;
+}
+
+// `--bench-quotes [carts]` fills a batch with that many random carts from the
+// seeded menus, with the live offers, tips and each address's surge, then
+// quotes it on every core for 3 seconds. A single-threaded pass must agree.
+int runQuoteBenchmark(int carts) {
+    SystemManager manager;
+    vector<Dish> dishes;
+    for (Restaurant* r : manager.getRestaurants()) {
+        for (const Dish& d : r->getMenu().getAllDishes()) dishes.push_back(d);
+    }
+    if (dishes.empty()) return 1;
+
+    mt19937 pick(12345);
+    QuoteBatch batch;
+    int offerCount = static_cast<int>(manager.getOffers().size());
+    for (int i = 0; i < carts; i++) {
+        CartItems items;
+        for (int lines = 1 + pick() % 5; lines > 0; lines--) items[dishes[pick() % dishes.size()]] += 1 + pick() % 3;
+        int offer = static_cast<int>(pick() % (offerCount + 1)) - 1;
+        batch.addCart(items, offer, Money::fromCents(pick() % 3000), Money::fromCents(pick() % 500),
+                      manager.surgeAt("Street " + to_string(i)));
     }
 
-    if (choice == 2) 
-    {
-        cout << "Enter Name: "; cin >> name;
-        cout << "Enter Password: "; cin >> pass;
+    vector<Quote> reference = manager.quoteCarts(batch, 1);
+    long long quoted = 0, mismatches = 0;
+    auto start = chrono::steady_clock::now(), deadline = start + chrono::seconds(3);
+    while (chrono::steady_clock::now() < deadline) {
+        vector<Quote> quotes = manager.quoteCarts(batch);
+        for (size_t i = 0; i < quotes.size(); i++) mismatches += quotes[i].total != reference[i].total;
+        quoted += quotes.size();
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+    Money revenue;
+    for (const Quote& q : reference) revenue += q.total;
+    cout << "\n--- Quote Benchmark (" << carts << " carts, " << offerCount << " offers) ---" << endl;
+    cout << "Quotes: " << quoted << " in " << fixed << setprecision(2) << elapsed << "s = " << setprecision(0)
+         << quoted / elapsed << " carts/s, " << mismatches << " mismatched" << endl;
+    cout << "Batch total: $" << revenue << endl;
+    return mismatches ? 1 : 0;
+}
 
-        if (userType == 'a') 
-        {
-            cout << "Enter Delivery Address: "; 
-          cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            getline(cin, address);
-            if (!address.empty() && address.back() == '\r') {
-                address.pop_back();
-            }
-            currentUser = new Customer(name, pass, address);
-        } 
-        
-        else if (userType == 'b') {
-            currentUser = new RestaurantOwner(name, pass);
-        } 
-        
-        else if (userType == 'c') {
-            cout << "Enter Vehicle Type (Bike/Car): "; cin >> extra;
-            currentUser = new DeliveryPartner(name, pass, extra);
+// `--check-menu-deltas [edits]` makes that many random edits to a menu of up
+// to 64 dishes, enough to compact its change log many times over, while
+// replicas left behind at different versions catch up now and then. Each
+// sync must leave the replica matching the menu.
+int runMenuDeltaCheck(int edits) {
+    Menu menu;
+    mt19937 pick(2024);
+    vector<MenuReplica> replicas(8);
+    vector<string> names;
+    long long syncs = 0, failures = 0;
+
+    auto matches = [&menu](const MenuReplica& replica) {
+        MenuPin pin = menu.getAllDishes();
+        if (replica.dishes.size() != pin->dishes.size()) return false;
+        for (const Dish& d : pin) {
+            auto e = replica.dishes.find(d.getRatingHandle());
+            if (e == replica.dishes.end() || e->second.name != d.getName() || e->second.priceCents != d.getPrice().getCents() ||
+                e->second.milliStars != MenuDelta::milliStars(d.getRatingHandle())) return false;
         }
-        
-    if (currentUser && currentUser->registerUser()) 
-    {
-            manager.addUser(currentUser);
-            
-            if (RestaurantOwner* newOwner = dynamic_cast<RestaurantOwner*>(currentUser)) 
-            {
-                cout << "\nSetting up your first restaurant..." << endl;
-                string restName = name + "'s Cafe"; // Use the owner's name
-                Restaurant* newRest = new Restaurant(restName, CUISINE_OTHER, newOwner->getName() + "@mail.com");
-                manager.addRestaurant(newRest); // Add to global system list
-                newOwner->addRestaurant(newRest); // Add to this owner's list
+        return true;
+    };
+    auto sync = [&](MenuReplica& replica) {
+        syncs++;
+        if (!replica.apply(menu.deltaSince(replica.version)) || !matches(replica)) failures++;
+    };
+
+    for (int i = 0; i < edits; i++) {
+        int op = static_cast<int>(pick() % 10);
+        if (names.empty() || (op < 4 && names.size() < 64)) {
+            names.push_back("Dish " + to_string(i));
+            menu.addDish(Dish(names.back(), 5 + pick() % 20, pick() % 2 ? DISH_VEG : DISH_NON_VEG, CUISINE_INDIAN, COURSE_DINNER));
+        } else if (op < 7) {
+            size_t k = pick() % names.size();
+            menu.removeDish(names[k]);
+            names.erase(names.begin() + k);
+        } else {
+            MenuPin pin = menu.getAllDishes();
+            const Dish& d = pin->dishes[pick() % pin->dishes.size()];
+            if (op < 9) {
+                menu.repriceDish(d.getId(), Money::fromCents(100 + pick() % 3000));
+            } else {
+                RatingBoard::instance().publish(d.getRatingHandle(), 1000 + pick() % 4001, 1 + pick() % 100);
+                menu.noteRerated(d.getRatingHandle());
             }
-            
-            currentUser->login(currentUser->getId(), pass); // Log in *after* setup
-            return currentUser;
-        }
-        return nullptr;
-
-    } 
-    
-    else if (choice == 1) 
-    {
-        cout << "Enter User ID: "; cin >> id;
-        cout << "Enter Password: "; cin >> pass;
-        
-        User* tempUser = manager.findUser(id);
-        if (tempUser && tempUser->login(id, pass)) 
-        {
-            currentUser = tempUser;
-            if ((userType == 'a' && dynamic_cast<Customer*>(currentUser)) ||
-                (userType == 'b' && dynamic_cast<RestaurantOwner*>(currentUser)) ||
-                (userType == 'c' && dynamic_cast<DeliveryPartner*>(currentUser))) {
-                return currentUser;
-            }
-            cout << "Login failed: User type mismatch or ID not found." << endl;
-            currentUser->logout();
-            return nullptr;
         }
-        cout << "Login failed: Invalid ID or Password." << endl;
-        return nullptr;
+        if (pick() % 16 == 0) sync(replicas[pick() % replicas.size()]);
     }
-    return nullptr;
+    for (MenuReplica& replica : replicas) sync(replica);
+
+    cout << "\n--- Menu Delta Check ---" << endl;
+    cout << edits << " edits, version " << menu.getVersion() << ", " << syncs << " syncs, " << failures << " failed" << endl;
+    return failures ? 1 : 0;
 }
 
+// `--replay FILE` rebuilds a recorded run from its trace as fast as it can be
+// fed: same seed, same sim clock, payments and timers taken from the trace.
+// The output hash matches the recording's when the build behaves the same.
+int runReplay(const string& path) {
+    ifstream file(path, ios::binary);
+    vector<uint8_t> trace((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    size_t pos = 8;
+    uint64_t seed, start;
+    if (trace.size() < 8 || memcmp(trace.data(), TraceRecorder::MAGIC, 8) != 0 ||
+        !MenuDelta::getVarint(trace, pos, seed) || !MenuDelta::getVarint(trace, pos, start)) {
+        cout << "Not a FoodMate trace: " << path << endl;
+        return 1;
+    }
 
-int main() {
+    RunContext& ctx = RunContext::instance();
+    ctx.makeDeterministic(seed, static_cast<long long>(start));
     SystemManager manager;
-    char userTypeChoice;
-    User* loggedInUser = nullptr;
-
-    cout << "\n=======================================" << endl;
-    cout << "   ✨ Welcome to FoodMate! (C++ OOP)" << endl;
-    cout << "=======================================" << endl;
+    manager.setManualPayments(true);
+    SessionEngine engine(manager);
+    engine.setReplaying(true);
+
+    long long now = static_cast<long long>(start);
+    uint64_t events = 0, session, value;
+    string output, text;
+    vector<pair<uint32_t, string>> ready;
+    bool ok = true;
+    auto began = chrono::steady_clock::now();
+    while (ok && pos < trace.size()) {
+        uint8_t type = trace[pos++];
+        if (!MenuDelta::getVarint(trace, pos, value)) {
+            ok = false;
+            break;
+        }
+        now += static_cast<long long>(value);
+        ctx.setSimNow(now);
+        output.clear();
+
+        if (type == EVENT_OPEN) {
+            ok = MenuDelta::getVarint(trace, pos, session) && engine.open(output) == session;
+        } else if (type == EVENT_INPUT) {
+            ok = MenuDelta::getVarint(trace, pos, session) && MenuDelta::getString(trace, pos, text);
+            if (ok) engine.feed(static_cast<uint32_t>(session), text, output);
+        } else if (type == EVENT_CLOSE) {
+            ok = MenuDelta::getVarint(trace, pos, session);
+            if (ok) engine.close(static_cast<uint32_t>(session));
+        } else if (type == EVENT_PAYMENT) {
+            PaymentResult result;
+            ok = MenuDelta::getString(trace, pos, text) && pos < trace.size();
+            if (ok) result.success = trace[pos++] != 0;
+            ok = ok && MenuDelta::getVarint(trace, pos, value) && MenuDelta::getString(trace, pos, result.reference) &&
+                 MenuDelta::getString(trace, pos, result.message);
+            if (ok) {
+                result.attempts = static_cast<int>(value);
+                manager.settlePayment(text, result);
+                ready.clear();
+                engine.poll(ready);
+            }
+        } else if (type == EVENT_TIMER) {
+            ok = pos < trace.size() && trace[pos] < TIMER_COUNT;
+            if (ok) manager.fireTimer(static_cast<TimerId>(trace[pos++]));
+        } else {
+            ok = false;
+        }
+        if (ok) events++;
+    }
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - began).count();
+
+    cout << "\n--- Replay of " << path << " (seed " << seed << ") ---" << endl;
+    cout << "Events: " << events << " in " << fixed << setprecision(3) << elapsed << "s = " << setprecision(0)
+         << events / max(elapsed, 1e-9) << " events/s" << endl;
+    cout << "Output hash: " << hex << engine.getOutputHash() << dec << endl;
+    if (!ok) cout << "Trace is corrupt or does not match this build (stopped at byte " << pos << ")." << endl;
+    return ok ? 0 : 1;
+}
 
-    bool appRunning = true;
-    while (appRunning) {
-        loggedInUser = nullptr; 
+// Console lines, read so that the engine's timers (pre-order releases,
+// rating flushes, surge) keep firing while nobody is typing
+class ConsoleInput {
+private:
+    static constexpr int IDLE_TICK_MS = 100;
 
-        cout << "\n--- Main Menu ---" << endl;
-        cout << "1. Login as:\n   a) Customer\n   b) Restaurant Owner\n   c) Delivery Partner\n   q) Quit Application\nSelect User Type (a/b/c/q): ";
-        cin >> userTypeChoice;
-        
-        cin.ignore(numeric_limits<streamsize>::max(), '\n'); 
+    string pending;
+    bool ended = false;
 
-        if (userTypeChoice == 'q') {
-            appRunning = false;
-            cout << "\nThank you for using FoodMate. Goodbye!" << endl;
-            continue; 
+public:
+    bool nextLine(string& line, SessionEngine& engine) {
+#ifdef __linux__
+        while (true) {
+            size_t eol = pending.find('\n');
+            if (eol != string::npos) {
+                line.assign(pending, 0, eol);
+                pending.erase(0, eol + 1);
+                return true;
+            }
+            if (ended) {
+                if (pending.empty()) return false;
+                line.swap(pending);
+                pending.clear();
+                return true;
+            }
+            pollfd in = {STDIN_FILENO, POLLIN, 0};
+            int ready = ::poll(&in, 1, IDLE_TICK_MS);
+            if (ready > 0) {
+                char buf[4096];
+                ssize_t n = ::read(STDIN_FILENO, buf, sizeof(buf));
+                if (n > 0) pending.append(buf, static_cast<size_t>(n));
+                else if (n == 0 || errno != EINTR) ended = true;
+            } else if (ready < 0 && errno != EINTR) {
+                ended = true;
+            }
+            engine.tick();
         }
+#else
+        (void)engine;
+        return static_cast<bool>(getline(cin, line));
+#endif
+    }
+};
 
-        if (userTypeChoice == 'a' || userTypeChoice == 'b' || userTypeChoice == 'c') {
-            loggedInUser = handleLoginOrRegister(manager, userTypeChoice);
+int main(int argc, char* argv[]) {
+    // --seed N and --record FILE make the run deterministic, for the console and --serve alike
+    vector<char*> args;
+    string recordPath, replayPath, streamName = "/foodmate-orders";
+    bool seeded = false;
+    uint64_t seed = 0;
+    for (int i = 0; i < argc; i++) {
+        string arg = argv[i];
+        if ((arg == "--seed" || arg == "--record" || arg == "--replay" || arg == "--stream" || arg == "--kdf-iterations") && i + 1 < argc) {
+            string value = argv[++i];
+            if (arg == "--kdf-iterations") {
+                Credential::setWorkFactor(static_cast<uint32_t>(max(1, atoi(value.c_str()))));
+            } else if (arg == "--seed") {
+                seed = strtoull(value.c_str(), nullptr, 10);
+                seeded = true;
+            } else if (arg == "--record") {
+                recordPath = value;
+            } else if (arg == "--stream") {
+                streamName = value[0] == '/' ? value : "/" + value;
+            } else {
+                replayPath = value;
+            }
         } else {
-            cout << "Invalid choice. Please select 'a', 'b', 'c', or 'q'." << endl;
-            continue; 
+            args.push_back(argv[i]);
         }
+    }
+    if (!replayPath.empty()) return runReplay(replayPath);
+
+    RunContext& ctx = RunContext::instance();
+    if (seeded || !recordPath.empty()) ctx.makeDeterministic(seeded ? seed : ctx.random(), Clock::nowMicros());
+    TraceRecorder recorder;
+    if (!recordPath.empty() && !recorder.open(recordPath)) {
+        cout << "Could not write " << recordPath << endl;
+        return 1;
+    }
+    TraceRecorder* tracing = recordPath.empty() ? nullptr : &recorder;
+    argc = static_cast<int>(args.size());
+    argv = args.data();
+
+    if (argc > 1 && string(argv[1]) == "--bench-login") return runLoginBenchmark(argc > 2 ? max(1, atoi(argv[2])) : 10000);
+    if (argc > 1 && string(argv[1]) == "--bench-quotes") return runQuoteBenchmark(argc > 2 ? max(1, atoi(argv[2])) : 200000);
+    if (argc > 1 && string(argv[1]) == "--check-menu-deltas") return runMenuDeltaCheck(argc > 2 ? max(1, atoi(argv[2])) : 20000);
+    if (argc == 1 || string(argv[1]) == "--serve") {
+        if (!OrderEventStream::instance().create(streamName)) cout << "Order events are off: could not map " << streamName << endl;
+    }
+#ifdef __linux__
+    if (argc > 1 && string(argv[1]) == "--watch-orders") return runOrderWatcher(streamName, argc > 2 && string(argv[2]) == "--oldest");
+    if (argc > 1) return runNetworkMode(argc, argv, tracing);
+#endif
+    SystemManager manager;
+    SessionEngine engine(manager);
+    engine.setRecorder(tracing);
 
-        if (loggedInUser){
-            if (Customer* cust = dynamic_cast<Customer*>(loggedInUser)) {
-                runCustomerFlow(cust, manager);
-                
-            } else if (RestaurantOwner* owner = dynamic_cast<RestaurantOwner*>(loggedInUser)) {
-                runOwnerFlow(owner, manager);
-            } else if (DeliveryPartner* partner = dynamic_cast<DeliveryPartner*>(loggedInUser)) {
-                runPartnerFlow(partner, manager);
-            }
-            
-            loggedInUser->logout();
-            loggedInUser = nullptr; 
+    cout << "\n=======================================" << endl;
+    cout << "   ✨ Welcome to FoodMate! (C++ OOP)" << endl;
+    cout << "=======================================" << endl;
+
+    // The console is just one session on the engine
+    string output, line;
+    uint32_t console = engine.open(output);
+    cout << output << flush;
+
+    ConsoleInput input;
+    vector<pair<uint32_t, string>> ready;
+    bool appRunning = true;
+    while (appRunning && input.nextLine(line, engine)) {
+        output.clear();
+        appRunning = engine.feed(console, line, output);
+        cout << output << flush;
+
+        // Nothing else to serve here, so the console simply waits for the gateway
+        while (appRunning && engine.isWaiting(console)) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+            ready.clear();
+            engine.poll(ready);
+            for (const auto& r : ready) cout << r.second << flush;
+            appRunning = engine.isOpen(console);
         }
     }
+    if (tracing) {
+        recorder.flush();
+        cout << "Recorded " << recorder.getEvents() << " events to " << recordPath << " (seed " << ctx.getSeed()
+             << ", output hash " << hex << engine.getOutputHash() << dec << ")" << endl;
+    }
     
     return 0;
-}
\ No newline at end of file
+}